@@ -0,0 +1,201 @@
+#include "AssetBundle.h"
+
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+AssetBundle::~AssetBundle()
+{
+    close();
+}
+
+bool AssetBundle::open(const std::string& path)
+{
+    close();
+    this->path = path;
+#ifdef _WIN32
+    file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file_handle == INVALID_HANDLE_VALUE)
+    {
+        file_handle = nullptr;
+        return false;
+    }
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file_handle, &file_size);
+    size = static_cast<size_t>(file_size.QuadPart);
+    mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(mapping_handle != nullptr)
+    {
+        data = static_cast<const uint8_t*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+    }
+#else
+    file_descriptor = ::open(path.c_str(), O_RDONLY);
+    if(file_descriptor < 0)
+    {
+        return false;
+    }
+    struct stat file_stat;
+    fstat(file_descriptor, &file_stat);
+    size = static_cast<size_t>(file_stat.st_size);
+    if(size != 0)
+    {
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+        data = mapping == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(mapping);
+    }
+#endif
+    if(data == nullptr || !validate())
+    {
+        std::cout << path << " is not a valid asset bundle" << std::endl;
+        close();
+        return false;
+    }
+    std::cout << "mapped asset bundle " << path << ", " << entryCount() << " entries, " << size / 1024 << " KiB" << std::endl;
+    return true;
+}
+
+void AssetBundle::close()
+{
+#ifdef _WIN32
+    if(data != nullptr)
+    {
+        UnmapViewOfFile(data);
+    }
+    if(mapping_handle != nullptr)
+    {
+        CloseHandle(mapping_handle);
+    }
+    if(file_handle != nullptr)
+    {
+        CloseHandle(file_handle);
+    }
+    mapping_handle = nullptr;
+    file_handle = nullptr;
+#else
+    if(data != nullptr)
+    {
+        munmap(const_cast<uint8_t*>(data), size);
+    }
+    if(file_descriptor >= 0)
+    {
+        ::close(file_descriptor);
+    }
+    file_descriptor = -1;
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+bool AssetBundle::isOpen() const
+{
+    return data != nullptr;
+}
+
+bool AssetBundle::validate() const
+{
+    if(size < sizeof(BundleHeader))
+    {
+        return false;
+    }
+    const BundleHeader& h = header();
+    if(memcmp(h.magic, bundle_magic, sizeof(bundle_magic)) != 0 || h.version != bundle_version || h.file_size != size)
+    {
+        return false;
+    }
+    if(h.toc_offset > size || h.toc_offset % alignof(BundleEntry) != 0 || (size - h.toc_offset) / sizeof(BundleEntry) < h.entry_count)
+    {
+        return false;
+    }
+    for(uint32_t i = 0; i < h.entry_count; i++)
+    {
+        const BundleEntry& e = entry(i);
+        if(e.offset > size || e.size > size - e.offset || e.offset % bundle_entry_alignment != 0 || e.name[bundle_name_length - 1] != '\0')
+        {
+            return false;
+        }
+        if(e.type == BundleEntryType::Mesh)
+        {
+            if(e.size < sizeof(BundleMesh))
+            {
+                return false;
+            }
+            //offsets are checked before they are added to anything, so a huge one can not wrap around
+            const BundleMesh* m = mesh(e);
+            if(m->vertex_offset > e.size || (uint64_t)m->vertex_count * m->vertex_stride > e.size - m->vertex_offset ||
+                m->index_offset > e.size || (uint64_t)m->index_count * m->index_size > e.size - m->index_offset ||
+                m->vertex_offset % bundle_blob_alignment != 0 || m->index_offset % bundle_blob_alignment != 0 ||
+                (m->texture_entry >= 0 && static_cast<uint32_t>(m->texture_entry) >= h.entry_count))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+const BundleHeader& AssetBundle::header() const
+{
+    return *reinterpret_cast<const BundleHeader*>(data);
+}
+
+uint32_t AssetBundle::entryCount() const
+{
+    return header().entry_count;
+}
+
+const BundleEntry& AssetBundle::entry(uint32_t index) const
+{
+    return reinterpret_cast<const BundleEntry*>(data + header().toc_offset)[index];
+}
+
+const BundleEntry* AssetBundle::find(const std::string& name) const
+{
+    uint32_t low = 0;
+    uint32_t high = entryCount();
+    while(low < high)
+    {
+        uint32_t mid = (low + high) / 2;
+        int order = strncmp(entry(mid).name, name.c_str(), bundle_name_length);
+        if(order == 0)
+        {
+            return &entry(mid);
+        }
+        if(order < 0)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return nullptr;
+}
+
+uint32_t AssetBundle::indexOf(const BundleEntry& entry) const
+{
+    return static_cast<uint32_t>(&entry - reinterpret_cast<const BundleEntry*>(data + header().toc_offset));
+}
+
+const uint8_t* AssetBundle::entryData(const BundleEntry& entry) const
+{
+    return data + entry.offset;
+}
+
+const BundleMesh* AssetBundle::mesh(const BundleEntry& entry) const
+{
+    if(entry.type != BundleEntryType::Mesh)
+    {
+        return nullptr;
+    }
+    return reinterpret_cast<const BundleMesh*>(data + entry.offset);
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+//cooked asset bundle, written by asset_cooker and memory mapped at runtime
+//[BundleHeader][entries, each starting on bundle_entry_alignment][BundleEntry table of contents]
+//a mesh entry is a BundleMesh followed by its vertex and index blobs in the runtime Vertex layout,
+//a texture entry is a complete ktx file without zstd supercompression, basis payloads are kept by default
+//and transcoded at load time like loose files, bundles cooked with a fixed block format are checked on load
+//the table of contents is sorted by name, entries are found by binary search without parsing anything
+
+constexpr char bundle_magic[8] = {'V', 'K', 'R', 'B', 'N', 'D', 'L', '\0'};
+//bump whenever a struct below or the cooked data layout changes, old bundles are then rejected
+constexpr uint32_t bundle_version = 1;
+//every entry starts on a page so it can be mapped, prefetched or dropped on its own
+constexpr uint64_t bundle_entry_alignment = 4096;
+//vertex and index blobs inside a mesh entry, enough for any buffer copy offset
+constexpr uint64_t bundle_blob_alignment = 256;
+constexpr size_t bundle_name_length = 56;
+
+enum class BundleEntryType : uint32_t
+{
+    Mesh = 1,
+    Texture = 2
+};
+
+struct BundleHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_count;
+    uint64_t toc_offset;
+    uint64_t file_size;
+};
+
+struct BundleEntry
+{
+    char name[bundle_name_length];
+    //hash of the inputs and cook options this entry was built from, the cooker skips unchanged entries
+    uint64_t content_hash;
+    BundleEntryType type;
+    uint32_t pad;
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct BundleMesh
+{
+    uint32_t vertex_count;
+    uint32_t index_count;
+    //checked against sizeof(Vertex) and uint16_t at load time
+    uint32_t vertex_stride;
+    uint32_t index_size;
+    //table of contents index of the mesh's texture, -1 without one
+    int32_t texture_entry;
+    float bounds_radius;
+    float bounds_center[3];
+    float bounds_min[3];
+    float bounds_max[3];
+    uint32_t pad;
+    //relative to the start of the entry
+    uint64_t vertex_offset;
+    uint64_t index_offset;
+};
+
+//fnv-1a, also used by TextureRegistry::hashContents
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for(size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+//read only view of a bundle file mapped into memory
+//pointers returned by it stay valid until close()
+class AssetBundle
+{
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* file_handle = nullptr;
+    void* mapping_handle = nullptr;
+#else
+    int file_descriptor = -1;
+#endif
+
+    bool validate() const;
+
+public:
+    std::string path;
+
+    AssetBundle() = default;
+    AssetBundle(const AssetBundle&) = delete;
+    AssetBundle& operator=(const AssetBundle&) = delete;
+    ~AssetBundle();
+
+    //maps the file and checks the header and every entry's bounds, false if it is missing or not a valid bundle
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const;
+
+    const BundleHeader& header() const;
+    uint32_t entryCount() const;
+    const BundleEntry& entry(uint32_t index) const;
+    //nullptr when no entry has that name
+    const BundleEntry* find(const std::string& name) const;
+    uint32_t indexOf(const BundleEntry& entry) const;
+
+    const uint8_t* entryData(const BundleEntry& entry) const;
+    //nullptr when entry is not a mesh
+    const BundleMesh* mesh(const BundleEntry& entry) const;
+};
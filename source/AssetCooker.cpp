@@ -0,0 +1,502 @@
+//asset_cooker, converts source assets into one memory mappable bundle
+//usage: asset_cooker -o out.vkb [-t basis|bc7|astc|rgba] inputs...
+//       asset_cooker -o out.vks -s scene.scene
+//inputs are .obj meshes and .ktx/.ktx2 textures, a mesh can name its texture as mesh.obj@texture.ktx,
+//otherwise the material's map_Kd is looked up with a ktx2 or ktx extension next to the obj
+//entries are named after the input's file stem and rebuilt only when their inputs or options change
+//with -s a text scene is checked and written in its binary form instead, see SceneFile.h
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <tiny_obj_loader.h>
+#include <ktx.h>
+#include <glm/glm.hpp>
+
+#include "AssetBundle.h"
+#include "SceneFile.h"
+
+namespace fs = std::filesystem;
+
+//same layout as Vertex in Model.h, checked again by the runtime through BundleMesh::vertex_stride
+struct CookedVertex
+{
+    glm::vec3 pos;
+    glm::vec3 normal;
+    glm::vec2 uv;
+};
+
+struct CookInput
+{
+    std::string name;
+    fs::path path;
+    BundleEntryType type;
+    //textures only, empty for meshes without one
+    std::string texture_name;
+};
+
+struct CookedEntry
+{
+    BundleEntry entry;
+    std::vector<uint8_t> bytes;
+    std::string texture_name;
+};
+
+struct CookOptions
+{
+    fs::path output;
+    //basis keeps etc1s/uastc payloads so the runtime transcodes to a format the device samples,
+    //the others bake one block format in and only suit bundles cooked for a known device
+    std::string target_name = "basis";
+    ktx_transcode_fmt_e target = KTX_TTF_BC7_RGBA;
+    //text scene to convert, no bundle is cooked when set
+    fs::path scene;
+};
+
+static bool readFile(const fs::path& path, std::vector<uint8_t>& data)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if(!file)
+    {
+        return false;
+    }
+    data.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(data.data()), data.size());
+    return file.good();
+}
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static bool cookMesh(const CookInput& input, std::vector<uint8_t>& bytes)
+{
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warning;
+    std::string error;
+    std::string base_dir = input.path.parent_path().string() + "/";
+    if(!tinyobj::LoadObj(&attrib, &shapes, &materials, &warning, &error, input.path.string().c_str(), base_dir.c_str()))
+    {
+        std::cerr << input.path << ": " << error << std::endl;
+        return false;
+    }
+
+    //same conversion as Model's constructor, y flipped for vulkan's clip space, plus vertex deduplication
+    std::vector<CookedVertex> vertices;
+    std::vector<uint16_t> indices;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> lookup;
+    glm::vec3 bounds_min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 bounds_max = glm::vec3(std::numeric_limits<float>::lowest());
+    for(const auto& shape : shapes)
+    {
+        for(const auto& index : shape.mesh.indices)
+        {
+            CookedVertex v = {};
+            v.pos = {
+                attrib.vertices[index.vertex_index * 3],
+                -attrib.vertices[index.vertex_index * 3 + 1],
+                attrib.vertices[index.vertex_index * 3 + 2]
+            };
+            if(index.normal_index >= 0)
+            {
+                v.normal = {
+                    attrib.normals[index.normal_index * 3],
+                    -attrib.normals[index.normal_index * 3 + 1],
+                    attrib.normals[index.normal_index * 3 + 2]
+                };
+            }
+            if(index.texcoord_index >= 0)
+            {
+                v.uv = {
+                    attrib.texcoords[index.texcoord_index * 2],
+                    1.0f - attrib.texcoords[index.texcoord_index * 2 + 1]
+                };
+            }
+            uint64_t hash = hashBytes(&v, sizeof(v));
+            uint32_t found = UINT32_MAX;
+            for(uint32_t candidate : lookup[hash])
+            {
+                if(memcmp(&vertices[candidate], &v, sizeof(v)) == 0)
+                {
+                    found = candidate;
+                    break;
+                }
+            }
+            if(found == UINT32_MAX)
+            {
+                found = static_cast<uint32_t>(vertices.size());
+                if(found > UINT16_MAX)
+                {
+                    std::cerr << input.path << ": more than 65536 unique vertices, indices are 16 bit" << std::endl;
+                    return false;
+                }
+                vertices.push_back(v);
+                lookup[hash].push_back(found);
+                bounds_min = glm::min(bounds_min, v.pos);
+                bounds_max = glm::max(bounds_max, v.pos);
+            }
+            indices.push_back(static_cast<uint16_t>(found));
+        }
+    }
+    if(vertices.empty())
+    {
+        std::cerr << input.path << ": no geometry" << std::endl;
+        return false;
+    }
+    glm::vec3 bounds_center = (bounds_min + bounds_max) * 0.5f;
+    float bounds_radius = 0.0f;
+    for(const auto& v : vertices)
+    {
+        bounds_radius = std::max(bounds_radius, glm::length(v.pos - bounds_center));
+    }
+
+    BundleMesh mesh = {
+        .vertex_count = static_cast<uint32_t>(vertices.size()),
+        .index_count = static_cast<uint32_t>(indices.size()),
+        .vertex_stride = sizeof(CookedVertex),
+        .index_size = sizeof(uint16_t),
+        .texture_entry = -1,
+        .bounds_radius = bounds_radius,
+        .bounds_center = {bounds_center.x, bounds_center.y, bounds_center.z},
+        .bounds_min = {bounds_min.x, bounds_min.y, bounds_min.z},
+        .bounds_max = {bounds_max.x, bounds_max.y, bounds_max.z},
+        .pad = 0
+    };
+    mesh.vertex_offset = alignUp(sizeof(BundleMesh), bundle_blob_alignment);
+    mesh.index_offset = alignUp(mesh.vertex_offset + vertices.size() * sizeof(CookedVertex), bundle_blob_alignment);
+    bytes.assign(mesh.index_offset + indices.size() * sizeof(uint16_t), 0);
+    memcpy(bytes.data(), &mesh, sizeof(mesh));
+    memcpy(bytes.data() + mesh.vertex_offset, vertices.data(), vertices.size() * sizeof(CookedVertex));
+    memcpy(bytes.data() + mesh.index_offset, indices.data(), indices.size() * sizeof(uint16_t));
+    std::cout << "cooked mesh " << input.name << ": " << vertices.size() << " vertices (" << indices.size() << " before deduplication)" << std::endl;
+    return true;
+}
+
+static bool cookTexture(const CookInput& input, const CookOptions& options, const std::vector<uint8_t>& source, std::vector<uint8_t>& bytes)
+{
+    //loading inflates zstd supercompression, so the written file holds plain level data
+    ktxTexture* texture = nullptr;
+    if(ktxTexture_CreateFromMemory(source.data(), source.size(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &texture) != KTX_SUCCESS)
+    {
+        std::cerr << input.path << ": not a ktx file" << std::endl;
+        return false;
+    }
+    if(options.target_name != "basis" && texture->classId == ktxTexture2_c && ktxTexture2_NeedsTranscoding(reinterpret_cast<ktxTexture2*>(texture)))
+    {
+        if(ktxTexture2_TranscodeBasis(reinterpret_cast<ktxTexture2*>(texture), options.target, 0) != KTX_SUCCESS)
+        {
+            std::cerr << input.path << ": transcoding to " << options.target_name << " failed" << std::endl;
+            ktxTexture_Destroy(texture);
+            return false;
+        }
+    }
+    if(texture->numLevels == 1 && std::max(texture->baseWidth, texture->baseHeight) > 1)
+    {
+        std::cout << "warning: " << input.path << " has no mip chain, texture streaming will keep it fully resident" << std::endl;
+    }
+    ktx_uint8_t* written = nullptr;
+    ktx_size_t written_size = 0;
+    KTX_error_code result = ktxTexture_WriteToMemory(texture, &written, &written_size);
+    ktxTexture_Destroy(texture);
+    if(result != KTX_SUCCESS)
+    {
+        std::cerr << input.path << ": could not write ktx" << std::endl;
+        return false;
+    }
+    bytes.assign(written, written + written_size);
+    free(written);
+    std::cout << "cooked texture " << input.name << ": " << written_size / 1024 << " KiB" << std::endl;
+    return true;
+}
+
+//the material's diffuse map with its extension swapped for a ktx container
+static fs::path materialTexture(const fs::path& obj_path)
+{
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string base_dir = obj_path.parent_path().string() + "/";
+    tinyobj::LoadObj(&attrib, &shapes, &materials, nullptr, nullptr, obj_path.string().c_str(), base_dir.c_str());
+    for(const auto& material : materials)
+    {
+        if(material.diffuse_texname.empty())
+        {
+            continue;
+        }
+        fs::path diffuse = obj_path.parent_path() / material.diffuse_texname;
+        for(const char* extension : {".ktx2", ".ktx"})
+        {
+            fs::path candidate = fs::path(diffuse).replace_extension(extension);
+            if(fs::exists(candidate))
+            {
+                return candidate;
+            }
+        }
+        std::cout << "warning: " << diffuse << " has no ktx version, convert it with toktx to bind it" << std::endl;
+    }
+    return {};
+}
+
+static bool parseArguments(int argc, char** argv, CookOptions& options, std::vector<CookInput>& inputs)
+{
+    std::vector<std::string> arguments(argv + 1, argv + argc);
+    for(size_t i = 0; i < arguments.size(); i++)
+    {
+        if(arguments[i] == "-o" && i + 1 < arguments.size())
+        {
+            options.output = arguments[++i];
+            continue;
+        }
+        if(arguments[i] == "-s" && i + 1 < arguments.size())
+        {
+            options.scene = arguments[++i];
+            continue;
+        }
+        if(arguments[i] == "-t" && i + 1 < arguments.size())
+        {
+            options.target_name = arguments[++i];
+            if(options.target_name == "basis")
+            {
+            }
+            else if(options.target_name == "bc7")
+            {
+                options.target = KTX_TTF_BC7_RGBA;
+            }
+            else if(options.target_name == "astc")
+            {
+                options.target = KTX_TTF_ASTC_4x4_RGBA;
+            }
+            else if(options.target_name == "rgba")
+            {
+                options.target = KTX_TTF_RGBA32;
+            }
+            else
+            {
+                std::cerr << "unknown target " << options.target_name << std::endl;
+                return false;
+            }
+            continue;
+        }
+
+        std::string argument = arguments[i];
+        fs::path texture_path;
+        size_t at = argument.find('@');
+        if(at != std::string::npos)
+        {
+            texture_path = argument.substr(at + 1);
+            argument = argument.substr(0, at);
+        }
+        fs::path path = argument;
+        std::string extension = path.extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if(extension == ".obj")
+        {
+            if(texture_path.empty())
+            {
+                texture_path = materialTexture(path);
+            }
+            inputs.push_back({
+                .name = path.stem().string(),
+                .path = path,
+                .type = BundleEntryType::Mesh,
+                .texture_name = texture_path.empty() ? "" : texture_path.stem().string()
+            });
+        }
+        else if(extension == ".ktx" || extension == ".ktx2")
+        {
+            texture_path = path;
+        }
+        else
+        {
+            std::cerr << path << ": unsupported input, png and other images have to be converted to ktx2 first" << std::endl;
+            return false;
+        }
+        if(!texture_path.empty())
+        {
+            std::string name = texture_path.stem().string();
+            bool listed = std::any_of(inputs.begin(), inputs.end(), [&](const CookInput& input) { return input.name == name && input.type == BundleEntryType::Texture; });
+            if(!listed)
+            {
+                inputs.push_back({
+                    .name = name,
+                    .path = texture_path,
+                    .type = BundleEntryType::Texture
+                });
+            }
+        }
+    }
+    if(options.output.empty() || (inputs.empty() == options.scene.empty()))
+    {
+        std::cerr << "usage: asset_cooker -o out.vkb [-t basis|bc7|astc|rgba] mesh.obj[@texture.ktx] texture.ktx2 ..." << std::endl;
+        std::cerr << "       asset_cooker -o out.vks -s scene.scene" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    CookOptions options;
+    std::vector<CookInput> inputs;
+    if(!parseArguments(argc, argv, options, inputs))
+    {
+        return 1;
+    }
+
+    if(!options.scene.empty())
+    {
+        SceneFile scene;
+        if(!scene.load(options.scene.string()))
+        {
+            return 1;
+        }
+        if(!scene.saveBinary(options.output.string()))
+        {
+            std::cerr << "could not write " << options.output << std::endl;
+            return 1;
+        }
+        std::cout << "wrote " << options.output << ", " << scene.models.size() << " models, " << scene.entities.size() << " entities, "
+            << fs::file_size(options.output) / 1024 << " KiB" << std::endl;
+        return 0;
+    }
+
+    //entries of the previous bundle are reused when their content hash still matches
+    AssetBundle previous;
+    bool have_previous = fs::exists(options.output) && previous.open(options.output.string());
+
+    std::vector<CookedEntry> cooked;
+    uint32_t reused = 0;
+    for(const CookInput& input : inputs)
+    {
+        if(input.name.size() >= bundle_name_length)
+        {
+            std::cerr << input.name << ": name longer than " << bundle_name_length - 1 << " characters" << std::endl;
+            return 1;
+        }
+        for(const CookedEntry& other : cooked)
+        {
+            if(input.name == other.entry.name)
+            {
+                std::cerr << input.name << ": two inputs share this name" << std::endl;
+                return 1;
+            }
+        }
+        std::vector<uint8_t> source;
+        if(!readFile(input.path, source))
+        {
+            std::cerr << input.path << ": could not read" << std::endl;
+            return 1;
+        }
+        uint64_t hash = hashBytes(source.data(), source.size());
+        hash = hashBytes(&bundle_version, sizeof(bundle_version), hash);
+        hash = hashBytes(input.texture_name.data(), input.texture_name.size(), hash);
+        if(input.type == BundleEntryType::Texture)
+        {
+            hash = hashBytes(options.target_name.data(), options.target_name.size(), hash);
+        }
+
+        CookedEntry entry = {
+            .entry = {
+                .content_hash = hash,
+                .type = input.type
+            },
+            .texture_name = input.texture_name
+        };
+        strncpy(entry.entry.name, input.name.c_str(), bundle_name_length - 1);
+
+        const BundleEntry* old = have_previous ? previous.find(input.name) : nullptr;
+        if(old != nullptr && old->content_hash == hash && old->type == input.type)
+        {
+            const uint8_t* old_data = previous.entryData(*old);
+            entry.bytes.assign(old_data, old_data + old->size);
+            reused++;
+        }
+        else
+        {
+            bool ok = input.type == BundleEntryType::Mesh ? cookMesh(input, entry.bytes) : cookTexture(input, options, source, entry.bytes);
+            if(!ok)
+            {
+                return 1;
+            }
+        }
+        cooked.push_back(std::move(entry));
+    }
+
+    if(have_previous && reused == cooked.size() && previous.entryCount() == cooked.size())
+    {
+        std::cout << options.output << " is up to date" << std::endl;
+        return 0;
+    }
+    previous.close();
+
+    //sorted so the runtime can binary search the table of contents
+    std::sort(cooked.begin(), cooked.end(), [](const CookedEntry& a, const CookedEntry& b)
+    {
+        return strncmp(a.entry.name, b.entry.name, bundle_name_length) < 0;
+    });
+    uint64_t offset = alignUp(sizeof(BundleHeader), bundle_entry_alignment);
+    for(CookedEntry& c : cooked)
+    {
+        c.entry.offset = offset;
+        c.entry.size = c.bytes.size();
+        offset = alignUp(offset + c.bytes.size(), bundle_entry_alignment);
+        if(c.entry.type != BundleEntryType::Mesh)
+        {
+            continue;
+        }
+        BundleMesh mesh;
+        memcpy(&mesh, c.bytes.data(), sizeof(mesh));
+        mesh.texture_entry = -1;
+        for(size_t i = 0; i < cooked.size() && !c.texture_name.empty(); i++)
+        {
+            if(cooked[i].entry.type == BundleEntryType::Texture && c.texture_name == cooked[i].entry.name)
+            {
+                mesh.texture_entry = static_cast<int32_t>(i);
+            }
+        }
+        memcpy(c.bytes.data(), &mesh, sizeof(mesh));
+    }
+
+    BundleHeader header = {
+        .version = bundle_version,
+        .entry_count = static_cast<uint32_t>(cooked.size()),
+        .toc_offset = offset,
+        .file_size = offset + cooked.size() * sizeof(BundleEntry)
+    };
+    memcpy(header.magic, bundle_magic, sizeof(bundle_magic));
+
+    std::vector<uint8_t> file(header.file_size, 0);
+    memcpy(file.data(), &header, sizeof(header));
+    for(size_t i = 0; i < cooked.size(); i++)
+    {
+        memcpy(file.data() + cooked[i].entry.offset, cooked[i].bytes.data(), cooked[i].bytes.size());
+        memcpy(file.data() + header.toc_offset + i * sizeof(BundleEntry), &cooked[i].entry, sizeof(BundleEntry));
+    }
+
+    //written next to the target and renamed over it, a failed cook never leaves a torn bundle
+    fs::path temporary = fs::path(options.output).concat(".tmp");
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(file.data()), file.size());
+        if(!out.good())
+        {
+            std::cerr << temporary << ": could not write" << std::endl;
+            return 1;
+        }
+    }
+    fs::rename(temporary, options.output);
+    std::cout << "wrote " << options.output << ": " << cooked.size() << " entries, " << reused << " reused, " << file.size() / 1024 << " KiB" << std::endl;
+    return 0;
+}
@@ -0,0 +1,448 @@
+#include "AssetLoader.h"
+#include "RendererLoader.h"
+
+#include <array>
+#include <fstream>
+
+#include <ktxvulkan.h>
+
+//placeholder checker, small enough to stay below the streamer's tail size
+constexpr uint32_t placeholder_size = 8;
+constexpr uint64_t placeholder_hash = 0x706c616365686f6cull;
+
+static bool readFile(const std::string& path, std::vector<uint8_t>& data)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if(!file)
+    {
+        return false;
+    }
+    data.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(data.data()), data.size());
+    return file.good();
+}
+
+void AssetLoader::buildBox(glm::vec3 bounds_min, glm::vec3 bounds_max, std::vector<Vertex>& vertices, std::vector<uint16_t>& indices)
+{
+    //one quad per face so every face gets a flat normal
+    const std::array<glm::vec3, 6> normals = {
+        glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0),
+        glm::vec3(0, 1, 0), glm::vec3(0, -1, 0),
+        glm::vec3(0, 0, 1), glm::vec3(0, 0, -1)
+    };
+    glm::vec3 center = (bounds_min + bounds_max) * 0.5f;
+    glm::vec3 half = (bounds_max - bounds_min) * 0.5f;
+    for(const glm::vec3& n : normals)
+    {
+        glm::vec3 u = n.x != 0.0f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+        glm::vec3 v = glm::cross(n, u);
+        uint16_t first = static_cast<uint16_t>(vertices.size());
+        const std::array<glm::vec2, 4> corners = {glm::vec2(-1, -1), glm::vec2(1, -1), glm::vec2(1, 1), glm::vec2(-1, 1)};
+        for(const glm::vec2& c : corners)
+        {
+            vertices.push_back({
+                .pos = center + (n + u * c.x + v * c.y) * half,
+                .normal = n,
+                .uv = c * 0.5f + 0.5f
+            });
+        }
+        for(uint16_t i : {0, 1, 2, 0, 2, 3})
+        {
+            indices.push_back(static_cast<uint16_t>(first + i));
+        }
+    }
+}
+
+void AssetLoader::start(Engine* engine, RendererLoader* loader)
+{
+    this->engine = engine;
+    this->loader = loader;
+    jobs = &engine->job_system;
+
+    std::vector<Vertex> vertices;
+    std::vector<uint16_t> indices;
+    buildBox(glm::vec3(-0.5f), glm::vec3(0.5f), vertices, indices);
+    unit_box = uploadMesh(VK_NULL_HANDLE, vertices.data(), static_cast<uint32_t>(vertices.size()), indices.data(), static_cast<uint32_t>(indices.size()));
+
+    ktxTextureCreateInfo create_info = {
+        .vkFormat = VK_FORMAT_R8G8B8A8_UNORM,
+        .baseWidth = placeholder_size,
+        .baseHeight = placeholder_size,
+        .baseDepth = 1,
+        .numDimensions = 2,
+        .numLevels = 1,
+        .numLayers = 1,
+        .numFaces = 1,
+        .isArray = KTX_FALSE,
+        .generateMipmaps = KTX_FALSE
+    };
+    ktxTexture2* checker = nullptr;
+    ktxTexture2_Create(&create_info, KTX_TEXTURE_CREATE_ALLOC_STORAGE, &checker);
+    std::array<uint32_t, placeholder_size * placeholder_size> texels;
+    for(uint32_t i = 0; i < texels.size(); i++)
+    {
+        texels[i] = ((i % placeholder_size) / 2 + (i / placeholder_size) / 2) % 2 ? 0xff808080u : 0xffb0b0b0u;
+    }
+    ktxTexture_SetImageFromMemory(ktxTexture(checker), 0, 0, 0, reinterpret_cast<const ktx_uint8_t*>(texels.data()), sizeof(texels));
+    placeholder_texture = loader->texture_registry.insert({.hash = placeholder_hash}, "<placeholder>", loader->createTexture(engine, ktxTexture(checker), "<placeholder>"));
+
+    engine->main_deletion_queue.push([=]()
+    {
+        //jobs hold pointers into this loader and the mapped bundles until they finish
+        jobs->wait(&loads);
+        for(LoadResult& result : results)
+        {
+            if(result.ktx_texture)
+            {
+                ktxTexture_Destroy(result.ktx_texture);
+            }
+        }
+        results.clear();
+    });
+    std::cout << "asset loader started" << std::endl;
+}
+
+uint32_t AssetLoader::uploadMesh(VkCommandBuffer cmd, const Vertex* vertices, uint32_t vertex_count, const uint16_t* indices, uint32_t index_count)
+{
+    GeometryHeap& heap = loader->geometry_heap;
+    uint32_t mesh = heap.allocate(vertex_count, index_count);
+    if(heap.writeMapped(mesh, vertices, indices))
+    {
+        return mesh;
+    }
+    if(cmd != VK_NULL_HANDLE)
+    {
+        heap.recordUpload(cmd, mesh, vertices, indices);
+    }
+    else
+    {
+        loader->immediateSubmit(engine, [&](VkCommandBuffer cmd)
+        {
+            heap.recordUpload(cmd, mesh, vertices, indices);
+        });
+    }
+    return mesh;
+}
+
+void AssetLoader::uploadMeshlets(VkCommandBuffer cmd, uint32_t mesh, const MeshletData& meshlets)
+{
+    GeometryHeap& heap = loader->geometry_heap;
+    if(meshlets.empty() || heap.writeMeshlets(mesh, meshlets))
+    {
+        return;
+    }
+    heap.recordMeshletUpload(cmd, mesh, meshlets);
+}
+
+AssetHandle AssetLoader::addRequest(Model* model, uint32_t parts, AssetCallback&& on_complete)
+{
+    requests.push_back({
+        .state = AssetState::Loading,
+        .model = model,
+        .texture = placeholder_texture,
+        .proxy_mesh = UINT32_MAX,
+        .parts = parts,
+        .failed = false,
+        .on_complete = std::move(on_complete)
+    });
+    loading_count++;
+    return static_cast<AssetHandle>(requests.size() - 1);
+}
+
+void AssetLoader::finishPart(AssetHandle handle, bool loaded)
+{
+    Request& request = requests[handle];
+    request.failed = request.failed || !loaded;
+    if(--request.parts > 0)
+    {
+        return;
+    }
+    request.state = request.failed ? AssetState::Failed : AssetState::Ready;
+    loading_count--;
+    //callbacks may issue new requests, which can move requests around
+    AssetCallback on_complete = std::move(request.on_complete);
+    bool succeeded = !request.failed;
+    if(on_complete)
+    {
+        on_complete(handle, succeeded);
+    }
+}
+
+void AssetLoader::pushResult(LoadResult&& result)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    results.push_back(std::move(result));
+}
+
+AssetHandle AssetLoader::loadModel(Model* model, const std::string& path, const std::string& texture_path, AssetCallback on_complete)
+{
+    AssetHandle handle = addRequest(model, texture_path.empty() ? 1 : 2, std::move(on_complete));
+    //the real bounds are only known once the file is parsed
+    model->mesh = unit_box;
+    model->texture = placeholder_texture;
+    model->bounds_min = glm::vec3(-0.5f);
+    model->bounds_max = glm::vec3(0.5f);
+    model->bounds_center = glm::vec3(0.0f);
+    model->bounds_radius = glm::length(glm::vec3(0.5f));
+    if(!texture_path.empty())
+    {
+        attachTexture(handle, requestTexture(texture_path, nullptr, nullptr));
+    }
+
+    jobs->submit([this, handle, path]()
+    {
+        LoadResult result = {
+            .handle = handle,
+            .failed = true
+        };
+        Model parsed(path);
+        if(!parsed.vertices.empty())
+        {
+            result.failed = false;
+            result.vertices = std::move(parsed.vertices);
+            result.indices = std::move(parsed.indices);
+            result.vertex_data = result.vertices.data();
+            result.index_data = result.indices.data();
+            result.vertex_count = static_cast<uint32_t>(result.vertices.size());
+            result.index_count = static_cast<uint32_t>(result.indices.size());
+            result.bounds_min = parsed.bounds_min;
+            result.bounds_max = parsed.bounds_max;
+            result.bounds_center = parsed.bounds_center;
+            result.bounds_radius = parsed.bounds_radius;
+            result.bvh.build(result.vertex_data, result.index_data, result.index_count);
+            if(engine->mesh_shader_supported)
+            {
+                result.meshlets.build(result.vertex_data, result.vertex_count, result.index_data, result.index_count);
+            }
+        }
+        result.path = path;
+        pushResult(std::move(result));
+    }, &loads);
+    return handle;
+}
+
+AssetHandle AssetLoader::loadModel(Model* model, const AssetBundle& bundle, const std::string& name, AssetCallback on_complete)
+{
+    const BundleEntry* entry = bundle.find(name);
+    const BundleMesh* mesh = entry ? bundle.mesh(*entry) : nullptr;
+    bool usable = mesh != nullptr && mesh->vertex_stride == sizeof(Vertex) && mesh->index_size == sizeof(uint16_t);
+    bool textured = usable && mesh->texture_entry >= 0;
+    AssetHandle handle = addRequest(model, textured ? 2 : 1, std::move(on_complete));
+    model->mesh = unit_box;
+    model->texture = placeholder_texture;
+    if(!usable)
+    {
+        std::cout << "no mesh " << name << " in " << bundle.path << std::endl;
+        finished.push_back({handle, false});
+        return handle;
+    }
+
+    //the header already has the bounds, so the proxy box is sized right from the first frame it can be uploaded in
+    model->bounds_min = glm::vec3(mesh->bounds_min[0], mesh->bounds_min[1], mesh->bounds_min[2]);
+    model->bounds_max = glm::vec3(mesh->bounds_max[0], mesh->bounds_max[1], mesh->bounds_max[2]);
+    model->bounds_center = glm::vec3(mesh->bounds_center[0], mesh->bounds_center[1], mesh->bounds_center[2]);
+    model->bounds_radius = mesh->bounds_radius;
+    pending_proxies.push_back(handle);
+    if(textured)
+    {
+        const BundleEntry& texture_entry = bundle.entry(static_cast<uint32_t>(mesh->texture_entry));
+        attachTexture(handle, requestTexture(bundle.path + "#" + texture_entry.name, &bundle, &texture_entry));
+    }
+
+    //nothing to parse, the job only touches the mapping so the pages are faulted in off the main thread
+    jobs->submit([this, handle, entry, mesh, data = bundle.entryData(*entry)]()
+    {
+        LoadResult result = {
+            .handle = handle,
+            .failed = false,
+            .vertex_data = reinterpret_cast<const Vertex*>(data + mesh->vertex_offset),
+            .index_data = reinterpret_cast<const uint16_t*>(data + mesh->index_offset),
+            .vertex_count = mesh->vertex_count,
+            .index_count = mesh->index_count,
+            .bounds_min = glm::vec3(mesh->bounds_min[0], mesh->bounds_min[1], mesh->bounds_min[2]),
+            .bounds_max = glm::vec3(mesh->bounds_max[0], mesh->bounds_max[1], mesh->bounds_max[2]),
+            .bounds_center = glm::vec3(mesh->bounds_center[0], mesh->bounds_center[1], mesh->bounds_center[2]),
+            .bounds_radius = mesh->bounds_radius
+        };
+        //one byte per page is enough to bring the whole entry in
+        volatile uint8_t touched = 0;
+        for(uint64_t offset = 0; offset < entry->size; offset += bundle_entry_alignment)
+        {
+            touched = touched + data[offset];
+        }
+        result.bvh.build(result.vertex_data, result.index_data, result.index_count);
+        if(engine->mesh_shader_supported)
+        {
+            result.meshlets.build(result.vertex_data, result.vertex_count, result.index_data, result.index_count);
+        }
+        pushResult(std::move(result));
+    }, &loads);
+    return handle;
+}
+
+AssetHandle AssetLoader::loadTexture(const std::string& path, AssetCallback on_complete)
+{
+    return requestTexture(path, nullptr, nullptr, std::move(on_complete));
+}
+
+AssetHandle AssetLoader::requestTexture(const std::string& path, const AssetBundle* bundle, const BundleEntry* entry, AssetCallback on_complete)
+{
+    AssetHandle handle = addRequest(nullptr, 1, std::move(on_complete));
+    if(Texture* shared = loader->texture_registry.findByPath(path))
+    {
+        requests[handle].texture = shared;
+        finished.push_back({handle, true});
+        return handle;
+    }
+    jobs->submit([this, handle, path, bundle, entry]()
+    {
+        LoadResult result = {
+            .handle = handle,
+            .failed = true,
+            .path = path
+        };
+        if(bundle != nullptr)
+        {
+            //cooked entries carry their content hash, only the check hash is computed over the mapping
+            result.key = TextureRegistry::hashBundleEntry(*entry, bundle->entryData(*entry));
+            result.ktx_texture = loader->ktx_loader.loadMemory(bundle->entryData(*entry), entry->size, path);
+        }
+        else
+        {
+            std::vector<uint8_t> data;
+            if(readFile(path, data))
+            {
+                result.key = TextureRegistry::hashContents(data);
+                result.ktx_texture = loader->ktx_loader.loadMemory(data, path);
+            }
+        }
+        result.failed = result.ktx_texture == nullptr;
+        pushResult(std::move(result));
+    }, &loads);
+    return handle;
+}
+
+void AssetLoader::attachTexture(AssetHandle model_handle, AssetHandle texture_handle)
+{
+    Request& texture_request = requests[texture_handle];
+    texture_request.on_complete = [this, model_handle](AssetHandle texture_handle, bool loaded)
+    {
+        if(loaded)
+        {
+            requests[model_handle].model->texture = requests[texture_handle].texture;
+        }
+        finishPart(model_handle, loaded);
+    };
+}
+
+VkDeviceSize AssetLoader::applyModel(VkCommandBuffer cmd, LoadResult& result)
+{
+    Request& request = requests[result.handle];
+    if(result.failed)
+    {
+        //the proxy stays, a missing model still shows where it was placed
+        std::cout << "could not load model " << result.path << std::endl;
+        finishPart(result.handle, false);
+        return 0;
+    }
+    Model* model = request.model;
+    model->mesh = uploadMesh(cmd, result.vertex_data, result.vertex_count, result.index_data, result.index_count);
+    uploadMeshlets(cmd, model->mesh, result.meshlets);
+    model->bounds_min = result.bounds_min;
+    model->bounds_max = result.bounds_max;
+    model->bounds_center = result.bounds_center;
+    model->bounds_radius = result.bounds_radius;
+    model->bvh = std::move(result.bvh);
+    if(request.proxy_mesh != UINT32_MAX)
+    {
+        //frames in flight keep drawing it until they complete
+        loader->geometry_heap.free(request.proxy_mesh);
+        request.proxy_mesh = UINT32_MAX;
+    }
+    finishPart(result.handle, true);
+    return (VkDeviceSize)result.vertex_count * sizeof(Vertex) + (VkDeviceSize)result.index_count * sizeof(uint16_t) + result.meshlets.sizeBytes();
+}
+
+VkDeviceSize AssetLoader::applyTexture(VkCommandBuffer cmd, LoadResult& result)
+{
+    if(result.failed)
+    {
+        std::cout << "could not load texture " << result.path << std::endl;
+        finishPart(result.handle, false);
+        return 0;
+    }
+    VkDeviceSize uploaded = 0;
+    //another request may have loaded the same contents since this one was queued
+    Texture* texture = loader->texture_registry.findByHash(result.key, result.path);
+    if(texture != nullptr)
+    {
+        ktxTexture_Destroy(result.ktx_texture);
+    }
+    else
+    {
+        texture = loader->texture_registry.insert(result.key, result.path, loader->createTexture(engine, result.ktx_texture, result.path, cmd));
+        uploaded = texture->image.size;
+    }
+    result.ktx_texture = nullptr;
+    requests[result.handle].texture = texture;
+    finishPart(result.handle, true);
+    return uploaded;
+}
+
+void AssetLoader::applyCompleted(VkCommandBuffer cmd)
+{
+    std::vector<AssetHandle> proxies;
+    proxies.swap(pending_proxies);
+    for(AssetHandle handle : proxies)
+    {
+        Request& request = requests[handle];
+        if(request.state != AssetState::Loading)
+        {
+            continue;
+        }
+        std::vector<Vertex> vertices;
+        std::vector<uint16_t> indices;
+        buildBox(request.model->bounds_min, request.model->bounds_max, vertices, indices);
+        request.proxy_mesh = uploadMesh(cmd, vertices.data(), static_cast<uint32_t>(vertices.size()), indices.data(), static_cast<uint32_t>(indices.size()));
+        request.model->mesh = request.proxy_mesh;
+    }
+
+    std::vector<std::pair<AssetHandle, bool>> ready;
+    ready.swap(finished);
+    for(const auto& [handle, loaded] : ready)
+    {
+        finishPart(handle, loaded);
+    }
+
+    VkDeviceSize uploaded = 0;
+    while(uploaded < upload_budget)
+    {
+        LoadResult result;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(results.empty())
+            {
+                break;
+            }
+            result = std::move(results.front());
+            results.erase(results.begin());
+        }
+        uploaded += requests[result.handle].model ? applyModel(cmd, result) : applyTexture(cmd, result);
+    }
+}
+
+AssetState AssetLoader::state(AssetHandle handle) const
+{
+    return requests[handle].state;
+}
+
+Texture* AssetLoader::texture(AssetHandle handle) const
+{
+    return requests[handle].texture;
+}
+
+uint32_t AssetLoader::loadingCount() const
+{
+    return loading_count;
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <volk/volk.h>
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <functional>
+#include <utility>
+
+#include <ktx.h>
+
+#include "Engine.h"
+#include "Model.h"
+#include "Texture.h"
+#include "AssetBundle.h"
+#include "Meshlets.h"
+#include "TextureRegistry.h"
+
+class RendererLoader;
+
+//index into AssetLoader's requests, stays valid for the loader's lifetime
+using AssetHandle = uint32_t;
+
+enum class AssetState
+{
+    Loading,
+    Ready,
+    Failed
+};
+
+//runs on the main thread at the frame boundary where the asset was swapped in, loaded is false when it failed
+using AssetCallback = std::function<void(AssetHandle handle, bool loaded)>;
+
+//loads models and textures on the engine's job system while the render loop keeps running
+//a request returns at once and draws with placeholders, a box around the model's bounds and a checker texture
+//finished loads are uploaded through the frame's command buffer and swapped in before the frame is built,
+//at most upload_budget bytes per frame so a burst of completions does not stall a single frame
+//a model that fails to load keeps its proxy box, a texture that fails keeps the placeholder
+class AssetLoader
+{
+    struct Request
+    {
+        AssetState state;
+        //nullptr for texture requests, must outlive the request
+        Model* model;
+        //placeholder until the real texture is swapped in
+        Texture* texture;
+        //box sized to the model's bounds, UINT32_MAX while the model uses the shared unit box
+        uint32_t proxy_mesh;
+        //a model waits for its mesh and its texture
+        uint32_t parts;
+        bool failed;
+        AssetCallback on_complete;
+    };
+
+    //filled by a job, consumed by applyCompleted
+    struct LoadResult
+    {
+        AssetHandle handle;
+        bool failed;
+        //meshes are either parsed into these or point into a mapped bundle
+        std::vector<Vertex> vertices;
+        std::vector<uint16_t> indices;
+        const Vertex* vertex_data;
+        const uint16_t* index_data;
+        uint32_t vertex_count;
+        uint32_t index_count;
+        glm::vec3 bounds_min;
+        glm::vec3 bounds_max;
+        glm::vec3 bounds_center;
+        float bounds_radius;
+        //textures are read and transcoded on the worker, only the upload is left
+        ktxTexture* ktx_texture;
+        std::string path;
+        TextureKey key;
+        //built on the worker with the mesh, moved into the model when it is applied
+        MeshBVH bvh;
+        //empty without mesh shaders
+        MeshletData meshlets;
+    };
+
+    Engine* engine = nullptr;
+    RendererLoader* loader = nullptr;
+    JobSystem* jobs = nullptr;
+    //counts load jobs still running, waited on at shutdown
+    JobCounter loads;
+    std::mutex mutex;
+    std::vector<LoadResult> results;
+    std::vector<Request> requests;
+    //models whose proxy box waits for the next frame's command buffer
+    std::vector<AssetHandle> pending_proxies;
+    //requests settled without a job, their callbacks still run at the next frame boundary
+    std::vector<std::pair<AssetHandle, bool>> finished;
+    uint32_t unit_box = UINT32_MAX;
+    uint32_t loading_count = 0;
+
+    static void buildBox(glm::vec3 bounds_min, glm::vec3 bounds_max, std::vector<Vertex>& vertices, std::vector<uint16_t>& indices);
+    //recorded into cmd when the heap page is not host visible, submitted and waited for without one
+    uint32_t uploadMesh(VkCommandBuffer cmd, const Vertex* vertices, uint32_t vertex_count, const uint16_t* indices, uint32_t index_count);
+    void uploadMeshlets(VkCommandBuffer cmd, uint32_t mesh, const MeshletData& meshlets);
+    AssetHandle addRequest(Model* model, uint32_t parts, AssetCallback&& on_complete);
+    //bundle and entry are set for cooked textures, nullptr for files
+    AssetHandle requestTexture(const std::string& path, const AssetBundle* bundle, const BundleEntry* entry, AssetCallback on_complete = {});
+    //the model request finishes once the texture request has too
+    void attachTexture(AssetHandle model_handle, AssetHandle texture_handle);
+    void finishPart(AssetHandle handle, bool loaded);
+    void pushResult(LoadResult&& result);
+    VkDeviceSize applyModel(VkCommandBuffer cmd, LoadResult& result);
+    VkDeviceSize applyTexture(VkCommandBuffer cmd, LoadResult& result);
+
+public:
+    //bytes of mesh and texture data uploaded per frame, one result is always applied so nothing starves
+    VkDeviceSize upload_budget = 16 * 1024 * 1024;
+
+    //drawn until a texture is swapped in, owned by the loader's texture_registry
+    Texture* placeholder_texture = nullptr;
+
+    //creates the placeholders, call once the loader's command pool, bindless table and geometry heap exist
+    void start(Engine* engine, RendererLoader* loader);
+
+    //parses an obj and loads its texture in the background
+    //model gets a unit box and the placeholder texture right away, texture_path may be empty
+    AssetHandle loadModel(Model* model, const std::string& path, const std::string& texture_path, AssetCallback on_complete = {});
+    //cooked mesh, the proxy box matches its bounds since they are read from the bundle header
+    AssetHandle loadModel(Model* model, const AssetBundle& bundle, const std::string& name, AssetCallback on_complete = {});
+    AssetHandle loadTexture(const std::string& path, AssetCallback on_complete = {});
+
+    AssetState state(AssetHandle handle) const;
+    //the placeholder until the handle is ready
+    Texture* texture(AssetHandle handle) const;
+    //requests not yet swapped in
+    uint32_t loadingCount() const;
+
+    //call once per frame before the frame reads any model, uploads finished loads into cmd and swaps them in
+    void applyCompleted(VkCommandBuffer cmd);
+};
@@ -0,0 +1,154 @@
+#include "BindlessTable.h"
+
+#include <algorithm>
+
+void BindlessTable::setup(Engine* engine, uint32_t requested_capacity)
+{
+    device = engine->device;
+
+    VkPhysicalDeviceVulkan12Properties vk12_properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES
+    };
+    VkPhysicalDeviceProperties2 properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &vk12_properties
+    };
+    vkGetPhysicalDeviceProperties2(engine->physical_device, &properties);
+    //combined image samplers count against both the sampled image and the sampler limits
+    capacity = std::min({requested_capacity,
+        vk12_properties.maxDescriptorSetUpdateAfterBindSampledImages,
+        vk12_properties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+        vk12_properties.maxDescriptorSetUpdateAfterBindSamplers,
+        vk12_properties.maxPerStageDescriptorUpdateAfterBindSamplers});
+
+    VkDescriptorBindingFlags desc_binding_flag = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+        VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT |
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+        VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfo desc_binding_flags = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .bindingCount = 1,
+        .pBindingFlags = &desc_binding_flag
+    };
+    VkDescriptorSetLayoutBinding desc_layout_binding_textures = {
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = capacity,
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
+    };
+    VkDescriptorSetLayoutCreateInfo desc_layout_texture_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = &desc_binding_flags,
+        .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+        .bindingCount = 1,
+        .pBindings = &desc_layout_binding_textures
+    };
+    vkCreateDescriptorSetLayout(engine->device, &desc_layout_texture_create_info, nullptr, &descriptor_set_layout);
+
+    VkDescriptorPoolSize pool_size = {
+        .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = capacity
+    };
+    VkDescriptorPoolCreateInfo desc_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+        .maxSets = 1,
+        .poolSizeCount = 1,
+        .pPoolSizes = &pool_size
+    };
+    vkCreateDescriptorPool(engine->device, &desc_pool_create_info, nullptr, &descriptor_pool);
+
+    VkDescriptorSetVariableDescriptorCountAllocateInfo var_desc_count_alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO,
+        .descriptorSetCount = 1,
+        .pDescriptorCounts = &capacity
+    };
+    VkDescriptorSetAllocateInfo texture_desc_set_alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = &var_desc_count_alloc_info,
+        .descriptorPool = descriptor_pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &descriptor_set_layout
+    };
+    vkAllocateDescriptorSets(engine->device, &texture_desc_set_alloc_info, &descriptor_set);
+
+    //handed out lowest first
+    free_slots.resize(capacity);
+    for(uint32_t i = 0; i < capacity; i++)
+    {
+        free_slots[i] = capacity - 1 - i;
+    }
+
+    engine->main_deletion_queue.push([=]()
+    {
+        vkDestroyDescriptorPool(engine->device, descriptor_pool, nullptr);
+        vkDestroyDescriptorSetLayout(engine->device, descriptor_set_layout, nullptr);
+    });
+    std::cout << "bindless texture table created with " << capacity << " slots" << std::endl;
+}
+
+uint32_t BindlessTable::allocate(const VkDescriptorImageInfo& descriptor)
+{
+    if(free_slots.empty())
+    {
+        std::cout << "bindless texture table is full" << std::endl;
+        return UINT32_MAX;
+    }
+    uint32_t slot = free_slots.back();
+    free_slots.pop_back();
+
+    VkWriteDescriptorSet write_desc_set = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = descriptor_set,
+        .dstBinding = 0,
+        .dstArrayElement = slot,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &descriptor
+    };
+    vkUpdateDescriptorSets(device, 1, &write_desc_set, 0, nullptr);
+    return slot;
+}
+
+void BindlessTable::free(uint32_t slot)
+{
+    if(slot == UINT32_MAX)
+    {
+        return;
+    }
+    retired_slots.push_back({
+        .slot = slot,
+        .frame = frame
+    });
+}
+
+void BindlessTable::beginFrame(uint64_t frame_value, uint64_t completed_value)
+{
+    frame = frame_value;
+    auto it = std::remove_if(retired_slots.begin(), retired_slots.end(), [&](const RetiredSlot& retired)
+    {
+        if(retired.frame > completed_value)
+        {
+            return false;
+        }
+        free_slots.push_back(retired.slot);
+        return true;
+    });
+    retired_slots.erase(it, retired_slots.end());
+}
+
+void BindlessTable::trackTexture(Engine* engine, Texture* texture, const VkImageCreateInfo& create_info)
+{
+    engine->defragmenter.trackImage(texture->image, create_info, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, [this, texture](VkImage image, VkImageView view)
+    {
+        texture->image.handle = image;
+        texture->image.view = view;
+        texture->descriptor.imageView = view;
+        free(texture->texture_index);
+        texture->texture_index = allocate(texture->descriptor);
+    });
+}
+
+uint32_t BindlessTable::usedSlots() const
+{
+    return capacity - static_cast<uint32_t>(free_slots.size());
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <volk/volk.h>
+
+#include <vector>
+
+#include "Engine.h"
+#include "Texture.h"
+
+//fixed capacity array of combined image samplers shared by every pipeline
+//slots are written with update after bind, so textures can be added while frames are in flight
+//freed slots are only reused once every frame that could still read them has completed
+class BindlessTable
+{
+    struct RetiredSlot
+    {
+        uint32_t slot;
+        uint64_t frame;
+    };
+
+    std::vector<uint32_t> free_slots;
+    std::vector<RetiredSlot> retired_slots;
+    uint64_t frame = 0;
+    VkDevice device = VK_NULL_HANDLE;
+
+public:
+    uint32_t capacity = 0;
+    VkDescriptorPool descriptor_pool;
+    VkDescriptorSetLayout descriptor_set_layout;
+    VkDescriptorSet descriptor_set;
+
+    //capacity is clamped to the device's update after bind limits
+    void setup(Engine* engine, uint32_t requested_capacity);
+
+    //writes the descriptor into a free slot, returns UINT32_MAX when the table is full
+    uint32_t allocate(const VkDescriptorImageInfo& descriptor);
+
+    //the slot stays untouched until frames recorded up to now have completed
+    void free(uint32_t slot);
+
+    //call once per frame with the value being recorded, recycles slots freed by completed frames
+    void beginFrame(uint64_t frame_value, uint64_t completed_value);
+
+    //registers the texture's image with engine->defragmenter, a moved image gets a new slot like a streamed one
+    void trackTexture(Engine* engine, Texture* texture, const VkImageCreateInfo& create_info);
+
+    uint32_t usedSlots() const;
+};
@@ -1,13 +1,16 @@
 #include "BufferAlloc.h"
+#include "Instrumentation.h"
 
 BufferAlloc BufferAlloc::create(VmaAllocator allocator, 
     VkDevice device, 
     size_t size, 
     VkBufferUsageFlags usage, 
-    VmaAllocationCreateFlags vma_flags)
+    VmaAllocationCreateFlags vma_flags,
+    MemoryCategory category)
 {
     BufferAlloc buf;
     buf.allocator = allocator;
+    buf.category = category;
     VkBufferCreateInfo buffer_create_info = {
         .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
         .size = size,
@@ -18,6 +21,10 @@ BufferAlloc BufferAlloc::create(VmaAllocator allocator,
         .usage = VMA_MEMORY_USAGE_AUTO
     };
     vmaCreateBuffer(allocator, &buffer_create_info, &vma_alloc_info, &buf.handle, &buf.allocation, &buf.allocation_info);
+    vmaSetAllocationName(allocator, buf.allocation, memoryCategoryName(category));
+    Instrumentation::setObjectName(device, VK_OBJECT_TYPE_BUFFER, (uint64_t)buf.handle, memoryCategoryName(category));
+    buf.size = buf.allocation_info.size;
+    MemoryBudget::recordAllocation(category, buf.size);
     if(usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT)
     {
         VkBufferDeviceAddressInfo device_address_info = {
@@ -34,6 +41,7 @@ void BufferAlloc::destroy()
     if(handle != VK_NULL_HANDLE)
     {
         vmaDestroyBuffer(allocator, handle, allocation);
+        MemoryBudget::recordFree(category, size);
         handle = VK_NULL_HANDLE;
     }
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include <volk/volk.h>
 #include <vma/vk_mem_alloc.h>
+#include "MemoryBudget.h"
 
 class BufferAlloc
 {
@@ -10,6 +11,8 @@ public:
     VmaAllocation allocation;
     VmaAllocationInfo allocation_info;
     VkDeviceAddress device_address;
+    VkDeviceSize size;
+    MemoryCategory category;
 
     BufferAlloc() = default;
 
@@ -17,7 +20,8 @@ public:
         VkDevice device, 
         size_t size, 
         VkBufferUsageFlags usage, 
-        VmaAllocationCreateFlags vma_flags);
+        VmaAllocationCreateFlags vma_flags,
+        MemoryCategory category = MemoryCategory::Other);
         
     void destroy();
 };
\ No newline at end of file
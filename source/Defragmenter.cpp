@@ -0,0 +1,315 @@
+#include "Defragmenter.h"
+
+#include <iostream>
+#include <array>
+#include <algorithm>
+
+void Defragmenter::setup(VkDevice device, VmaAllocator allocator)
+{
+    this->device = device;
+    this->allocator = allocator;
+}
+
+void Defragmenter::trackBuffer(const BufferAlloc& buffer, VkDeviceSize size, VkBufferUsageFlags usage, std::function<void(VkBuffer)>&& on_moved)
+{
+    tracked[buffer.allocation] = {
+        .is_image = false,
+        .handle = (uint64_t)buffer.handle,
+        .view = VK_NULL_HANDLE,
+        .buffer_info = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .size = size,
+            .usage = usage
+        },
+        .buffer_moved = std::move(on_moved)
+    };
+}
+
+void Defragmenter::trackImage(const ImageAlloc& image, const VkImageCreateInfo& create_info, VkImageAspectFlags aspect, VkImageLayout layout, std::function<void(VkImage, VkImageView)>&& on_moved)
+{
+    Tracked target = {
+        .is_image = true,
+        .handle = (uint64_t)image.handle,
+        .view = image.view,
+        .image_info = create_info,
+        .aspect = aspect,
+        .layout = layout,
+        .image_moved = std::move(on_moved)
+    };
+    target.image_info.pNext = nullptr;
+    target.image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    tracked[image.allocation] = std::move(target);
+}
+
+void Defragmenter::untrack(VmaAllocation allocation)
+{
+    tracked.erase(allocation);
+}
+
+bool Defragmenter::shouldStart(uint64_t frame_value)
+{
+    if(tracked.empty() || frame_value < last_check_frame + check_interval)
+    {
+        return false;
+    }
+    last_check_frame = frame_value;
+    VmaTotalStatistics stats;
+    vmaCalculateStatistics(allocator, &stats);
+    VkDeviceSize block_bytes = stats.total.statistics.blockBytes;
+    VkDeviceSize unused_bytes = block_bytes - stats.total.statistics.allocationBytes;
+    return unused_bytes > unused_bytes_trigger && unused_bytes > unused_ratio_trigger * block_bytes;
+}
+
+void Defragmenter::recordBufferMove(VkCommandBuffer cmd, VmaDefragmentationMove& move, Tracked& target)
+{
+    VkBuffer new_buffer;
+    vkCreateBuffer(device, &target.buffer_info, nullptr, &new_buffer);
+    vmaBindBufferMemory(allocator, move.dstTmpAllocation, new_buffer);
+
+    VkBufferCopy region = {
+        .size = target.buffer_info.size
+    };
+    vkCmdCopyBuffer(cmd, (VkBuffer)target.handle, new_buffer, 1, &region);
+
+    replaced.push_back({
+        .is_image = false,
+        .handle = target.handle
+    });
+    target.handle = (uint64_t)new_buffer;
+    target.buffer_moved(new_buffer);
+}
+
+void Defragmenter::recordImageMove(VkCommandBuffer cmd, VmaDefragmentationMove& move, Tracked& target)
+{
+    VkImage new_image;
+    vkCreateImage(device, &target.image_info, nullptr, &new_image);
+    vmaBindImageMemory(allocator, move.dstTmpAllocation, new_image);
+
+    VkImageSubresourceRange range = {
+        .aspectMask = target.aspect,
+        .levelCount = target.image_info.mipLevels,
+        .layerCount = target.image_info.arrayLayers
+    };
+    std::array<VkImageMemoryBarrier2, 2> barriers_to_transfer = {
+        VkImageMemoryBarrier2{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+            .srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+            .srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+            .dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT,
+            .oldLayout = target.layout,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            .image = (VkImage)target.handle,
+            .subresourceRange = range
+        },
+        VkImageMemoryBarrier2{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+            .srcStageMask = VK_PIPELINE_STAGE_2_NONE,
+            .dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+            .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .image = new_image,
+            .subresourceRange = range
+        }
+    };
+    VkDependencyInfo dep_info = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .imageMemoryBarrierCount = static_cast<uint32_t>(barriers_to_transfer.size()),
+        .pImageMemoryBarriers = barriers_to_transfer.data()
+    };
+    vkCmdPipelineBarrier2(cmd, &dep_info);
+
+    std::vector<VkImageCopy> copies;
+    for(uint32_t level = 0; level < target.image_info.mipLevels; level++)
+    {
+        VkImageSubresourceLayers layers = {
+            .aspectMask = target.aspect,
+            .mipLevel = level,
+            .layerCount = target.image_info.arrayLayers
+        };
+        copies.push_back({
+            .srcSubresource = layers,
+            .dstSubresource = layers,
+            .extent = {
+                .width = std::max(1u, target.image_info.extent.width >> level),
+                .height = std::max(1u, target.image_info.extent.height >> level),
+                .depth = std::max(1u, target.image_info.extent.depth >> level)
+            }
+        });
+    }
+    vkCmdCopyImage(cmd, (VkImage)target.handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, new_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copies.size()), copies.data());
+
+    VkImageMemoryBarrier2 barrier_back = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .newLayout = target.layout,
+        .image = new_image,
+        .subresourceRange = range
+    };
+    dep_info.imageMemoryBarrierCount = 1;
+    dep_info.pImageMemoryBarriers = &barrier_back;
+    vkCmdPipelineBarrier2(cmd, &dep_info);
+
+    VkImageViewCreateInfo view_create_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = new_image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = target.image_info.format,
+        .subresourceRange = range
+    };
+    VkImageView new_view;
+    vkCreateImageView(device, &view_create_info, nullptr, &new_view);
+
+    replaced.push_back({
+        .is_image = true,
+        .handle = target.handle,
+        .view = target.view
+    });
+    target.handle = (uint64_t)new_image;
+    target.view = new_view;
+    target.image_moved(new_image, new_view);
+}
+
+void Defragmenter::recordMoves(VkCommandBuffer cmd, uint64_t frame_value)
+{
+    if(pass_active)
+    {
+        return;
+    }
+    if(context == VK_NULL_HANDLE)
+    {
+        if(!shouldStart(frame_value))
+        {
+            return;
+        }
+        VmaDefragmentationInfo defrag_info = {
+            .flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT,
+            .maxBytesPerPass = max_bytes_per_frame,
+            .maxAllocationsPerPass = max_moves_per_frame
+        };
+        if(vmaBeginDefragmentation(allocator, &defrag_info, &context) != VK_SUCCESS)
+        {
+            context = VK_NULL_HANDLE;
+            return;
+        }
+        std::cout << "defragmentation started" << std::endl;
+    }
+
+    if(vmaBeginDefragmentationPass(allocator, context, &pass) == VK_SUCCESS)
+    {
+        //nothing left to move
+        endRun();
+        return;
+    }
+
+    //buffers are covered by global barriers, images get their own layout transitions
+    VkMemoryBarrier2 barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+        .dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT
+    };
+    VkDependencyInfo dep_info = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier
+    };
+    vkCmdPipelineBarrier2(cmd, &dep_info);
+
+    pass_moves = 0;
+    for(uint32_t i = 0; i < pass.moveCount; i++)
+    {
+        VmaDefragmentationMove& move = pass.pMoves[i];
+        auto it = tracked.find(move.srcAllocation);
+        VkMemoryPropertyFlags memory_flags;
+        vmaGetAllocationMemoryProperties(allocator, move.srcAllocation, &memory_flags);
+        if(it == tracked.end() || (memory_flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+        {
+            move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            continue;
+        }
+        if(it->second.is_image)
+        {
+            recordImageMove(cmd, move, it->second);
+        }
+        else
+        {
+            recordBufferMove(cmd, move, it->second);
+        }
+        pass_moves++;
+    }
+
+    barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT
+    };
+    vkCmdPipelineBarrier2(cmd, &dep_info);
+
+    pass_active = true;
+    pass_frame = frame_value;
+}
+
+void Defragmenter::endPass()
+{
+    for(const Replaced& old : replaced)
+    {
+        if(old.is_image)
+        {
+            vkDestroyImageView(device, old.view, nullptr);
+            vkDestroyImage(device, (VkImage)old.handle, nullptr);
+        }
+        else
+        {
+            vkDestroyBuffer(device, (VkBuffer)old.handle, nullptr);
+        }
+    }
+    replaced.clear();
+    VkResult result = vmaEndDefragmentationPass(allocator, context, &pass);
+    pass_active = false;
+    //a pass where every move was ignored would repeat forever
+    if(result == VK_SUCCESS || pass_moves == 0)
+    {
+        endRun();
+    }
+}
+
+void Defragmenter::endRun()
+{
+    VmaDefragmentationStats stats = {};
+    vmaEndDefragmentation(allocator, context, &stats);
+    context = VK_NULL_HANDLE;
+    bytes_moved += stats.bytesMoved;
+    bytes_reclaimed += stats.bytesFreed;
+    allocations_moved += stats.allocationsMoved;
+    std::cout << "defragmentation finished, moved " << stats.allocationsMoved << " allocations (" << stats.bytesMoved / 1024
+        << " KiB), reclaimed " << stats.bytesFreed / 1024 << " KiB in " << stats.deviceMemoryBlocksFreed << " blocks" << std::endl;
+}
+
+void Defragmenter::beginFrame(uint64_t completed_value)
+{
+    if(pass_active && completed_value >= pass_frame)
+    {
+        endPass();
+    }
+}
+
+void Defragmenter::finish()
+{
+    if(pass_active)
+    {
+        endPass();
+    }
+    if(context != VK_NULL_HANDLE)
+    {
+        endRun();
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <volk/volk.h>
+#include <vma/vk_mem_alloc.h>
+
+#include <vector>
+#include <functional>
+#include <unordered_map>
+
+#include "BufferAlloc.h"
+#include "ImageAlloc.h"
+
+//moves live allocations together with vma's defragmentation passes, a bounded number per frame
+//only tracked resources move, their owner is told the new handle through a callback
+//a pass is recorded into the frame's command buffer and ended once that frame has completed,
+//the old handles are destroyed then and vma releases their memory
+//host visible allocations are never moved, mapped pointers handed out earlier would go stale
+class Defragmenter
+{
+    struct Tracked
+    {
+        bool is_image;
+        uint64_t handle;
+        VkImageView view;
+        VkBufferCreateInfo buffer_info;
+        VkImageCreateInfo image_info;
+        VkImageAspectFlags aspect;
+        VkImageLayout layout;
+        std::function<void(VkBuffer)> buffer_moved;
+        std::function<void(VkImage, VkImageView)> image_moved;
+    };
+
+    struct Replaced
+    {
+        bool is_image;
+        uint64_t handle;
+        VkImageView view;
+    };
+
+    std::unordered_map<VmaAllocation, Tracked> tracked;
+    //handles made unused by the current pass, destroyed when it ends
+    std::vector<Replaced> replaced;
+    VmaDefragmentationContext context = VK_NULL_HANDLE;
+    VmaDefragmentationPassMoveInfo pass = {};
+    bool pass_active = false;
+    uint64_t pass_frame = 0;
+    uint32_t pass_moves = 0;
+    uint64_t last_check_frame = 0;
+    VkDevice device = VK_NULL_HANDLE;
+    VmaAllocator allocator = VK_NULL_HANDLE;
+
+    bool shouldStart(uint64_t frame_value);
+    void endPass();
+    void endRun();
+    void recordBufferMove(VkCommandBuffer cmd, VmaDefragmentationMove& move, Tracked& target);
+    void recordImageMove(VkCommandBuffer cmd, VmaDefragmentationMove& move, Tracked& target);
+
+public:
+    uint32_t max_moves_per_frame = 8;
+    VkDeviceSize max_bytes_per_frame = 16 * 1024 * 1024;
+    //a run starts when unused bytes inside device memory blocks exceed both limits, checked every check_interval frames
+    float unused_ratio_trigger = 0.25f;
+    VkDeviceSize unused_bytes_trigger = 32 * 1024 * 1024;
+    uint32_t check_interval = 120;
+
+    //totals over every finished run
+    VkDeviceSize bytes_moved = 0;
+    VkDeviceSize bytes_reclaimed = 0;
+    uint32_t allocations_moved = 0;
+
+    void setup(VkDevice device, VmaAllocator allocator);
+
+    //on_moved runs while recording the frame that copies the data, later commands must use the new handle
+    //size and usage are what the buffer was created with, the replacement is created the same way
+    void trackBuffer(const BufferAlloc& buffer, VkDeviceSize size, VkBufferUsageFlags usage, std::function<void(VkBuffer)>&& on_moved);
+    //layout is the layout the image rests in between frames, it is left in the same layout after a move
+    void trackImage(const ImageAlloc& image, const VkImageCreateInfo& create_info, VkImageAspectFlags aspect, VkImageLayout layout, std::function<void(VkImage, VkImageView)>&& on_moved);
+
+    //call before retiring or destroying a tracked allocation
+    void untrack(VmaAllocation allocation);
+
+    //call once per frame before the retirement queue, ends the pass of a completed frame
+    void beginFrame(uint64_t completed_value);
+
+    //starts a run when memory looks fragmented and records the next pass's copies into cmd
+    void recordMoves(VkCommandBuffer cmd, uint64_t frame_value);
+
+    //call with the device idle, ends any pass and run in progress
+    void finish();
+};
@@ -0,0 +1,102 @@
+#include "DrawPackets.h"
+
+#include <algorithm>
+#include <array>
+
+constexpr uint32_t depth_bits = 24;
+//packets per histogram chunk, smaller sorts run on the calling thread in a single chunk
+constexpr size_t sort_grain = 2048;
+
+static uint64_t field(uint64_t value, uint32_t bits)
+{
+    return value & ((1ull << bits) - 1);
+}
+
+uint64_t drawSortKey(DrawLayer layer, uint32_t pipeline, uint32_t page, uint32_t texture_index, uint32_t mesh, float depth)
+{
+    uint64_t quantized = static_cast<uint64_t>(glm::clamp(depth, 0.0f, 1.0f) * static_cast<float>((1u << depth_bits) - 1));
+    uint64_t state = field(pipeline, 6) << 22 | field(page, 8) << 14 | field(texture_index, 14);
+    if(layer == DrawLayer::Transparent)
+    {
+        uint64_t far_first = ((1ull << depth_bits) - 1) - quantized;
+        return 1ull << 62 | far_first << 38 | state << 10 | field(mesh, 10);
+    }
+    return state << 34 | quantized << 10 | field(mesh, 10);
+}
+
+void sortDrawPackets(JobSystem& jobs, FrameVector<DrawPacket>& packets)
+{
+    size_t count = packets.size();
+    if(count < 2)
+    {
+        return;
+    }
+    //bytes where every key agrees would leave the order unchanged
+    uint64_t any_set = 0;
+    uint64_t all_set = ~0ull;
+    for(const DrawPacket& packet : packets)
+    {
+        any_set |= packet.sort_key;
+        all_set &= packet.sort_key;
+    }
+    uint64_t varying = any_set ^ all_set;
+    if(varying == 0)
+    {
+        return;
+    }
+
+    FrameArena& arena = FrameArena::local();
+    size_t chunk_count = std::min<size_t>((count + sort_grain - 1) / sort_grain, jobs.workerCount() + 1);
+    size_t chunk_size = (count + chunk_count - 1) / chunk_count;
+    FrameVector<std::array<uint32_t, 256>> histograms(chunk_count, arena);
+    FrameVector<DrawPacket> scratch(count, arena);
+    DrawPacket* source = packets.data();
+    DrawPacket* target = scratch.data();
+
+    for(uint32_t shift = 0; shift < 64; shift += 8)
+    {
+        if(((varying >> shift) & 0xff) == 0)
+        {
+            continue;
+        }
+        jobs.parallelFor(0, chunk_count, 1, [&](size_t begin, size_t end)
+        {
+            for(size_t chunk = begin; chunk < end; chunk++)
+            {
+                std::array<uint32_t, 256>& histogram = histograms[chunk];
+                histogram.fill(0);
+                for(size_t i = chunk * chunk_size; i < std::min(count, (chunk + 1) * chunk_size); i++)
+                {
+                    histogram[(source[i].sort_key >> shift) & 0xff]++;
+                }
+            }
+        });
+        //digit major, chunk minor, so each chunk scatters into its own ranges and the sort stays stable
+        uint32_t offset = 0;
+        for(uint32_t digit = 0; digit < 256; digit++)
+        {
+            for(size_t chunk = 0; chunk < chunk_count; chunk++)
+            {
+                uint32_t digit_count = histograms[chunk][digit];
+                histograms[chunk][digit] = offset;
+                offset += digit_count;
+            }
+        }
+        jobs.parallelFor(0, chunk_count, 1, [&](size_t begin, size_t end)
+        {
+            for(size_t chunk = begin; chunk < end; chunk++)
+            {
+                std::array<uint32_t, 256>& offsets = histograms[chunk];
+                for(size_t i = chunk * chunk_size; i < std::min(count, (chunk + 1) * chunk_size); i++)
+                {
+                    target[offsets[(source[i].sort_key >> shift) & 0xff]++] = source[i];
+                }
+            }
+        });
+        std::swap(source, target);
+    }
+    if(source != packets.data())
+    {
+        std::copy(source, source + count, packets.data());
+    }
+}
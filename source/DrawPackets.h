@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "FrameArena.h"
+#include "JobSystem.h"
+#include "Model.h"
+
+//one draw collected from the scene before recording starts
+struct DrawPacket
+{
+    const Model* model;
+    const glm::mat4* transform;
+    uint32_t texture_index;
+    uint32_t instance_id;
+    //recording order, built by drawSortKey
+    uint64_t sort_key;
+};
+
+//most significant part of the key, every opaque draw is recorded before any transparent one
+enum class DrawLayer : uint32_t
+{
+    Opaque = 0,
+    Transparent = 1
+};
+
+//opaque:      [layer 2][pipeline 6][geometry page 8][texture 14][depth 24][mesh 10]
+//transparent: [layer 2][inverted depth 24][pipeline 6][geometry page 8][texture 14][mesh 10]
+//opaque draws are grouped by state and go front to back inside a group for early z,
+//transparent ones need back to front for blending so depth comes before any state
+//depth is the view depth normalized to [0, 1] between the near and far plane
+uint64_t drawSortKey(DrawLayer layer, uint32_t pipeline, uint32_t page, uint32_t texture_index, uint32_t mesh, float depth);
+
+//stable lsd radix sort by sort_key, 8 bits per pass with passes over bytes every key shares skipped
+//each pass histograms and scatters chunks of packets as jobs, scratch memory comes from the frame arena
+void sortDrawPackets(JobSystem& jobs, FrameVector<DrawPacket>& packets);
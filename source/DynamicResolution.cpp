@@ -0,0 +1,107 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+void DynamicResolution::setup(Engine* engine)
+{
+    device = engine->device;
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(engine->physical_device, &properties);
+    timestamp_period = properties.limits.timestampPeriod;
+    supported = properties.limits.timestampComputeAndGraphics;
+    if(!supported)
+    {
+        std::cout << "timestamps not supported, dynamic resolution stays at max scale" << std::endl;
+        scale = max_scale;
+        return;
+    }
+    VkQueryPoolCreateInfo query_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = max_frames_in_flight * 2
+    };
+    vkCreateQueryPool(device, &query_pool_create_info, nullptr, &query_pool);
+    std::cout << "dynamic resolution setup complete" << std::endl;
+}
+
+void DynamicResolution::update(uint32_t frame_index)
+{
+    if(!supported || !written[frame_index])
+    {
+        return;
+    }
+    //the frame that wrote these has completed, no need to wait
+    std::array<uint64_t, 2> timestamps;
+    VkResult result = vkGetQueryPoolResults(device, query_pool, frame_index * 2, 2, sizeof(timestamps), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    written[frame_index] = false;
+    if(result != VK_SUCCESS)
+    {
+        return;
+    }
+    float frame_ms = static_cast<float>(timestamps[1] - timestamps[0]) * timestamp_period / 1000000.0f;
+    gpu_frame_ms = gpu_frame_ms == 0.0f ? frame_ms : gpu_frame_ms * 0.9f + frame_ms * 0.1f;
+
+    if(!enabled)
+    {
+        scale = max_scale;
+        return;
+    }
+    //hysteresis, a spike has to last a few frames and recovery a lot more before the scale moves
+    frames_over = gpu_frame_ms > target_frame_ms ? frames_over + 1 : 0;
+    frames_under = gpu_frame_ms < target_frame_ms * headroom ? frames_under + 1 : 0;
+    float new_scale = scale;
+    if(frames_over >= scale_down_frames)
+    {
+        //cost follows pixel count, so the axis scale moves with the square root of the ratio
+        new_scale = scale * std::max(std::sqrt(target_frame_ms / gpu_frame_ms), 0.75f);
+    }
+    else if(frames_under >= scale_up_frames)
+    {
+        new_scale = scale * std::min(std::sqrt(target_frame_ms * headroom / gpu_frame_ms), 1.1f);
+    }
+    new_scale = std::clamp(new_scale, min_scale, max_scale);
+    if(new_scale != scale)
+    {
+        std::cout << "render scale " << scale << " -> " << new_scale << ", gpu frame " << gpu_frame_ms << " ms" << std::endl;
+        scale = new_scale;
+        frames_over = 0;
+        frames_under = 0;
+    }
+}
+
+void DynamicResolution::writeBegin(VkCommandBuffer cmd, uint32_t frame_index)
+{
+    if(!supported)
+    {
+        return;
+    }
+    vkCmdResetQueryPool(cmd, query_pool, frame_index * 2, 2);
+    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, query_pool, frame_index * 2);
+}
+
+void DynamicResolution::writeEnd(VkCommandBuffer cmd, uint32_t frame_index)
+{
+    if(!supported)
+    {
+        return;
+    }
+    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, query_pool, frame_index * 2 + 1);
+    written[frame_index] = true;
+}
+
+VkExtent2D DynamicResolution::renderExtent(uint32_t width, uint32_t height, VkExtent2D limit) const
+{
+    return {
+        .width = std::clamp(static_cast<uint32_t>(width * scale), 1u, limit.width),
+        .height = std::clamp(static_cast<uint32_t>(height * scale), 1u, limit.height)
+    };
+}
+
+void DynamicResolution::destroy()
+{
+    if(query_pool != VK_NULL_HANDLE)
+    {
+        vkDestroyQueryPool(device, query_pool, nullptr);
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <volk/volk.h>
+
+#include <array>
+#include <iostream>
+
+#include "Engine.h"
+
+//scales the internal render resolution to hold a gpu frame time budget
+//each frame slot brackets its scene passes with two timestamps, they are read back
+//when the slot comes around again, so the controller sees times frames_in_flight frames late
+//the scale drops quickly once the budget is exceeded and climbs back slowly with headroom
+class DynamicResolution
+{
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueryPool query_pool = VK_NULL_HANDLE;
+    float timestamp_period = 1.0f;
+    bool supported = false;
+    std::array<bool, max_frames_in_flight> written = {};
+    uint32_t frames_over = 0;
+    uint32_t frames_under = 0;
+
+public:
+    bool enabled = true;
+    float target_frame_ms = 16.0f;
+    float min_scale = 0.5f;
+    //above 1 only helps if the attachments are allocated larger than the window
+    float max_scale = 1.0f;
+    //scale per axis the next frame renders at
+    float scale = 1.0f;
+    //scale up only while the gpu time is below this fraction of the budget
+    float headroom = 0.8f;
+    uint32_t scale_down_frames = 3;
+    uint32_t scale_up_frames = 60;
+    //exponentially smoothed gpu time of completed frames
+    float gpu_frame_ms = 0.0f;
+
+    void setup(Engine* engine);
+
+    //reads the slot's previous timestamps and adjusts scale, call after the frame scheduler's beginFrame
+    void update(uint32_t frame_index);
+
+    //brackets the frame's work up to the main pass, the upscale blit is left out since it waits for the swapchain image
+    void writeBegin(VkCommandBuffer cmd, uint32_t frame_index);
+    void writeEnd(VkCommandBuffer cmd, uint32_t frame_index);
+
+    //size to render at for an output of width by height, never larger than limit
+    VkExtent2D renderExtent(uint32_t width, uint32_t height, VkExtent2D limit) const;
+
+    void destroy();
+};
@@ -1,6 +1,8 @@
 #include "Engine.h"
 
-Engine::Engine()
+#include <cstring>
+
+Engine::Engine(InstrumentationLevel instrumentation_level)
 {
     //init volk
     volkInitialize();
@@ -8,6 +10,7 @@ Engine::Engine()
 
     SDL_Init(SDL_INIT_VIDEO);
     std::cout << "SDL initialized" << std::endl; 
+    job_system.start();
     
     window = SDL_CreateWindow("vulkan_render", 
         WINDOW_WIDTH, 
@@ -16,11 +19,11 @@ Engine::Engine()
     std::cout << "SDL window created" << std::endl;
 
     //vulkan initialization
-    std::vector<const char*> validation_layers = {
-        "VK_LAYER_KHRONOS_validation"
-    };
     uint32_t instance_extension_count = 0;
-    char const* const* instance_extensions = SDL_Vulkan_GetInstanceExtensions(&instance_extension_count);
+    char const* const* sdl_extensions = SDL_Vulkan_GetInstanceExtensions(&instance_extension_count);
+    std::vector<const char*> instance_extensions(sdl_extensions, sdl_extensions + instance_extension_count);
+    std::vector<const char*> instance_layers;
+    const void* instance_next = instrumentation.configureInstance(instrumentation_level, instance_layers, instance_extensions);
     VkApplicationInfo app_info = {
         .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
         .pApplicationName = "vulkan_render",
@@ -28,17 +31,19 @@ Engine::Engine()
     };
     VkInstanceCreateInfo create_info = {
         .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+        .pNext = instance_next,
         .pApplicationInfo = &app_info,
-        .enabledLayerCount = (uint32_t)validation_layers.size(),
-        .ppEnabledLayerNames = validation_layers.data(),
-        .enabledExtensionCount = instance_extension_count,
-        .ppEnabledExtensionNames = instance_extensions
+        .enabledLayerCount = (uint32_t)instance_layers.size(),
+        .ppEnabledLayerNames = instance_layers.data(),
+        .enabledExtensionCount = (uint32_t)instance_extensions.size(),
+        .ppEnabledExtensionNames = instance_extensions.data()
     };
     vkCreateInstance(&create_info, nullptr, &instance);
     std::cout << "Vulkan instance created" << std::endl;
 
     volkLoadInstance(instance);
     std::cout << "volk loaded" << std::endl;
+    instrumentation.createMessenger(instance);
 
     SDL_Vulkan_CreateSurface(window, instance, nullptr, &surface);
     std::cout << "surface created" << std::endl;
@@ -54,6 +59,10 @@ Engine::Engine()
     std::cout << "got surface capabilities from physical device" << std::endl;
 
     vmaSetup();
+
+    frame_scheduler.setup(device);
+    retirement_queue.setup(device, allocator);
+    defragmenter.setup(device, allocator);
 }
 
 void Engine::physicalDeviceSelection()
@@ -86,15 +95,47 @@ void Engine::logicalDeviceCreation()
     VkDeviceQueueCreateInfo queue_create_info;
     queueFamilySelection(&queue_create_info);
 
-    const std::vector<const char*> device_extensions = {
+    std::vector<const char*> device_extensions = {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME
     };
+    if(deviceExtensionSupported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+    {
+        device_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        memory_budget_supported = true;
+    }
+    VkPhysicalDeviceMeshShaderFeaturesEXT supported_mesh_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT
+    };
+    if(deviceExtensionSupported(VK_EXT_MESH_SHADER_EXTENSION_NAME))
+    {
+        VkPhysicalDeviceFeatures2 supported_features2 = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &supported_mesh_features
+        };
+        vkGetPhysicalDeviceFeatures2(physical_device, &supported_features2);
+        mesh_shader_supported = supported_mesh_features.taskShader && supported_mesh_features.meshShader;
+    }
+    if(mesh_shader_supported)
+    {
+        device_extensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+    }
+    std::cout << "mesh shaders " << (mesh_shader_supported ? "supported" : "not supported, drawing with the vertex pipeline") << std::endl;
+    VkPhysicalDeviceMeshShaderFeaturesEXT enabled_mesh_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT,
+        .taskShader = true,
+        .meshShader = true
+    };
     VkPhysicalDeviceVulkan12Features enabled_vk12_features = {
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        .pNext = mesh_shader_supported ? &enabled_mesh_features : nullptr,
         .descriptorIndexing = true,
         .shaderSampledImageArrayNonUniformIndexing = true,
+        .descriptorBindingSampledImageUpdateAfterBind = true,
+        .descriptorBindingUpdateUnusedWhilePending = true,
+        .descriptorBindingPartiallyBound = true,
         .descriptorBindingVariableDescriptorCount = true,
         .runtimeDescriptorArray = true,
+        .timelineSemaphore = true,
         .bufferDeviceAddress = true
     };
     const VkPhysicalDeviceVulkan13Features enabled_vk13_features = {
@@ -103,8 +144,14 @@ void Engine::logicalDeviceCreation()
         .synchronization2 = true,
         .dynamicRendering = true,
     };
+    //block compressed formats are enabled whenever present, basis textures transcode to them
+    vkGetPhysicalDeviceFeatures(physical_device, &supported_features);
     const VkPhysicalDeviceFeatures enabled_vk10_features = {
-        .samplerAnisotropy = VK_TRUE
+        .samplerAnisotropy = VK_TRUE,
+        .textureCompressionETC2 = supported_features.textureCompressionETC2,
+        .textureCompressionASTC_LDR = supported_features.textureCompressionASTC_LDR,
+        .textureCompressionBC = supported_features.textureCompressionBC,
+        .pipelineStatisticsQuery = supported_features.pipelineStatisticsQuery
     };
 
     VkDeviceCreateInfo device_create_info = {
@@ -163,6 +210,22 @@ void Engine::queueFamilySelection(VkDeviceQueueCreateInfo* queue_create_info)
     };
 }
 
+bool Engine::deviceExtensionSupported(const char* extension_name)
+{
+    uint32_t extension_count = 0;
+    vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, nullptr);
+    std::vector<VkExtensionProperties> extensions(extension_count);
+    vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, extensions.data());
+    for(const auto& extension : extensions)
+    {
+        if(strcmp(extension.extensionName, extension_name) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 void Engine::vmaSetup()
 {
     VmaVulkanFunctions vk_functions = {
@@ -170,22 +233,39 @@ void Engine::vmaSetup()
         .vkGetDeviceProcAddr = vkGetDeviceProcAddr,
         .vkCreateImage = vkCreateImage
     };
+    VmaAllocatorCreateFlags allocator_flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+    if(memory_budget_supported)
+    {
+        allocator_flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    }
     VmaAllocatorCreateInfo allocator_create_info = {
-        .flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT,
+        .flags = allocator_flags,
         .physicalDevice = physical_device,
         .device = device,
         .pVulkanFunctions = &vk_functions,
-        .instance = instance
+        .instance = instance,
+        .vulkanApiVersion = VK_API_VERSION_1_3
     };
     vmaCreateAllocator(&allocator_create_info, &allocator);
+
+    memory_budget.setup(allocator, memory_budget_supported);
 }
 
 void Engine::cleanup()
 {
     vkDeviceWaitIdle(device);
 
+    //moved allocations must not be freed before their pass ends
+    defragmenter.finish();
+    retirement_queue.flushAll();
     main_deletion_queue.flush();
+    job_system.shutdown();
+    frame_scheduler.destroy();
 
+    if(memory_budget.dump_interval_frames != 0)
+    {
+        memory_budget.dumpJson();
+    }
     vmaDestroyAllocator(allocator);
 
     if(device != VK_NULL_HANDLE)
@@ -200,6 +280,7 @@ void Engine::cleanup()
     }
     if(instance != VK_NULL_HANDLE)
     {
+        instrumentation.destroy(instance);
         vkDestroyInstance(instance, nullptr);
 
     }
@@ -12,9 +12,17 @@
 
 #include <vma/vk_mem_alloc.h>
 
+#include "MemoryBudget.h"
+#include "RetirementQueue.h"
+#include "FrameScheduler.h"
+#include "Defragmenter.h"
+#include "JobSystem.h"
+#include "Instrumentation.h"
+
 #define WINDOW_WIDTH 1280
 #define WINDOW_HEIGHT 720
 
+//shutdown only, resources released while rendering go through Engine::retirement_queue
 struct DeletionQueue {
     std::deque<std::function<void()>> deletors;
 
@@ -46,14 +54,26 @@ public:
     VkSurfaceCapabilitiesKHR surface_caps;
     VmaAllocator allocator;
     uint32_t queue_family_index;
+    VkPhysicalDeviceFeatures supported_features;
+    bool memory_budget_supported = false;
+    //VK_EXT_mesh_shader with task shaders, Pipeline only creates the meshlet path when it is set
+    bool mesh_shader_supported = false;
 
     DeletionQueue main_deletion_queue;
+    //started before anything else so loaders can submit jobs, shut down after the deletion queue
+    JobSystem job_system;
+    FrameScheduler frame_scheduler;
+    RetirementQueue retirement_queue;
+    Defragmenter defragmenter;
+    MemoryBudget memory_budget;
+    Instrumentation instrumentation;
     
-    Engine();
+    Engine(InstrumentationLevel instrumentation_level = instrumentationLevelFromEnvironment());
 
     void physicalDeviceSelection();
     void logicalDeviceCreation();
     void queueFamilySelection(VkDeviceQueueCreateInfo* queue_create_info);
+    bool deviceExtensionSupported(const char* extension_name);
     void vmaSetup();
     void cleanup();
 };
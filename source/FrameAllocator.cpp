@@ -0,0 +1,86 @@
+#include "FrameAllocator.h"
+
+#include <algorithm>
+
+BufferAlloc FrameAllocator::createBuffer(VkDeviceSize size)
+{
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    //mapped writes are required, so no transfer fallback unlike static buffers
+    VmaAllocationCreateFlags vma_flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    return BufferAlloc::create(engine->allocator, engine->device, size, usage, vma_flags, MemoryCategory::PerFrame);
+}
+
+void FrameAllocator::setup(Engine* engine)
+{
+    this->engine = engine;
+    for(Slot& slot : slots)
+    {
+        slot.buffers.push_back(createBuffer(initial_size));
+    }
+    current = &slots[0];
+    std::cout << "frame allocator setup complete" << std::endl;
+}
+
+void FrameAllocator::beginFrame(uint32_t frame_index)
+{
+    high_water_mark = std::max(high_water_mark, frame_bytes);
+    frame_bytes = 0;
+
+    current = &slots[frame_index];
+    if(current->buffers.size() > 1)
+    {
+        //the frame that chained these has completed, replace them with one buffer that fits it
+        VkDeviceSize size = initial_size;
+        while(size < high_water_mark)
+        {
+            size *= 2;
+        }
+        for(auto& buffer : current->buffers)
+        {
+            buffer.destroy();
+        }
+        current->buffers.clear();
+        current->buffers.push_back(createBuffer(size));
+        std::cout << "frame allocator slot " << frame_index << " merged into " << size / 1024 << " KiB" << std::endl;
+    }
+    current->offset = 0;
+}
+
+FrameAllocation FrameAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+    VkDeviceSize offset = (current->offset + alignment - 1) & ~(alignment - 1);
+    if(offset + size > current->buffers.back().size)
+    {
+        //chain a buffer at least twice the last one so a growing frame settles in a few steps
+        VkDeviceSize grown = std::max(current->buffers.back().size * 2, size + alignment);
+        current->buffers.push_back(createBuffer(grown));
+        grow_count++;
+        offset = 0;
+    }
+    BufferAlloc& buffer = current->buffers.back();
+    current->offset = offset + size;
+    frame_bytes += size;
+
+    return {
+        .data = static_cast<char*>(buffer.allocation_info.pMappedData) + offset,
+        .address = buffer.device_address + offset,
+        .buffer = buffer.handle,
+        .offset = offset
+    };
+}
+
+void FrameAllocator::destroy()
+{
+    for(Slot& slot : slots)
+    {
+        for(auto& buffer : slot.buffers)
+        {
+            buffer.destroy();
+        }
+        slot.buffers.clear();
+    }
+    if(grow_count > 0 || high_water_mark > 0)
+    {
+        std::cout << "frame allocator: high water mark " << high_water_mark << " bytes, grew " << grow_count << " times" << std::endl;
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <volk/volk.h>
+#include <vma/vk_mem_alloc.h>
+
+#include <array>
+#include <vector>
+#include <cstring>
+
+#include "Engine.h"
+#include "BufferAlloc.h"
+
+//transient shader data written by the cpu this frame and read by the gpu through its address
+struct FrameAllocation
+{
+    void* data;
+    VkDeviceAddress address;
+    VkBuffer buffer;
+    VkDeviceSize offset;
+};
+
+//bump allocator over persistently mapped host visible buffers, one set per frame slot
+//a slot is reset when the frame scheduler hands it out again, so allocations live exactly one frame
+//running out of space chains another buffer for the rest of the frame,
+//the next time the slot comes around its buffers are merged into one sized for the high water mark
+class FrameAllocator
+{
+    struct Slot
+    {
+        std::vector<BufferAlloc> buffers;
+        VkDeviceSize offset = 0;
+    };
+
+    std::array<Slot, max_frames_in_flight> slots;
+    Slot* current = nullptr;
+    Engine* engine = nullptr;
+
+    BufferAlloc createBuffer(VkDeviceSize size);
+
+public:
+    //size of each slot's first buffer
+    VkDeviceSize initial_size = 256 * 1024;
+    //bytes allocated by the frame being recorded
+    VkDeviceSize frame_bytes = 0;
+    //largest frame_bytes seen, merged buffers are sized from it
+    VkDeviceSize high_water_mark = 0;
+    uint32_t grow_count = 0;
+
+    void setup(Engine* engine);
+
+    //call after the frame scheduler's beginFrame, the slot's previous frame has completed
+    void beginFrame(uint32_t frame_index);
+
+    //alignment must be a power of two
+    FrameAllocation allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+
+    //copies value into frame memory and returns its device address
+    template<typename T>
+    VkDeviceAddress push(const T& value)
+    {
+        FrameAllocation allocation = allocate(sizeof(T), alignof(T) < 16 ? 16 : alignof(T));
+        memcpy(allocation.data, &value, sizeof(T));
+        return allocation.address;
+    }
+
+    void destroy();
+};
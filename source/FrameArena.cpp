@@ -0,0 +1,74 @@
+#include "FrameArena.h"
+
+#include <iostream>
+#include <algorithm>
+
+std::atomic<uint64_t> FrameArena::frame_epoch = 0;
+
+FrameArena::FrameArena(size_t capacity)
+{
+    base.data = std::make_unique<std::byte[]>(capacity);
+    base.size = capacity;
+}
+
+void FrameArena::reset()
+{
+    peak = std::max(peak, used);
+    if(!overflow.empty())
+    {
+        //one reallocation per growth, steady state frames fit into base
+        size_t size = base.size;
+        while(size < peak)
+        {
+            size *= 2;
+        }
+        overflow.clear();
+        base.data = std::make_unique<std::byte[]>(size);
+        base.size = size;
+        std::cout << "frame arena grown to " << size / 1024 << " KiB" << std::endl;
+    }
+    offset = 0;
+    used = 0;
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment)
+{
+    Block& block = overflow.empty() ? base : overflow.back();
+    uintptr_t start = reinterpret_cast<uintptr_t>(block.data.get());
+    uintptr_t aligned = (start + offset + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if(aligned + size > start + block.size)
+    {
+        Block extra;
+        extra.size = std::max(block.size, size + alignment);
+        extra.data = std::make_unique<std::byte[]>(extra.size);
+        start = reinterpret_cast<uintptr_t>(extra.data.get());
+        aligned = (start + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        overflow.push_back(std::move(extra));
+        overflow_count++;
+    }
+    offset = aligned + size - start;
+    used += size;
+    return reinterpret_cast<void*>(aligned);
+}
+
+size_t FrameArena::capacity() const
+{
+    return base.size;
+}
+
+FrameArena& FrameArena::local()
+{
+    thread_local FrameArena arena;
+    uint64_t current = frame_epoch.load(std::memory_order_relaxed);
+    if(arena.epoch != current)
+    {
+        arena.epoch = current;
+        arena.reset();
+    }
+    return arena;
+}
+
+void FrameArena::beginFrame()
+{
+    frame_epoch.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <atomic>
+
+//linear scratch memory for data built and thrown away within one frame
+//every thread gets its own arena through local(), so allocation never locks
+//an arena resets itself the first time its thread asks for it after FrameArena::beginFrame()
+class FrameArena
+{
+    struct Block
+    {
+        std::unique_ptr<std::byte[]> data;
+        size_t size = 0;
+    };
+
+    Block base;
+    //blocks taken when base runs out, folded into a larger base on the next reset
+    std::vector<Block> overflow;
+    size_t offset = 0;
+    uint64_t epoch = 0;
+
+    static std::atomic<uint64_t> frame_epoch;
+
+    void reset();
+
+public:
+    //bytes handed out since the last reset
+    size_t used = 0;
+    //largest used seen at a reset, the base block grows to it after an overflow
+    size_t peak = 0;
+    uint32_t overflow_count = 0;
+
+    explicit FrameArena(size_t capacity = 1024 * 1024);
+
+    //alignment must be a power of two, the memory is not initialized
+    void* allocate(size_t size, size_t alignment);
+
+    size_t capacity() const;
+
+    //arena of the calling thread, pointers from it stay valid until the next frame
+    static FrameArena& local();
+
+    //call once per frame on the render thread before building the frame
+    static void beginFrame();
+};
+
+//std allocator over a frame arena, deallocate is a no-op and the memory goes away with the frame
+template<typename T>
+struct ArenaAllocator
+{
+    using value_type = T;
+
+    FrameArena* arena;
+
+    ArenaAllocator(FrameArena& arena) : arena(&arena) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t count)
+    {
+        return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, size_t) {}
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const
+    {
+        return arena == other.arena;
+    }
+};
+
+template<typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
@@ -0,0 +1,97 @@
+#include "FrameScheduler.h"
+
+#include <iostream>
+#include <algorithm>
+
+void FrameScheduler::setup(VkDevice device)
+{
+    this->device = device;
+    VkSemaphoreTypeCreateInfo type_create_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0
+    };
+    VkSemaphoreCreateInfo semaphore_create_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &type_create_info
+    };
+    vkCreateSemaphore(device, &semaphore_create_info, nullptr, &timeline);
+    std::cout << "frame timeline semaphore created" << std::endl;
+}
+
+void FrameScheduler::destroy()
+{
+    if(timeline != VK_NULL_HANDLE)
+    {
+        vkDestroySemaphore(device, timeline, nullptr);
+        timeline = VK_NULL_HANDLE;
+    }
+}
+
+void FrameScheduler::setFramesInFlight(uint32_t count)
+{
+    count = std::clamp(count, 1u, max_frames_in_flight);
+    if(count == frames_in_flight)
+    {
+        return;
+    }
+    //slot indices change with the count, so no submitted frame may still own one
+    wait(frame_value - 1);
+    frames_in_flight = count;
+    std::cout << "frames in flight set to " << frames_in_flight << std::endl;
+}
+
+void FrameScheduler::beginFrame()
+{
+    if(frame_value > frames_in_flight)
+    {
+        wait(frame_value - frames_in_flight);
+    }
+    vkGetSemaphoreCounterValue(device, timeline, &completed_value);
+}
+
+uint32_t FrameScheduler::frameIndex() const
+{
+    return static_cast<uint32_t>(frame_value % frames_in_flight);
+}
+
+VkSemaphoreSubmitInfo FrameScheduler::signalInfo() const
+{
+    return {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .semaphore = timeline,
+        .value = frame_value,
+        .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT
+    };
+}
+
+void FrameScheduler::endFrame()
+{
+    frame_value++;
+}
+
+uint64_t FrameScheduler::completedValue() const
+{
+    return completed_value;
+}
+
+bool FrameScheduler::isComplete(uint64_t value) const
+{
+    return value <= completed_value;
+}
+
+void FrameScheduler::wait(uint64_t value)
+{
+    if(value == 0 || value <= completed_value)
+    {
+        return;
+    }
+    VkSemaphoreWaitInfo wait_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &timeline,
+        .pValues = &value
+    };
+    vkWaitSemaphores(device, &wait_info, UINT64_MAX);
+    completed_value = value;
+}
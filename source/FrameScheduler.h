@@ -0,0 +1,47 @@
+#pragma once
+#include <volk/volk.h>
+
+#include <cstdint>
+
+//upper bound for frames in flight, per-frame resources are allocated for this many slots
+constexpr uint32_t max_frames_in_flight = 4;
+
+//paces the cpu against the gpu with one timeline semaphore
+//every submitted frame signals its frame value, so anything tagged with a value
+//can be released once completedValue() has reached it, no per-frame fences needed
+class FrameScheduler
+{
+    VkDevice device = VK_NULL_HANDLE;
+    uint64_t completed_value = 0;
+
+public:
+    VkSemaphore timeline = VK_NULL_HANDLE;
+    uint32_t frames_in_flight = 2;
+    //value the frame being recorded signals, starts at 1 so 0 means nothing has been submitted
+    uint64_t frame_value = 1;
+
+    void setup(VkDevice device);
+    void destroy();
+
+    //clamped to 1..max_frames_in_flight, waits for every submitted frame when the count changes
+    void setFramesInFlight(uint32_t count);
+
+    //blocks until the frame that last used this frame's slot has completed
+    void beginFrame();
+
+    //slot of the frame being recorded, indexes per-frame resources
+    uint32_t frameIndex() const;
+
+    //signal info for the frame's submit, the gpu sets the timeline to frame_value when done
+    VkSemaphoreSubmitInfo signalInfo() const;
+
+    //call after submitting, moves recording to the next frame value
+    void endFrame();
+
+    //last frame value the gpu has finished, refreshed by beginFrame()
+    uint64_t completedValue() const;
+    bool isComplete(uint64_t value) const;
+
+    //blocks until the gpu reaches value
+    void wait(uint64_t value);
+};
@@ -0,0 +1,204 @@
+#include "FrameStats.h"
+
+#include <SDL3/SDL.h>
+
+#include <algorithm>
+
+void RenderCounters::add(const RenderCounters& other)
+{
+    draws += other.draws;
+    mesh_draws += other.mesh_draws;
+    instances += other.instances;
+    triangles += other.triangles;
+    meshlets += other.meshlets;
+    buffer_binds += other.buffer_binds;
+    push_constant_bytes += other.push_constant_bytes;
+    descriptor_binds += other.descriptor_binds;
+    pipeline_binds += other.pipeline_binds;
+}
+
+void PipelineStatistics::add(const PipelineStatistics& other)
+{
+    input_vertices += other.input_vertices;
+    vertex_invocations += other.vertex_invocations;
+    clipping_primitives += other.clipping_primitives;
+    fragment_invocations += other.fragment_invocations;
+}
+
+void FrameStats::setup(Engine* engine)
+{
+    device = engine->device;
+    supported = engine->supported_features.pipelineStatisticsQuery;
+    if(!supported)
+    {
+        std::cout << "pipeline statistics queries not supported, frame stats are cpu counters only" << std::endl;
+        return;
+    }
+    //results come back in bit order, which is the field order of PipelineStatistics
+    VkQueryPoolCreateInfo query_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+        .queryCount = max_frames_in_flight * max_passes,
+        .pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT
+    };
+    vkCreateQueryPool(device, &query_pool_create_info, nullptr, &query_pool);
+    std::cout << "frame stats setup complete" << std::endl;
+}
+
+void FrameStats::update(uint32_t frame_index)
+{
+    std::vector<std::string>& names = slot_passes[frame_index];
+    if(!supported || names.empty())
+    {
+        return;
+    }
+    //the frame that wrote these has completed, no need to wait
+    std::vector<PipelineStatistics> results(names.size());
+    VkResult result = vkGetQueryPoolResults(device, query_pool, frame_index * max_passes, static_cast<uint32_t>(names.size()),
+        results.size() * sizeof(PipelineStatistics), results.data(), sizeof(PipelineStatistics), VK_QUERY_RESULT_64_BIT);
+    if(result == VK_SUCCESS)
+    {
+        resolved_passes.clear();
+        for(size_t i = 0; i < names.size(); i++)
+        {
+            resolved_passes.push_back({names[i], results[i]});
+            auto it = std::find_if(window_passes.begin(), window_passes.end(), [&](const PassStatistics& p){ return p.name == names[i]; });
+            if(it == window_passes.end())
+            {
+                window_passes.push_back({names[i], {}});
+                it = window_passes.end() - 1;
+            }
+            it->stats.add(results[i]);
+        }
+        window_gpu_frames++;
+    }
+    names.clear();
+}
+
+void FrameStats::beginFrame(VkCommandBuffer cmd, uint32_t frame_index)
+{
+    recording_slot = frame_index;
+    slot_passes[frame_index].clear();
+    if(!supported)
+    {
+        return;
+    }
+    vkCmdResetQueryPool(cmd, query_pool, frame_index * max_passes, max_passes);
+}
+
+void FrameStats::beginPass(VkCommandBuffer cmd, const char* name)
+{
+    std::vector<std::string>& names = slot_passes[recording_slot];
+    if(!supported || names.size() >= max_passes)
+    {
+        return;
+    }
+    vkCmdBeginQuery(cmd, query_pool, recording_slot * max_passes + static_cast<uint32_t>(names.size()), 0);
+    names.push_back(name);
+    query_open = true;
+}
+
+void FrameStats::endPass(VkCommandBuffer cmd)
+{
+    if(!query_open)
+    {
+        return;
+    }
+    vkCmdEndQuery(cmd, query_pool, recording_slot * max_passes + static_cast<uint32_t>(slot_passes[recording_slot].size()) - 1);
+    query_open = false;
+}
+
+void FrameStats::endFrame()
+{
+    last_counters = counters;
+    total_counters.add(counters);
+    window_counters.add(counters);
+    counters = {};
+    total_frames++;
+    window_frames++;
+
+    uint64_t now = SDL_GetTicks();
+    if(window_start == 0)
+    {
+        window_start = now;
+    }
+    if(now - window_start >= log_interval_ms)
+    {
+        if(log_enabled)
+        {
+            logWindow();
+        }
+        window_passes.clear();
+        window_counters = {};
+        window_frames = 0;
+        window_gpu_frames = 0;
+        window_start = now;
+    }
+}
+
+void FrameStats::logWindow()
+{
+    //per frame averages, a pass that only ran in some frames is averaged over all of them
+    auto average = [](uint64_t sum, uint32_t frames){ return frames == 0 ? 0 : sum / frames; };
+    std::cout << "frame stats, " << window_frames << " frames: "
+        << average(window_counters.draws, window_frames) << " draws ("
+        << average(window_counters.mesh_draws, window_frames) << " mesh shaded), "
+        << average(window_counters.instances, window_frames) << " instances, "
+        << average(window_counters.triangles, window_frames) << " triangles, "
+        << average(window_counters.meshlets, window_frames) << " meshlets, "
+        << average(window_counters.buffer_binds, window_frames) << " buffer binds, "
+        << average(window_counters.pipeline_binds, window_frames) << " pipeline binds, "
+        << average(window_counters.descriptor_binds, window_frames) << " descriptor binds, "
+        << average(window_counters.push_constant_bytes, window_frames) << " push constant bytes";
+    for(const PassStatistics& pass : window_passes)
+    {
+        std::cout << " | " << pass.name << " vertex path: "
+            << average(pass.stats.input_vertices, window_gpu_frames) << " vertices, "
+            << average(pass.stats.vertex_invocations, window_gpu_frames) << " vs, "
+            << average(pass.stats.clipping_primitives, window_gpu_frames) << " primitives, "
+            << average(pass.stats.fragment_invocations, window_gpu_frames) << " fs";
+    }
+    std::cout << std::endl;
+}
+
+const std::vector<PassStatistics>& FrameStats::passStatistics() const
+{
+    return resolved_passes;
+}
+
+const PipelineStatistics* FrameStats::passStatistics(const char* name) const
+{
+    for(const PassStatistics& pass : resolved_passes)
+    {
+        if(pass.name == name)
+        {
+            return &pass.stats;
+        }
+    }
+    return nullptr;
+}
+
+const RenderCounters& FrameStats::lastCounters() const
+{
+    return last_counters;
+}
+
+void FrameStats::logTotals() const
+{
+    std::cout << "frame stats totals, " << total_frames << " frames: " << total_counters.draws << " draws ("
+        << total_counters.mesh_draws << " mesh shaded), "
+        << total_counters.triangles << " triangles, " << total_counters.meshlets << " meshlets, " << total_counters.buffer_binds << " buffer binds, "
+        << total_counters.pipeline_binds << " pipeline binds, " << total_counters.descriptor_binds << " descriptor binds" << std::endl;
+}
+
+void FrameStats::destroy()
+{
+    if(query_pool != VK_NULL_HANDLE)
+    {
+        vkDestroyQueryPool(device, query_pool, nullptr);
+        query_pool = VK_NULL_HANDLE;
+    }
+}
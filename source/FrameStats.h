@@ -0,0 +1,106 @@
+#pragma once
+#include <volk/volk.h>
+
+#include <array>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Engine.h"
+
+//what the draw recording submitted, counted on the cpu while recording
+struct RenderCounters
+{
+    uint64_t draws = 0;
+    //the part of draws that went through the mesh shader path, the pass statistics do not cover them
+    uint64_t mesh_draws = 0;
+    uint64_t instances = 0;
+    //before meshlet culling for mesh shader draws
+    uint64_t triangles = 0;
+    //meshlets handed to task shaders, the ones they cull are still counted
+    uint64_t meshlets = 0;
+    //vertex and index buffer binds
+    uint64_t buffer_binds = 0;
+    uint64_t push_constant_bytes = 0;
+    uint64_t descriptor_binds = 0;
+    uint64_t pipeline_binds = 0;
+
+    void add(const RenderCounters& other);
+};
+
+//VK_QUERY_TYPE_PIPELINE_STATISTICS results of the vertex pipeline draws of one pass, in the order the query returns them
+struct PipelineStatistics
+{
+    uint64_t input_vertices = 0;
+    uint64_t vertex_invocations = 0;
+    uint64_t clipping_primitives = 0;
+    uint64_t fragment_invocations = 0;
+
+    void add(const PipelineStatistics& other);
+};
+
+struct PassStatistics
+{
+    std::string name;
+    PipelineStatistics stats;
+};
+
+//gpu pipeline statistics per pass and cpu counters per frame
+//like DynamicResolution's timestamps, each frame slot owns a range of queries that is read back
+//without waiting when the slot comes around again, so gpu numbers are frames_in_flight frames late
+//both are averaged over log_interval_ms and logged as one line
+class FrameStats
+{
+    static constexpr uint32_t max_passes = 8;
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueryPool query_pool = VK_NULL_HANDLE;
+    bool supported = false;
+    //passes that began a query in each slot's last recording, in query order
+    std::array<std::vector<std::string>, max_frames_in_flight> slot_passes;
+    uint32_t recording_slot = 0;
+    bool query_open = false;
+
+    std::vector<PassStatistics> resolved_passes;
+    RenderCounters last_counters;
+    RenderCounters total_counters;
+    uint64_t total_frames = 0;
+
+    //sums since the last log line
+    std::vector<PassStatistics> window_passes;
+    RenderCounters window_counters;
+    uint32_t window_frames = 0;
+    uint32_t window_gpu_frames = 0;
+    uint64_t window_start = 0;
+
+    void logWindow();
+
+public:
+    bool log_enabled = true;
+    uint32_t log_interval_ms = 1000;
+    //filled by the frame being recorded, folded in by endFrame
+    RenderCounters counters;
+
+    void setup(Engine* engine);
+
+    //reads the slot's previous queries, call after the frame scheduler's beginFrame
+    void update(uint32_t frame_index);
+    //resets the slot's queries, call outside any rendering before the first pass
+    void beginFrame(VkCommandBuffer cmd, uint32_t frame_index);
+    //brackets the vertex pipeline draws of a pass, passes past max_passes in a frame are not counted
+    //begun inside vkCmdBeginRendering it has to end before vkCmdEndRendering, and no mesh shader draw may fall inside
+    void beginPass(VkCommandBuffer cmd, const char* name);
+    void endPass(VkCommandBuffer cmd);
+    //closes the cpu counters of the recorded frame and logs once per log_interval_ms
+    void endFrame();
+
+    //latest resolved gpu statistics, one entry per pass that ran
+    const std::vector<PassStatistics>& passStatistics() const;
+    //nullptr when the pass did not run in the latest resolved frame
+    const PipelineStatistics* passStatistics(const char* name) const;
+    //counters of the last recorded frame
+    const RenderCounters& lastCounters() const;
+
+    void logTotals() const;
+    void destroy();
+};
@@ -0,0 +1,489 @@
+#include "GeometryHeap.h"
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+GeometryHeap::Page GeometryHeap::createPage(uint32_t vertex_capacity, uint32_t index_capacity)
+{
+    VkDeviceSize position_region = ((VkDeviceSize)vertex_capacity * sizeof(Vertex) + 255) & ~(VkDeviceSize)255;
+    Page page = {
+        .vertex_capacity = vertex_capacity,
+        .index_capacity = index_capacity,
+        .position_region = position_region,
+        .index_region = (position_region + (VkDeviceSize)vertex_capacity * sizeof(glm::vec3) + 255) & ~(VkDeviceSize)255
+    };
+    VkDeviceSize size = page.index_region + (VkDeviceSize)index_capacity * sizeof(uint16_t);
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    VmaAllocationCreateFlags vma_flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_ALLOW_TRANSFER_INSTEAD_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    page.buffer = BufferAlloc::create(engine->allocator, engine->device, size, usage, vma_flags, MemoryCategory::Geometry);
+    //pages are found by allocation since compaction swaps them around
+    VmaAllocation allocation = page.buffer.allocation;
+    engine->defragmenter.trackBuffer(page.buffer, size, usage, [this, allocation](VkBuffer moved)
+    {
+        for(Page& p : pages)
+        {
+            if(p.buffer.allocation == allocation)
+            {
+                p.buffer.handle = moved;
+                VkBufferDeviceAddressInfo address_info = {
+                    .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+                    .buffer = moved
+                };
+                p.buffer.device_address = vkGetBufferDeviceAddress(engine->device, &address_info);
+            }
+        }
+    });
+
+    VmaVirtualBlockCreateInfo vertex_block_create_info = {
+        .size = vertex_capacity
+    };
+    vmaCreateVirtualBlock(&vertex_block_create_info, &page.vertex_block);
+    VmaVirtualBlockCreateInfo index_block_create_info = {
+        .size = index_capacity
+    };
+    vmaCreateVirtualBlock(&index_block_create_info, &page.index_block);
+
+    std::cout << "geometry page created, " << size / (1024 * 1024) << " MiB" << std::endl;
+    return page;
+}
+
+void GeometryHeap::destroyPage(Page& page)
+{
+    engine->defragmenter.untrack(page.buffer.allocation);
+    vmaClearVirtualBlock(page.vertex_block);
+    vmaDestroyVirtualBlock(page.vertex_block);
+    vmaClearVirtualBlock(page.index_block);
+    vmaDestroyVirtualBlock(page.index_block);
+    page.buffer.destroy();
+}
+
+bool GeometryHeap::allocateIn(uint32_t page_index, uint32_t vertex_count, uint32_t index_count, GeometryMesh& mesh)
+{
+    Page& page = pages[page_index];
+    VmaVirtualAllocationCreateInfo vertex_alloc_info = {
+        .size = vertex_count
+    };
+    VkDeviceSize vertex_offset;
+    if(vmaVirtualAllocate(page.vertex_block, &vertex_alloc_info, &mesh.vertex_allocation, &vertex_offset) != VK_SUCCESS)
+    {
+        return false;
+    }
+    VmaVirtualAllocationCreateInfo index_alloc_info = {
+        .size = index_count
+    };
+    VkDeviceSize index_offset;
+    if(vmaVirtualAllocate(page.index_block, &index_alloc_info, &mesh.index_allocation, &index_offset) != VK_SUCCESS)
+    {
+        vmaVirtualFree(page.vertex_block, mesh.vertex_allocation);
+        return false;
+    }
+    mesh.page = page_index;
+    mesh.vertex_offset = static_cast<uint32_t>(vertex_offset);
+    mesh.first_index = static_cast<uint32_t>(index_offset);
+    return true;
+}
+
+float GeometryHeap::pageFragmentation(uint32_t page_index, VkDeviceSize* free_bytes) const
+{
+    const Page& page = pages[page_index];
+    VmaDetailedStatistics vertex_stats;
+    VmaDetailedStatistics index_stats;
+    vmaCalculateVirtualBlockStatistics(page.vertex_block, &vertex_stats);
+    vmaCalculateVirtualBlockStatistics(page.index_block, &index_stats);
+
+    VkDeviceSize vertex_free = (page.vertex_capacity - vertex_stats.statistics.allocationBytes) * sizeof(Vertex);
+    VkDeviceSize index_free = (page.index_capacity - index_stats.statistics.allocationBytes) * sizeof(uint16_t);
+    VkDeviceSize vertex_largest = vertex_stats.unusedRangeCount > 0 ? vertex_stats.unusedRangeSizeMax * sizeof(Vertex) : 0;
+    VkDeviceSize index_largest = index_stats.unusedRangeCount > 0 ? index_stats.unusedRangeSizeMax * sizeof(uint16_t) : 0;
+
+    *free_bytes = vertex_free + index_free;
+    if(*free_bytes == 0)
+    {
+        return 0.0f;
+    }
+    //free space that is not part of the largest range is unusable for a mesh that needs it all
+    return 1.0f - static_cast<float>(vertex_largest + index_largest) / static_cast<float>(*free_bytes);
+}
+
+//meshlets, then their vertex indices, then their triangles
+static void packMeshlets(char* dst, const MeshletData& meshlets)
+{
+    VkDeviceSize meshlet_bytes = meshlets.meshlets.size() * sizeof(Meshlet);
+    VkDeviceSize vertex_bytes = meshlets.vertices.size() * sizeof(uint32_t);
+    memcpy(dst, meshlets.meshlets.data(), meshlet_bytes);
+    memcpy(dst + meshlet_bytes, meshlets.vertices.data(), vertex_bytes);
+    memcpy(dst + meshlet_bytes + vertex_bytes, meshlets.triangles.data(), meshlets.triangles.size() * sizeof(uint32_t));
+}
+
+void GeometryHeap::setup(Engine* engine)
+{
+    this->engine = engine;
+    read_stages = VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT | VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT;
+    read_access = VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT;
+    if(engine->mesh_shader_supported)
+    {
+        read_stages |= VK_PIPELINE_STAGE_2_TASK_SHADER_BIT_EXT | VK_PIPELINE_STAGE_2_MESH_SHADER_BIT_EXT;
+        read_access |= VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+    }
+    pages.push_back(createPage(page_vertex_capacity, page_index_capacity));
+}
+
+uint32_t GeometryHeap::allocate(uint32_t vertex_count, uint32_t index_count)
+{
+    GeometryMesh mesh = {
+        .vertex_count = vertex_count,
+        .index_count = index_count,
+        .live = true,
+        .freed_frame = 0
+    };
+    bool placed = false;
+    for(uint32_t i = 0; i < pages.size() && !placed; i++)
+    {
+        placed = allocateIn(i, vertex_count, index_count, mesh);
+    }
+    if(!placed)
+    {
+        pages.push_back(createPage(std::max(page_vertex_capacity, vertex_count), std::max(page_index_capacity, index_count)));
+        allocateIn(static_cast<uint32_t>(pages.size() - 1), vertex_count, index_count, mesh);
+    }
+
+    uint32_t id;
+    if(!free_ids.empty())
+    {
+        id = free_ids.back();
+        free_ids.pop_back();
+        meshes[id] = mesh;
+    }
+    else
+    {
+        id = static_cast<uint32_t>(meshes.size());
+        meshes.push_back(mesh);
+    }
+    return id;
+}
+
+bool GeometryHeap::writeMapped(uint32_t mesh_id, const Vertex* vertices, const uint16_t* indices)
+{
+    const GeometryMesh& m = meshes[mesh_id];
+    const Page& page = pages[m.page];
+    char* mapped = static_cast<char*>(page.buffer.allocation_info.pMappedData);
+    if(!mapped)
+    {
+        return false;
+    }
+    memcpy(mapped + (VkDeviceSize)m.vertex_offset * sizeof(Vertex), vertices, (VkDeviceSize)m.vertex_count * sizeof(Vertex));
+    glm::vec3* positions = reinterpret_cast<glm::vec3*>(mapped + page.position_region) + m.vertex_offset;
+    for(uint32_t i = 0; i < m.vertex_count; i++)
+    {
+        positions[i] = vertices[i].pos;
+    }
+    memcpy(mapped + page.index_region + (VkDeviceSize)m.first_index * sizeof(uint16_t), indices, (VkDeviceSize)m.index_count * sizeof(uint16_t));
+    return true;
+}
+
+void GeometryHeap::recordUpload(VkCommandBuffer cmd, uint32_t mesh_id, const Vertex* vertices, const uint16_t* indices)
+{
+    const GeometryMesh& m = meshes[mesh_id];
+    const Page& page = pages[m.page];
+    VkDeviceSize vertex_bytes = (VkDeviceSize)m.vertex_count * sizeof(Vertex);
+    VkDeviceSize position_bytes = (VkDeviceSize)m.vertex_count * sizeof(glm::vec3);
+    VkDeviceSize index_bytes = (VkDeviceSize)m.index_count * sizeof(uint16_t);
+
+    BufferAlloc staging = BufferAlloc::create(engine->allocator,
+        engine->device,
+        vertex_bytes + position_bytes + index_bytes,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        MemoryCategory::Staging);
+    char* staging_data = static_cast<char*>(staging.allocation_info.pMappedData);
+    memcpy(staging_data, vertices, vertex_bytes);
+    glm::vec3* positions = reinterpret_cast<glm::vec3*>(staging_data + vertex_bytes);
+    for(uint32_t i = 0; i < m.vertex_count; i++)
+    {
+        positions[i] = vertices[i].pos;
+    }
+    memcpy(staging_data + vertex_bytes + position_bytes, indices, index_bytes);
+
+    std::array<VkBufferCopy, 3> copies = {
+        VkBufferCopy{
+            .srcOffset = 0,
+            .dstOffset = (VkDeviceSize)m.vertex_offset * sizeof(Vertex),
+            .size = vertex_bytes
+        },
+        VkBufferCopy{
+            .srcOffset = vertex_bytes,
+            .dstOffset = page.position_region + (VkDeviceSize)m.vertex_offset * sizeof(glm::vec3),
+            .size = position_bytes
+        },
+        VkBufferCopy{
+            .srcOffset = vertex_bytes + position_bytes,
+            .dstOffset = page.index_region + (VkDeviceSize)m.first_index * sizeof(uint16_t),
+            .size = index_bytes
+        }
+    };
+    vkCmdCopyBuffer(cmd, staging.handle, page.buffer.handle, static_cast<uint32_t>(copies.size()), copies.data());
+
+    VkMemoryBarrier2 barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = read_stages,
+        .dstAccessMask = read_access
+    };
+    VkDependencyInfo dep_info = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier
+    };
+    vkCmdPipelineBarrier2(cmd, &dep_info);
+
+    engine->retirement_queue.retire(staging);
+}
+
+bool GeometryHeap::writeMeshlets(uint32_t mesh_id, const MeshletData& meshlets)
+{
+    GeometryMesh& m = meshes[mesh_id];
+    m.meshlet_count = static_cast<uint32_t>(meshlets.meshlets.size());
+    m.meshlet_vertices_offset = (VkDeviceSize)meshlets.meshlets.size() * sizeof(Meshlet);
+    m.meshlet_triangles_offset = m.meshlet_vertices_offset + (VkDeviceSize)meshlets.vertices.size() * sizeof(uint32_t);
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    VmaAllocationCreateFlags vma_flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_ALLOW_TRANSFER_INSTEAD_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    m.meshlet_buffer = BufferAlloc::create(engine->allocator, engine->device, meshlets.sizeBytes(), usage, vma_flags, MemoryCategory::Geometry);
+    char* mapped = static_cast<char*>(m.meshlet_buffer.allocation_info.pMappedData);
+    if(!mapped)
+    {
+        return false;
+    }
+    packMeshlets(mapped, meshlets);
+    return true;
+}
+
+void GeometryHeap::recordMeshletUpload(VkCommandBuffer cmd, uint32_t mesh_id, const MeshletData& meshlets)
+{
+    const GeometryMesh& m = meshes[mesh_id];
+    VkDeviceSize size = meshlets.sizeBytes();
+    BufferAlloc staging = BufferAlloc::create(engine->allocator,
+        engine->device,
+        size,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        MemoryCategory::Staging);
+    packMeshlets(static_cast<char*>(staging.allocation_info.pMappedData), meshlets);
+    VkBufferCopy copy = {
+        .srcOffset = 0,
+        .dstOffset = 0,
+        .size = size
+    };
+    vkCmdCopyBuffer(cmd, staging.handle, m.meshlet_buffer.handle, 1, &copy);
+
+    VkMemoryBarrier2 barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_TASK_SHADER_BIT_EXT | VK_PIPELINE_STAGE_2_MESH_SHADER_BIT_EXT,
+        .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT
+    };
+    VkDependencyInfo dep_info = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier
+    };
+    vkCmdPipelineBarrier2(cmd, &dep_info);
+
+    engine->retirement_queue.retire(staging);
+}
+
+void GeometryHeap::free(uint32_t mesh_id)
+{
+    GeometryMesh& m = meshes[mesh_id];
+    if(!m.live)
+    {
+        return;
+    }
+    m.live = false;
+    m.freed_frame = frame;
+    pending_frees.push_back(mesh_id);
+}
+
+void GeometryHeap::beginFrame(uint64_t frame_value, uint64_t completed_value)
+{
+    frame = frame_value;
+    auto it = std::remove_if(pending_frees.begin(), pending_frees.end(), [&](uint32_t id)
+    {
+        GeometryMesh& m = meshes[id];
+        if(m.freed_frame > completed_value)
+        {
+            return false;
+        }
+        //compaction drops the ranges of freed meshes instead of moving them
+        if(m.vertex_allocation != VK_NULL_HANDLE)
+        {
+            vmaVirtualFree(pages[m.page].vertex_block, m.vertex_allocation);
+            vmaVirtualFree(pages[m.page].index_block, m.index_allocation);
+            m.vertex_allocation = VK_NULL_HANDLE;
+            m.index_allocation = VK_NULL_HANDLE;
+        }
+        m.meshlet_buffer.destroy();
+        m.meshlet_count = 0;
+        free_ids.push_back(id);
+        return true;
+    });
+    pending_frees.erase(it, pending_frees.end());
+}
+
+bool GeometryHeap::compact(VkCommandBuffer cmd)
+{
+    uint32_t target = UINT32_MAX;
+    float worst = compact_threshold;
+    for(uint32_t i = 0; i < pages.size(); i++)
+    {
+        VkDeviceSize free_bytes;
+        float fragmentation = pageFragmentation(i, &free_bytes);
+        if(fragmentation > worst && free_bytes >= compact_min_free * pages[i].buffer.size)
+        {
+            worst = fragmentation;
+            target = i;
+        }
+    }
+    if(target == UINT32_MAX)
+    {
+        return false;
+    }
+
+    Page& old_page = pages[target];
+    Page fresh = createPage(old_page.vertex_capacity, old_page.index_capacity);
+    FrameVector<VkBufferCopy> copies(FrameArena::local());
+    VkDeviceSize moved_bytes = 0;
+
+    //a fresh block allocates front to back, so moving the live meshes in any order packs them
+    std::swap(pages[target], fresh);
+    for(GeometryMesh& m : meshes)
+    {
+        if(m.page != target || m.vertex_allocation == VK_NULL_HANDLE)
+        {
+            continue;
+        }
+        if(!m.live)
+        {
+            m.vertex_allocation = VK_NULL_HANDLE;
+            m.index_allocation = VK_NULL_HANDLE;
+            continue;
+        }
+        uint32_t old_vertex_offset = m.vertex_offset;
+        uint32_t old_first_index = m.first_index;
+        allocateIn(target, m.vertex_count, m.index_count, m);
+        copies.push_back({
+            .srcOffset = (VkDeviceSize)old_vertex_offset * sizeof(Vertex),
+            .dstOffset = (VkDeviceSize)m.vertex_offset * sizeof(Vertex),
+            .size = (VkDeviceSize)m.vertex_count * sizeof(Vertex)
+        });
+        copies.push_back({
+            .srcOffset = fresh.position_region + (VkDeviceSize)old_vertex_offset * sizeof(glm::vec3),
+            .dstOffset = pages[target].position_region + (VkDeviceSize)m.vertex_offset * sizeof(glm::vec3),
+            .size = (VkDeviceSize)m.vertex_count * sizeof(glm::vec3)
+        });
+        copies.push_back({
+            .srcOffset = fresh.index_region + (VkDeviceSize)old_first_index * sizeof(uint16_t),
+            .dstOffset = pages[target].index_region + (VkDeviceSize)m.first_index * sizeof(uint16_t),
+            .size = (VkDeviceSize)m.index_count * sizeof(uint16_t)
+        });
+        moved_bytes += copies[copies.size() - 3].size + copies[copies.size() - 2].size + copies.back().size;
+    }
+    if(!copies.empty())
+    {
+        vkCmdCopyBuffer(cmd, fresh.buffer.handle, pages[target].buffer.handle, static_cast<uint32_t>(copies.size()), copies.data());
+    }
+    VkMemoryBarrier2 barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = read_stages,
+        .dstAccessMask = read_access
+    };
+    VkDependencyInfo dep_info = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier
+    };
+    vkCmdPipelineBarrier2(cmd, &dep_info);
+
+    //after the swap fresh holds the old page, frames in flight still draw from its buffer
+    engine->defragmenter.untrack(fresh.buffer.allocation);
+    engine->retirement_queue.retire(fresh.buffer);
+    destroyPage(fresh);
+    std::cout << "geometry page " << target << " compacted, fragmentation " << worst << ", moved " << moved_bytes / 1024 << " KiB" << std::endl;
+    return true;
+}
+
+const GeometryMesh& GeometryHeap::mesh(uint32_t mesh_id) const
+{
+    return meshes[mesh_id];
+}
+
+VkBuffer GeometryHeap::buffer(uint32_t page) const
+{
+    return pages[page].buffer.handle;
+}
+
+VkDeviceSize GeometryHeap::positionRegion(uint32_t page) const
+{
+    return pages[page].position_region;
+}
+
+VkDeviceSize GeometryHeap::indexRegion(uint32_t page) const
+{
+    return pages[page].index_region;
+}
+
+VkDeviceAddress GeometryHeap::vertexAddress(uint32_t mesh_id) const
+{
+    const GeometryMesh& m = meshes[mesh_id];
+    return pages[m.page].buffer.device_address + (VkDeviceAddress)m.vertex_offset * sizeof(Vertex);
+}
+
+GeometryStats GeometryHeap::stats() const
+{
+    GeometryStats result = {
+        .pages = static_cast<uint32_t>(pages.size()),
+        .meshes = static_cast<uint32_t>(meshes.size() - free_ids.size())
+    };
+    VkDeviceSize total_free = 0;
+    float weighted = 0.0f;
+    for(uint32_t i = 0; i < pages.size(); i++)
+    {
+        VkDeviceSize free_bytes;
+        float fragmentation = pageFragmentation(i, &free_bytes);
+        VkDeviceSize capacity = (VkDeviceSize)pages[i].vertex_capacity * sizeof(Vertex) + (VkDeviceSize)pages[i].index_capacity * sizeof(uint16_t);
+        result.capacity += capacity;
+        result.used += capacity - free_bytes;
+        total_free += free_bytes;
+        weighted += fragmentation * free_bytes;
+    }
+    result.fragmentation = total_free > 0 ? weighted / total_free : 0.0f;
+    return result;
+}
+
+void GeometryHeap::logStats() const
+{
+    GeometryStats s = stats();
+    std::cout << "geometry heap: " << s.meshes << " meshes in " << s.pages << " pages, "
+        << s.used / 1024 << " / " << s.capacity / 1024 << " KiB used, fragmentation " << s.fragmentation << std::endl;
+}
+
+void GeometryHeap::destroy()
+{
+    for(Page& page : pages)
+    {
+        destroyPage(page);
+    }
+    for(GeometryMesh& m : meshes)
+    {
+        m.meshlet_buffer.destroy();
+    }
+    pages.clear();
+    meshes.clear();
+    free_ids.clear();
+    pending_frees.clear();
+}
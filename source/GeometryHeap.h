@@ -0,0 +1,122 @@
+#pragma once
+#include <volk/volk.h>
+#include <vma/vk_mem_alloc.h>
+
+#include <vector>
+
+#include "Engine.h"
+#include "BufferAlloc.h"
+#include "Model.h"
+#include "Meshlets.h"
+
+//where one mesh lives inside the heap, offsets are in elements so draws use firstIndex/vertexOffset
+struct GeometryMesh
+{
+    uint32_t page;
+    uint32_t vertex_offset;
+    uint32_t vertex_count;
+    uint32_t first_index;
+    uint32_t index_count;
+    VmaVirtualAllocation vertex_allocation;
+    VmaVirtualAllocation index_allocation;
+    //meshlets, their vertex indices and triangles in one buffer of their own, empty without mesh shaders
+    //kept out of the pages so compaction never moves them and their device address stays valid
+    BufferAlloc meshlet_buffer;
+    uint32_t meshlet_count;
+    //byte offsets inside meshlet_buffer
+    VkDeviceSize meshlet_vertices_offset;
+    VkDeviceSize meshlet_triangles_offset;
+    bool live;
+    //frame value of the free() call
+    uint64_t freed_frame;
+};
+
+struct GeometryStats
+{
+    uint32_t pages;
+    uint32_t meshes;
+    VkDeviceSize capacity;
+    VkDeviceSize used;
+    //1 - largest free range / total free, averaged over pages weighted by free bytes
+    float fragmentation;
+};
+
+//vertex and index data of every mesh sub-allocated from a few large buffers
+//each page is one buffer split into a vertex region, a position only copy of it and an index region
+//vertices and indices are each managed by a VmaVirtualBlock
+//counting in vertices and indices, so a page is bound once and meshes are selected by draw offsets
+//meshes are referred to by id, compaction moves them without the owners noticing
+class GeometryHeap
+{
+    struct Page
+    {
+        BufferAlloc buffer;
+        VmaVirtualBlock vertex_block;
+        VmaVirtualBlock index_block;
+        uint32_t vertex_capacity;
+        uint32_t index_capacity;
+        //byte offsets inside buffer, positions mirror the vertex region for depth only passes
+        VkDeviceSize position_region;
+        VkDeviceSize index_region;
+    };
+
+    std::vector<Page> pages;
+    std::vector<GeometryMesh> meshes;
+    std::vector<uint32_t> free_ids;
+    std::vector<uint32_t> pending_frees;
+    Engine* engine = nullptr;
+    uint64_t frame = 0;
+    //stages and accesses that read uploaded geometry, mesh shaders read vertices and meshlets as storage
+    VkPipelineStageFlags2 read_stages = 0;
+    VkAccessFlags2 read_access = 0;
+
+    Page createPage(uint32_t vertex_capacity, uint32_t index_capacity);
+    void destroyPage(Page& page);
+    bool allocateIn(uint32_t page_index, uint32_t vertex_count, uint32_t index_count, GeometryMesh& mesh);
+    float pageFragmentation(uint32_t page_index, VkDeviceSize* free_bytes) const;
+
+public:
+    //default page size, larger meshes get a page of their own
+    uint32_t page_vertex_capacity = 1024 * 1024;
+    uint32_t page_index_capacity = 4 * 1024 * 1024;
+    //a page is compacted when its fragmentation and its free share are both above these
+    float compact_threshold = 0.5f;
+    float compact_min_free = 0.25f;
+
+    void setup(Engine* engine);
+
+    //returns a mesh id, the ranges are uninitialized until written with upload()
+    uint32_t allocate(uint32_t vertex_count, uint32_t index_count);
+
+    //copies into the mesh through the mapped page, false when the page is not host visible
+    bool writeMapped(uint32_t mesh_id, const Vertex* vertices, const uint16_t* indices);
+
+    //copies into the mesh through a staging buffer, retired once the frame being recorded completes
+    void recordUpload(VkCommandBuffer cmd, uint32_t mesh_id, const Vertex* vertices, const uint16_t* indices);
+
+    //creates the mesh's meshlet buffer and copies meshlets into it when it is host visible
+    //false when it is not, the copy is then recorded with recordMeshletUpload()
+    bool writeMeshlets(uint32_t mesh_id, const MeshletData& meshlets);
+    void recordMeshletUpload(VkCommandBuffer cmd, uint32_t mesh_id, const MeshletData& meshlets);
+
+    //the ranges stay untouched until frames recorded up to now have completed
+    void free(uint32_t mesh_id);
+
+    //call once per frame with the value being recorded, releases ranges freed by completed frames
+    void beginFrame(uint64_t frame_value, uint64_t completed_value);
+
+    //moves the live meshes of the most fragmented page into a fresh page with gpu copies recorded into cmd
+    //at most one page per call, returns true when something moved
+    bool compact(VkCommandBuffer cmd);
+
+    const GeometryMesh& mesh(uint32_t mesh_id) const;
+    VkBuffer buffer(uint32_t page) const;
+    VkDeviceSize positionRegion(uint32_t page) const;
+    VkDeviceSize indexRegion(uint32_t page) const;
+    //address of the mesh's first full vertex, changes when compaction or defragmentation moves the mesh
+    VkDeviceAddress vertexAddress(uint32_t mesh_id) const;
+
+    GeometryStats stats() const;
+    void logStats() const;
+    void destroy();
+};
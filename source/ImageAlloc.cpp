@@ -1,19 +1,27 @@
 #include "ImageAlloc.h"
+#include "Instrumentation.h"
 
 ImageAlloc ImageAlloc::create(VmaAllocator allocator, 
     VkDevice device, 
     VkImageCreateInfo image_create_info, 
     VmaAllocationCreateFlags vma_flags, 
-    VkImageAspectFlags aspect_mask)
+    VkImageAspectFlags aspect_mask,
+    MemoryCategory category)
 {
     ImageAlloc img;
     img.allocator = allocator;
     img.device = device;
+    img.category = category;
     VmaAllocationCreateInfo alloc_create_info = {
         .flags = vma_flags,
         .usage = VMA_MEMORY_USAGE_AUTO
     };
-    vmaCreateImage(allocator, &image_create_info, &alloc_create_info, &img.handle, &img.allocation, nullptr);
+    VmaAllocationInfo allocation_info;
+    vmaCreateImage(allocator, &image_create_info, &alloc_create_info, &img.handle, &img.allocation, &allocation_info);
+    vmaSetAllocationName(allocator, img.allocation, memoryCategoryName(category));
+    Instrumentation::setObjectName(device, VK_OBJECT_TYPE_IMAGE, (uint64_t)img.handle, memoryCategoryName(category));
+    img.size = allocation_info.size;
+    MemoryBudget::recordAllocation(category, img.size);
 
     VkImageViewCreateInfo view_create_info = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
@@ -29,6 +37,7 @@ ImageAlloc ImageAlloc::create(VmaAllocator allocator,
         }
     };
     vkCreateImageView(device, &view_create_info, nullptr, &img.view);
+    Instrumentation::setObjectName(device, VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)img.view, memoryCategoryName(category));
     return img;
 }
 
@@ -42,6 +51,7 @@ void ImageAlloc::destroy()
     if(handle != VK_NULL_HANDLE)
     {
         vmaDestroyImage(allocator, handle, allocation);
+        MemoryBudget::recordFree(category, size);
         handle = VK_NULL_HANDLE;
     }
 }
\ No newline at end of file
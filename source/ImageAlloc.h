@@ -1,6 +1,7 @@
 #pragma once
 #include <volk/volk.h>
 #include <vma/vk_mem_alloc.h>
+#include "MemoryBudget.h"
 
 class ImageAlloc
 {
@@ -10,6 +11,8 @@ public:
     VmaAllocation allocation;
     VkImageView view;
     VkDevice device;
+    VkDeviceSize size;
+    MemoryCategory category;
 
     ImageAlloc() = default;
 
@@ -17,7 +20,8 @@ public:
         VkDevice device, 
         VkImageCreateInfo image_create_info, 
         VmaAllocationCreateFlags vma_flags, 
-        VkImageAspectFlags aspect_mask);
+        VkImageAspectFlags aspect_mask,
+        MemoryCategory category = MemoryCategory::Other);
 
     void destroy();
 };  
@@ -0,0 +1,234 @@
+#include "Instrumentation.h"
+
+#include <SDL3/SDL.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+bool Instrumentation::debug_utils = false;
+
+const char* instrumentationLevelName(InstrumentationLevel level)
+{
+    switch(level)
+    {
+        case InstrumentationLevel::Off: return "off";
+        case InstrumentationLevel::Labels: return "labels";
+        case InstrumentationLevel::Validation: return "validation";
+        case InstrumentationLevel::GpuAssisted: return "gpu";
+    }
+    return "unknown";
+}
+
+InstrumentationLevel instrumentationLevelFromEnvironment()
+{
+    const char* value = std::getenv("VKR_INSTRUMENTATION");
+    if(value != nullptr)
+    {
+        for(uint32_t i = 0; i <= (uint32_t)InstrumentationLevel::GpuAssisted; i++)
+        {
+            if(strcmp(value, instrumentationLevelName((InstrumentationLevel)i)) == 0)
+            {
+                return (InstrumentationLevel)i;
+            }
+        }
+        std::cout << "unknown VKR_INSTRUMENTATION " << value << ", expected off, labels, validation or gpu" << std::endl;
+    }
+#ifdef NDEBUG
+    return InstrumentationLevel::Off;
+#else
+    return InstrumentationLevel::Validation;
+#endif
+}
+
+static bool instanceLayerAvailable(const char* layer_name)
+{
+    uint32_t layer_count = 0;
+    vkEnumerateInstanceLayerProperties(&layer_count, nullptr);
+    std::vector<VkLayerProperties> layers(layer_count);
+    vkEnumerateInstanceLayerProperties(&layer_count, layers.data());
+    for(const auto& layer : layers)
+    {
+        if(strcmp(layer.layerName, layer_name) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool instanceExtensionAvailable(const char* layer_name, const char* extension_name)
+{
+    uint32_t extension_count = 0;
+    vkEnumerateInstanceExtensionProperties(layer_name, &extension_count, nullptr);
+    std::vector<VkExtensionProperties> extensions(extension_count);
+    vkEnumerateInstanceExtensionProperties(layer_name, &extension_count, extensions.data());
+    for(const auto& extension : extensions)
+    {
+        if(strcmp(extension.extensionName, extension_name) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+const void* Instrumentation::configureInstance(InstrumentationLevel requested, std::vector<const char*>& layers, std::vector<const char*>& extensions)
+{
+#ifdef VKR_NO_INSTRUMENTATION
+    level = InstrumentationLevel::Off;
+    std::cout << "instrumentation compiled out" << std::endl;
+    return nullptr;
+#else
+    level = requested;
+    const char* validation_layer = "VK_LAYER_KHRONOS_validation";
+    if(level >= InstrumentationLevel::Validation && !instanceLayerAvailable(validation_layer))
+    {
+        std::cout << "validation layer not installed, instrumentation limited to labels" << std::endl;
+        level = InstrumentationLevel::Labels;
+    }
+    if(level >= InstrumentationLevel::Labels && !instanceExtensionAvailable(nullptr, VK_EXT_DEBUG_UTILS_EXTENSION_NAME))
+    {
+        std::cout << "no " << VK_EXT_DEBUG_UTILS_EXTENSION_NAME << ", instrumentation off" << std::endl;
+        level = InstrumentationLevel::Off;
+    }
+    if(level == InstrumentationLevel::GpuAssisted && !instanceExtensionAvailable(validation_layer, VK_EXT_VALIDATION_FEATURES_EXTENSION_NAME))
+    {
+        std::cout << "validation layer without " << VK_EXT_VALIDATION_FEATURES_EXTENSION_NAME << ", no gpu assisted validation" << std::endl;
+        level = InstrumentationLevel::Validation;
+    }
+    std::cout << "instrumentation: " << instrumentationLevelName(level) << std::endl;
+    if(level == InstrumentationLevel::Off)
+    {
+        return nullptr;
+    }
+
+    extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+    debug_utils = true;
+    //chained into instance creation too, so messages from vkCreateInstance and vkDestroyInstance are seen
+    messenger_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT,
+        .messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT,
+        .messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT,
+        .pfnUserCallback = messengerCallback,
+        .pUserData = this
+    };
+    if(level >= InstrumentationLevel::Validation)
+    {
+        layers.push_back(validation_layer);
+    }
+    if(level == InstrumentationLevel::GpuAssisted)
+    {
+        extensions.push_back(VK_EXT_VALIDATION_FEATURES_EXTENSION_NAME);
+        enabled_features = {
+            VK_VALIDATION_FEATURE_ENABLE_GPU_ASSISTED_EXT,
+            VK_VALIDATION_FEATURE_ENABLE_GPU_ASSISTED_RESERVE_BINDING_SLOT_EXT
+        };
+        validation_features = {
+            .sType = VK_STRUCTURE_TYPE_VALIDATION_FEATURES_EXT,
+            .enabledValidationFeatureCount = static_cast<uint32_t>(enabled_features.size()),
+            .pEnabledValidationFeatures = enabled_features.data()
+        };
+        messenger_create_info.pNext = &validation_features;
+    }
+    return &messenger_create_info;
+#endif
+}
+
+void Instrumentation::createMessenger(VkInstance instance)
+{
+    if(level == InstrumentationLevel::Off)
+    {
+        return;
+    }
+    VkDebugUtilsMessengerCreateInfoEXT create_info = messenger_create_info;
+    create_info.pNext = nullptr;
+    vkCreateDebugUtilsMessengerEXT(instance, &create_info, nullptr, &messenger);
+    std::cout << "debug messenger created" << std::endl;
+}
+
+VKAPI_ATTR VkBool32 VKAPI_CALL Instrumentation::messengerCallback(VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+    VkDebugUtilsMessageTypeFlagsEXT types,
+    const VkDebugUtilsMessengerCallbackDataEXT* data,
+    void* user_data)
+{
+    static_cast<Instrumentation*>(user_data)->log(severity, data);
+    return VK_FALSE;
+}
+
+void Instrumentation::log(VkDebugUtilsMessageSeverityFlagBitsEXT severity, const VkDebugUtilsMessengerCallbackDataEXT* data)
+{
+    //the layers call in from whichever thread made the vulkan call
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t now = SDL_GetTicks();
+    MessageWindow& window = message_windows[data->messageIdNumber];
+    if(now - window.window_start >= message_window_ms)
+    {
+        if(window.suppressed > 0)
+        {
+            std::cout << "[vulkan] " << window.suppressed << " more of " << (data->pMessageIdName ? data->pMessageIdName : "message")
+                << " suppressed" << std::endl;
+        }
+        window = {now, 0, 0};
+    }
+    if(window.count >= message_burst)
+    {
+        window.suppressed++;
+        suppressed_count++;
+        return;
+    }
+    window.count++;
+    logged_count++;
+    const char* severity_name = severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT ? "error" : "warning";
+    std::cout << "[vulkan " << severity_name << "] " << data->pMessage << std::endl;
+}
+
+void Instrumentation::destroy(VkInstance instance)
+{
+    if(messenger != VK_NULL_HANDLE)
+    {
+        vkDestroyDebugUtilsMessengerEXT(instance, messenger, nullptr);
+        messenger = VK_NULL_HANDLE;
+        std::cout << "vulkan messages: " << logged_count << " logged, " << suppressed_count << " suppressed by rate limiting" << std::endl;
+    }
+    debug_utils = false;
+}
+
+#ifndef VKR_NO_INSTRUMENTATION
+void Instrumentation::setObjectName(VkDevice device, VkObjectType type, uint64_t handle, const char* name)
+{
+    if(!debug_utils || handle == 0)
+    {
+        return;
+    }
+    VkDebugUtilsObjectNameInfoEXT name_info = {
+        .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT,
+        .objectType = type,
+        .objectHandle = handle,
+        .pObjectName = name
+    };
+    vkSetDebugUtilsObjectNameEXT(device, &name_info);
+}
+
+void Instrumentation::beginLabel(VkCommandBuffer cmd, const char* label)
+{
+    if(!debug_utils)
+    {
+        return;
+    }
+    VkDebugUtilsLabelEXT label_info = {
+        .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT,
+        .pLabelName = label
+    };
+    vkCmdBeginDebugUtilsLabelEXT(cmd, &label_info);
+}
+
+void Instrumentation::endLabel(VkCommandBuffer cmd)
+{
+    if(!debug_utils)
+    {
+        return;
+    }
+    vkCmdEndDebugUtilsLabelEXT(cmd);
+}
+#endif
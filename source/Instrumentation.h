@@ -0,0 +1,80 @@
+#pragma once
+#include <volk/volk.h>
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+//how much checking and debug information the instance is created with, each level includes the ones before it
+enum class InstrumentationLevel : uint32_t
+{
+    //no layers and no extensions, names and labels return right away
+    Off,
+    //VK_EXT_debug_utils only, object names and pass labels for capture tools at no validation cost
+    Labels,
+    //VK_LAYER_KHRONOS_validation with a messenger
+    Validation,
+    //validation with gpu assisted checks of shader accesses, much slower
+    GpuAssisted
+};
+
+const char* instrumentationLevelName(InstrumentationLevel level);
+
+//VKR_INSTRUMENTATION=off|labels|validation|gpu, unset means validation in debug builds and off in release ones
+InstrumentationLevel instrumentationLevelFromEnvironment();
+
+//validation layers, the debug messenger, object names and command buffer labels
+//levels are picked at startup, builds configured with VKR_INSTRUMENTATION=OFF compile names and labels out entirely
+class Instrumentation
+{
+    struct MessageWindow
+    {
+        uint64_t window_start;
+        uint32_t count;
+        uint32_t suppressed;
+    };
+
+    //set when setup adds debug utils to the instance extensions, before vkCreateInstance, cleared by destroy
+    //checked by every name and label call
+    static bool debug_utils;
+
+    VkDebugUtilsMessengerEXT messenger = VK_NULL_HANDLE;
+    VkDebugUtilsMessengerCreateInfoEXT messenger_create_info = {};
+    VkValidationFeaturesEXT validation_features = {};
+    std::vector<VkValidationFeatureEnableEXT> enabled_features;
+    //messages are keyed by their id, the same one repeating every frame would drown the log
+    std::mutex mutex;
+    std::unordered_map<int32_t, MessageWindow> message_windows;
+    uint64_t logged_count = 0;
+    uint64_t suppressed_count = 0;
+
+    static VKAPI_ATTR VkBool32 VKAPI_CALL messengerCallback(VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+        VkDebugUtilsMessageTypeFlagsEXT types,
+        const VkDebugUtilsMessengerCallbackDataEXT* data,
+        void* user_data);
+    void log(VkDebugUtilsMessageSeverityFlagBitsEXT severity, const VkDebugUtilsMessengerCallbackDataEXT* data);
+
+public:
+    InstrumentationLevel level = InstrumentationLevel::Off;
+    //each message id is logged at most message_burst times per message_window_ms
+    uint32_t message_burst = 5;
+    uint32_t message_window_ms = 1000;
+
+    //lowers level to what the loader offers and adds its layers and extensions
+    //returns the pNext chain for VkInstanceCreateInfo, it points into this object
+    const void* configureInstance(InstrumentationLevel requested, std::vector<const char*>& layers, std::vector<const char*>& extensions);
+    //call once the instance functions are loaded
+    void createMessenger(VkInstance instance);
+    void destroy(VkInstance instance);
+
+#ifdef VKR_NO_INSTRUMENTATION
+    static void setObjectName(VkDevice, VkObjectType, uint64_t, const char*) {}
+    static void beginLabel(VkCommandBuffer, const char*) {}
+    static void endLabel(VkCommandBuffer) {}
+#else
+    static void setObjectName(VkDevice device, VkObjectType type, uint64_t handle, const char* name);
+    static void beginLabel(VkCommandBuffer cmd, const char* label);
+    static void endLabel(VkCommandBuffer cmd);
+#endif
+};
@@ -0,0 +1,260 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <iostream>
+
+//queue owned by the calling thread, -1 for threads the job system did not start
+thread_local int32_t local_queue = -1;
+
+void JobSystem::start(uint32_t worker_count)
+{
+    if(worker_count == 0)
+    {
+        worker_count = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    }
+    main_thread = std::this_thread::get_id();
+    for(uint32_t i = 0; i < worker_count; i++)
+    {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for(uint32_t i = 0; i < worker_count; i++)
+    {
+        workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+    std::cout << "job system started with " << worker_count << " workers" << std::endl;
+}
+
+void JobSystem::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+    sleep_cv.notify_all();
+    for(auto& worker : workers)
+    {
+        worker.join();
+    }
+    workers.clear();
+    pumpMainThread();
+    logStats();
+}
+
+uint32_t JobSystem::workerCount() const
+{
+    return static_cast<uint32_t>(workers.size());
+}
+
+bool JobSystem::onMainThread() const
+{
+    return std::this_thread::get_id() == main_thread;
+}
+
+void JobSystem::push(Job&& job)
+{
+    if(queues.empty())
+    {
+        job.run();
+        executed++;
+        return;
+    }
+    //threads outside the system spread their jobs over every worker
+    uint32_t index = local_queue >= 0 ? static_cast<uint32_t>(local_queue) : next_queue++ % static_cast<uint32_t>(queues.size());
+    //counted before it is visible, a thief taking it right away must not take queued below zero
+    queued++;
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->jobs.push_back(std::move(job));
+    }
+    sleep_cv.notify_one();
+}
+
+bool JobSystem::runOne(uint32_t queue_index, const JobCounter* only)
+{
+    std::function<void()> job;
+    bool was_stolen = false;
+    if(only != nullptr)
+    {
+        //oldest first, like a thief would take them
+        for(uint32_t i = 0; !job && i < queues.size(); i++)
+        {
+            uint32_t index = (queue_index + i) % static_cast<uint32_t>(queues.size());
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            std::deque<Job>& jobs = queues[index]->jobs;
+            auto it = std::find_if(jobs.begin(), jobs.end(), [&](const Job& j) { return j.counter == only; });
+            if(it != jobs.end())
+            {
+                job = std::move(it->run);
+                jobs.erase(it);
+                was_stolen = index != queue_index;
+            }
+        }
+    }
+    else if(queue_index < queues.size())
+    {
+        std::lock_guard<std::mutex> lock(queues[queue_index]->mutex);
+        if(!queues[queue_index]->jobs.empty())
+        {
+            job = std::move(queues[queue_index]->jobs.back().run);
+            queues[queue_index]->jobs.pop_back();
+        }
+    }
+    for(uint32_t i = 1; !job && only == nullptr && i <= queues.size(); i++)
+    {
+        Queue& victim = *queues[(queue_index + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if(!victim.jobs.empty())
+        {
+            job = std::move(victim.jobs.front().run);
+            victim.jobs.pop_front();
+            was_stolen = true;
+        }
+    }
+    if(!job)
+    {
+        return false;
+    }
+    queued--;
+    job();
+    executed++;
+    if(was_stolen)
+    {
+        stolen++;
+    }
+    return true;
+}
+
+void JobSystem::workerLoop(uint32_t queue_index)
+{
+    local_queue = static_cast<int32_t>(queue_index);
+    while(true)
+    {
+        if(runOne(queue_index, nullptr))
+        {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        if(stopping && queued == 0)
+        {
+            return;
+        }
+        //timed so a notify racing the emptiness check only costs a millisecond
+        sleep_cv.wait_for(lock, std::chrono::milliseconds(1), [this]() { return stopping || queued > 0; });
+    }
+}
+
+void JobSystem::finish(JobCounter* counter)
+{
+    if(counter == nullptr)
+    {
+        return;
+    }
+    std::vector<Job> ready;
+    {
+        //decremented under the lock, wait() takes it after seeing zero, so a counter on the waiter's stack
+        //outlives this block, nothing after it touches the counter
+        std::lock_guard<std::mutex> lock(counter->mutex);
+        if(counter->pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        {
+            return;
+        }
+        ready.swap(counter->continuations);
+    }
+    for(auto& job : ready)
+    {
+        push(std::move(job));
+    }
+}
+
+void JobSystem::submit(std::function<void()>&& job, JobCounter* counter)
+{
+    if(counter != nullptr)
+    {
+        counter->pending++;
+    }
+    push({[this, job = std::move(job), counter]()
+    {
+        job();
+        finish(counter);
+    }, counter});
+}
+
+void JobSystem::submitAfter(JobCounter* dependency, std::function<void()>&& job, JobCounter* counter)
+{
+    if(counter != nullptr)
+    {
+        counter->pending++;
+    }
+    Job wrapped = {[this, job = std::move(job), counter]()
+    {
+        job();
+        finish(counter);
+    }, counter};
+    {
+        //finish() drains continuations under the same lock, so a job is never left behind
+        std::lock_guard<std::mutex> lock(dependency->mutex);
+        if(!dependency->done())
+        {
+            dependency->continuations.push_back(std::move(wrapped));
+            return;
+        }
+    }
+    push(std::move(wrapped));
+}
+
+void JobSystem::parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body)
+{
+    grain = std::max<size_t>(grain, 1);
+    if(end - begin <= grain || queues.empty())
+    {
+        body(begin, end);
+        return;
+    }
+    JobCounter counter;
+    //the first chunk runs here, the rest is up for grabs
+    for(size_t chunk = begin + grain; chunk < end; chunk += grain)
+    {
+        size_t chunk_end = std::min(chunk + grain, end);
+        submit([&body, chunk, chunk_end]() { body(chunk, chunk_end); }, &counter);
+    }
+    body(begin, begin + grain);
+    wait(&counter);
+}
+
+void JobSystem::wait(JobCounter* counter)
+{
+    uint32_t queue_index = local_queue >= 0 ? static_cast<uint32_t>(local_queue) : 0;
+    while(!counter->done())
+    {
+        if(!runOne(queue_index, counter))
+        {
+            std::this_thread::yield();
+        }
+    }
+    //the job that brought it to zero may still be draining continuations under the lock
+    std::lock_guard<std::mutex> lock(counter->mutex);
+}
+
+void JobSystem::runOnMainThread(std::function<void()>&& job)
+{
+    std::lock_guard<std::mutex> lock(main_mutex);
+    main_jobs.push_back(std::move(job));
+}
+
+void JobSystem::pumpMainThread()
+{
+    std::vector<std::function<void()>> jobs;
+    {
+        std::lock_guard<std::mutex> lock(main_mutex);
+        jobs.swap(main_jobs);
+    }
+    for(auto& job : jobs)
+    {
+        job();
+    }
+}
+
+void JobSystem::logStats() const
+{
+    std::cout << "job system: " << executed << " jobs, " << stolen << " stolen" << std::endl;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobCounter;
+
+struct Job
+{
+    std::function<void()> run;
+    //counter the job was submitted with, lets wait() pick out its own jobs
+    const JobCounter* counter;
+};
+
+//counts unfinished jobs, jobs submitted with it increment it and decrement it when done
+//jobs submitted after a counter start once it reaches zero
+class JobCounter
+{
+    friend class JobSystem;
+
+    std::atomic<uint32_t> pending = 0;
+    std::mutex mutex;
+    std::vector<Job> continuations;
+
+public:
+    bool done() const
+    {
+        return pending.load(std::memory_order_acquire) == 0;
+    }
+};
+
+//work stealing scheduler, one deque per worker
+//a worker pushes and pops the back of its own deque, idle workers steal from the front of others
+//so related work stays on one core while the oldest, usually largest, jobs are taken by thieves
+//other threads, the main thread included, hand their jobs to the workers round robin and only ever run
+//jobs of a counter they wait on, so background loads never land in a frame, without workers jobs run inline
+//SDL and anything else tied to the main thread goes through runOnMainThread
+class JobSystem
+{
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::thread::id main_thread;
+    std::atomic<uint32_t> queued = 0;
+    std::atomic<uint32_t> next_queue = 0;
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_cv;
+    bool stopping = false;
+
+    std::mutex main_mutex;
+    std::vector<std::function<void()>> main_jobs;
+
+    void push(Job&& job);
+    //only set, takes nothing but jobs of that counter from any queue
+    bool runOne(uint32_t queue_index, const JobCounter* only);
+    void workerLoop(uint32_t queue_index);
+    void finish(JobCounter* counter);
+
+public:
+    //jobs executed on each queue's thread and jobs taken from another queue
+    std::atomic<uint64_t> executed = 0;
+    std::atomic<uint64_t> stolen = 0;
+
+    //worker_count 0 uses every hardware thread but the main one
+    void start(uint32_t worker_count = 0);
+    //runs the remaining jobs and joins the workers
+    void shutdown();
+
+    uint32_t workerCount() const;
+    bool onMainThread() const;
+
+    void submit(std::function<void()>&& job, JobCounter* counter = nullptr);
+    //job starts after every job counted by dependency has finished
+    void submitAfter(JobCounter* dependency, std::function<void()>&& job, JobCounter* counter = nullptr);
+
+    //splits [begin, end) into chunks of at most grain and runs body(chunk_begin, chunk_end) on them
+    //returns once every chunk is done, the calling thread works on chunks too
+    void parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+    //runs jobs of counter until it reaches zero, jobs of other counters are left to the workers
+    //the counter may be destroyed once it returns
+    void wait(JobCounter* counter);
+
+    //queued jobs run the next time the main thread calls pumpMainThread
+    void runOnMainThread(std::function<void()>&& job);
+    //call from the main thread once per frame
+    void pumpMainThread();
+
+    void logStats() const;
+};
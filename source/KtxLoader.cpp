@@ -0,0 +1,154 @@
+#include "KtxLoader.h"
+
+#include <algorithm>
+
+bool KtxLoader::formatSampleable(Engine* engine, VkFormat format)
+{
+    VkFormatProperties format_properties;
+    vkGetPhysicalDeviceFormatProperties(engine->physical_device, format, &format_properties);
+    return (format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+void KtxLoader::setup(Engine* engine)
+{
+    this->engine = engine;
+    jobs = &engine->job_system;
+    const VkPhysicalDeviceFeatures& features = engine->supported_features;
+    if(features.textureCompressionBC && formatSampleable(engine, VK_FORMAT_BC7_UNORM_BLOCK) && formatSampleable(engine, VK_FORMAT_BC1_RGB_UNORM_BLOCK))
+    {
+        //etc1s carries little more than bc1 quality, so opaque etc1s gets the 4bpp format
+        targets = {
+            .etc1s_opaque = KTX_TTF_BC1_RGB,
+            .etc1s_alpha = KTX_TTF_BC7_RGBA,
+            .uastc = KTX_TTF_BC7_RGBA
+        };
+        std::cout << "basis transcode target: BC7/BC1" << std::endl;
+    }
+    else if(features.textureCompressionASTC_LDR && formatSampleable(engine, VK_FORMAT_ASTC_4x4_UNORM_BLOCK))
+    {
+        targets = {
+            .etc1s_opaque = KTX_TTF_ASTC_4x4_RGBA,
+            .etc1s_alpha = KTX_TTF_ASTC_4x4_RGBA,
+            .uastc = KTX_TTF_ASTC_4x4_RGBA
+        };
+        std::cout << "basis transcode target: ASTC 4x4" << std::endl;
+    }
+    else if(features.textureCompressionETC2 && formatSampleable(engine, VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK))
+    {
+        targets = {
+            .etc1s_opaque = KTX_TTF_ETC1_RGB,
+            .etc1s_alpha = KTX_TTF_ETC2_RGBA,
+            .uastc = KTX_TTF_ETC2_RGBA
+        };
+        std::cout << "basis transcode target: ETC2" << std::endl;
+    }
+    else
+    {
+        std::cout << "basis transcode target: RGBA8 fallback" << std::endl;
+    }
+}
+
+ktx_transcode_fmt_e KtxLoader::transcodeTarget(ktxTexture2* texture) const
+{
+    if(texture->supercompressionScheme == KTX_SS_BASIS_LZ)
+    {
+        uint32_t components = ktxTexture2_GetNumComponents(texture);
+        bool alpha = components == 2 || components == 4;
+        return alpha ? targets.etc1s_alpha : targets.etc1s_opaque;
+    }
+    return targets.uastc;
+}
+
+ktxTexture* KtxLoader::transcode(ktxTexture* ktx_texture, const std::string& name) const
+{
+    if(ktx_texture->classId == ktxTexture2_c)
+    {
+        ktxTexture2* ktx2_texture = reinterpret_cast<ktxTexture2*>(ktx_texture);
+        if(ktxTexture2_NeedsTranscoding(ktx2_texture))
+        {
+            KTX_error_code result = ktxTexture2_TranscodeBasis(ktx2_texture, transcodeTarget(ktx2_texture), 0);
+            if(result != KTX_SUCCESS)
+            {
+                std::cout << "could not transcode " << name << ": " << ktxErrorString(result) << std::endl;
+                ktxTexture_Destroy(ktx_texture);
+                return nullptr;
+            }
+        }
+    }
+    //files or bundles that already carry a block format, e.g. bc7 on a device without textureCompressionBC
+    VkFormat format = ktxTexture_GetVkFormat(ktx_texture);
+    if(format != VK_FORMAT_UNDEFINED && !formatSampleable(engine, format))
+    {
+        std::cout << name << " is in a format this device can not sample" << std::endl;
+        ktxTexture_Destroy(ktx_texture);
+        return nullptr;
+    }
+    return ktx_texture;
+}
+
+void KtxLoader::mountBundle(const AssetBundle* bundle)
+{
+    std::lock_guard<std::mutex> lock(bundle_mutex);
+    bundles.push_back(bundle);
+}
+
+ktxTexture* KtxLoader::load(const std::string& path) const
+{
+    size_t separator = path.rfind('#');
+    if(separator != std::string::npos)
+    {
+        const AssetBundle* bundle = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(bundle_mutex);
+            for(const AssetBundle* mounted : bundles)
+            {
+                if(path.compare(0, separator, mounted->path) == 0 && mounted->path.size() == separator)
+                {
+                    bundle = mounted;
+                }
+            }
+        }
+        const BundleEntry* entry = bundle ? bundle->find(path.substr(separator + 1)) : nullptr;
+        if(entry != nullptr && entry->type == BundleEntryType::Texture)
+        {
+            return loadMemory(bundle->entryData(*entry), entry->size, path);
+        }
+    }
+    ktxTexture* ktx_texture = nullptr;
+    KTX_error_code result = ktxTexture_CreateFromNamedFile(path.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktx_texture);
+    if(result != KTX_SUCCESS || ktx_texture == nullptr)
+    {
+        return nullptr;
+    }
+    return transcode(ktx_texture, path);
+}
+
+ktxTexture* KtxLoader::loadMemory(const std::vector<uint8_t>& data, const std::string& name) const
+{
+    return loadMemory(data.data(), data.size(), name);
+}
+
+ktxTexture* KtxLoader::loadMemory(const uint8_t* data, size_t size, const std::string& name) const
+{
+    ktxTexture* ktx_texture = nullptr;
+    KTX_error_code result = ktxTexture_CreateFromMemory(data, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktx_texture);
+    if(result != KTX_SUCCESS || ktx_texture == nullptr)
+    {
+        return nullptr;
+    }
+    return transcode(ktx_texture, name);
+}
+
+std::vector<ktxTexture*> KtxLoader::loadMany(const std::vector<const std::vector<uint8_t>*>& files, const std::vector<std::string>& names) const
+{
+    std::vector<ktxTexture*> textures(files.size(), nullptr);
+    //one file per job, transcode times vary too much for larger chunks
+    jobs->parallelFor(0, files.size(), 1, [&](size_t begin, size_t end)
+    {
+        for(size_t i = begin; i < end; i++)
+        {
+            textures[i] = loadMemory(*files[i], names[i]);
+        }
+    });
+    return textures;
+}
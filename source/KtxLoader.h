@@ -0,0 +1,57 @@
+#pragma once
+#include <volk/volk.h>
+
+#include <string>
+#include <vector>
+#include <mutex>
+
+#include <ktx.h>
+#include <ktxvulkan.h>
+
+#include "Engine.h"
+#include "AssetBundle.h"
+
+//opens ktx1 and ktx2 files, zstd supercompression is inflated by libktx on load
+//and basis universal payloads (etc1s/uastc) are transcoded to the best block format the device samples
+class KtxLoader
+{
+    struct TranscodeTargets
+    {
+        ktx_transcode_fmt_e etc1s_opaque;
+        ktx_transcode_fmt_e etc1s_alpha;
+        ktx_transcode_fmt_e uastc;
+    };
+
+    TranscodeTargets targets = {
+        .etc1s_opaque = KTX_TTF_RGBA32,
+        .etc1s_alpha = KTX_TTF_RGBA32,
+        .uastc = KTX_TTF_RGBA32
+    };
+
+    Engine* engine = nullptr;
+    JobSystem* jobs = nullptr;
+    //bundles whose textures load() resolves, looked up from streaming jobs
+    mutable std::mutex bundle_mutex;
+    std::vector<const AssetBundle*> bundles;
+
+    static bool formatSampleable(Engine* engine, VkFormat format);
+    ktx_transcode_fmt_e transcodeTarget(ktxTexture2* texture) const;
+    ktxTexture* transcode(ktxTexture* ktx_texture, const std::string& name) const;
+
+public:
+    //picks transcode targets from the device's compressed format support
+    void setup(Engine* engine);
+
+    //makes the bundle's textures loadable as "<bundle path>#<entry name>", the bundle must outlive the loader
+    void mountBundle(const AssetBundle* bundle);
+
+    //returns nullptr when the file can not be read or transcoded, or is in a format the device can not sample
+    ktxTexture* load(const std::string& path) const;
+
+    //same as load for file contents already in memory, name is only used for logging
+    ktxTexture* loadMemory(const std::vector<uint8_t>& data, const std::string& name) const;
+    ktxTexture* loadMemory(const uint8_t* data, size_t size, const std::string& name) const;
+
+    //loads and transcodes several in memory files as jobs on the engine's job system, failed entries are nullptr
+    std::vector<ktxTexture*> loadMany(const std::vector<const std::vector<uint8_t>*>& files, const std::vector<std::string>& names) const;
+};
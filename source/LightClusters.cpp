@@ -0,0 +1,115 @@
+#include "LightClusters.h"
+
+#include <cstring>
+
+void LightClusters::setup(Engine* engine, VkShaderModule shader_module)
+{
+    this->engine = engine;
+
+    ranges_offset = 16;
+    indices_offset = ranges_offset + (VkDeviceSize)cluster_count * 2 * sizeof(uint32_t);
+    VkDeviceSize size = indices_offset + (VkDeviceSize)index_capacity * sizeof(uint32_t);
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    //dedicated so the defragmenter never moves it, it is rewritten by the gpu every frame
+    grid = BufferAlloc::create(engine->allocator, engine->device, size, usage, VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT, MemoryCategory::Other);
+
+    VkPushConstantRange push_constant_range = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(ClusterPushConstants)
+    };
+    VkPipelineLayoutCreateInfo pipeline_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_constant_range
+    };
+    vkCreatePipelineLayout(engine->device, &pipeline_layout_create_info, nullptr, &pipeline_layout);
+
+    VkComputePipelineCreateInfo pipeline_create_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = shader_module,
+            .pName = "buildClusters"
+        },
+        .layout = pipeline_layout
+    };
+    vkCreateComputePipelines(engine->device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &pipeline);
+    Instrumentation::setObjectName(engine->device, VK_OBJECT_TYPE_PIPELINE, (uint64_t)pipeline, "light cluster build");
+    std::cout << "light clusters setup complete, " << cluster_count << " clusters, " << size / 1024 << " KiB grid" << std::endl;
+}
+
+LightList LightClusters::uploadLights(FrameAllocator& frame_allocator, const Scene* scene)
+{
+    LightList list = {
+        .address = 0,
+        .count = static_cast<uint32_t>(scene->lights.size())
+    };
+    if(list.count == 0)
+    {
+        return list;
+    }
+    //moved to view space here once instead of per cluster and per fragment on the gpu
+    FrameAllocation allocation = frame_allocator.allocate(list.count * sizeof(PointLight));
+    PointLight* lights = static_cast<PointLight*>(allocation.data);
+    for(uint32_t i = 0; i < list.count; i++)
+    {
+        PointLight light = scene->lights[i];
+        light.position = glm::vec3(scene->camera.view * glm::vec4(light.position, 1.0f));
+        memcpy(&lights[i], &light, sizeof(PointLight));
+    }
+    list.address = allocation.address;
+    return list;
+}
+
+VkDeviceAddress LightClusters::rangesAddress() const
+{
+    return grid.device_address + ranges_offset;
+}
+
+VkDeviceAddress LightClusters::indicesAddress() const
+{
+    return grid.device_address + indices_offset;
+}
+
+VkBuffer LightClusters::gridBuffer() const
+{
+    return grid.handle;
+}
+
+void LightClusters::record(VkCommandBuffer cmd, VkDeviceAddress scene_data)
+{
+    //the wait on the previous frame's readers and the one before shading come from the render graph
+    vkCmdFillBuffer(cmd, grid.handle, 0, sizeof(uint32_t), 0);
+
+    VkMemoryBarrier2 clear_barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_CLEAR_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT
+    };
+    VkDependencyInfo clear_dependency_info = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &clear_barrier
+    };
+    vkCmdPipelineBarrier2(cmd, &clear_dependency_info);
+
+    ClusterPushConstants pc = {
+        .scene = scene_data,
+        .counter = grid.device_address,
+        .index_capacity = index_capacity
+    };
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdPushConstants(cmd, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ClusterPushConstants), &pc);
+    vkCmdDispatch(cmd, (cluster_count + cluster_group_size - 1) / cluster_group_size, 1, 1);
+}
+
+void LightClusters::destroy()
+{
+    vkDestroyPipeline(engine->device, pipeline, nullptr);
+    vkDestroyPipelineLayout(engine->device, pipeline_layout, nullptr);
+    grid.destroy();
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <volk/volk.h>
+#include <vma/vk_mem_alloc.h>
+
+#include <iostream>
+
+#include "Engine.h"
+#include "BufferAlloc.h"
+#include "FrameAllocator.h"
+#include "Scene.h"
+
+//froxel grid, screen tiles by log depth slices
+constexpr uint32_t cluster_grid_x = 16;
+constexpr uint32_t cluster_grid_y = 9;
+constexpr uint32_t cluster_grid_z = 24;
+constexpr uint32_t cluster_count = cluster_grid_x * cluster_grid_y * cluster_grid_z;
+//threads per workgroup of buildClusters, also its shared light batch size
+constexpr uint32_t cluster_group_size = 64;
+
+//matches ClusterConstants in shader.slang
+struct ClusterPushConstants
+{
+    VkDeviceAddress scene;
+    VkDeviceAddress counter;
+    uint32_t index_capacity;
+    uint32_t pad;
+};
+
+//view space lights of the frame being recorded
+struct LightList
+{
+    VkDeviceAddress address;
+    uint32_t count;
+};
+
+//clustered forward lighting
+//lights are uploaded to frame memory each frame, a compute pass bins them into the froxel grid
+//and writes one compact index list per cluster that the fragment shader loops over
+class LightClusters
+{
+    Engine* engine = nullptr;
+    //[counter][ranges, one offset/count pair per cluster][indices]
+    BufferAlloc grid;
+    VkDeviceSize ranges_offset = 0;
+    VkDeviceSize indices_offset = 0;
+    VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
+public:
+    //total light indices over all clusters, clusters past it are clamped and lose lights
+    uint32_t index_capacity = cluster_count * 128;
+
+    //the build pass lives in the scene shader module
+    void setup(Engine* engine, VkShaderModule shader_module);
+
+    //copies the scene's lights into frame memory in view space
+    LightList uploadLights(FrameAllocator& frame_allocator, const Scene* scene);
+
+    VkDeviceAddress rangesAddress() const;
+    VkDeviceAddress indicesAddress() const;
+    //declared to the render graph, which places the barriers around record
+    VkBuffer gridBuffer() const;
+
+    //bins the lights referenced by scene_data, run as a graph pass that writes gridBuffer()
+    //with TransferWrite and ComputeStorageWrite
+    void record(VkCommandBuffer cmd, VkDeviceAddress scene_data);
+
+    void destroy();
+};
@@ -0,0 +1,175 @@
+#include "MemoryBudget.h"
+
+#include <iostream>
+#include <fstream>
+
+std::array<std::atomic<VkDeviceSize>, (size_t)MemoryCategory::Count> MemoryBudget::category_bytes{};
+std::array<std::atomic<uint32_t>, (size_t)MemoryCategory::Count> MemoryBudget::category_counts{};
+
+const char* memoryCategoryName(MemoryCategory category)
+{
+    switch(category)
+    {
+        case MemoryCategory::Geometry:    return "geometry";
+        case MemoryCategory::Textures:    return "textures";
+        case MemoryCategory::Attachments: return "attachments";
+        case MemoryCategory::PerFrame:    return "per_frame";
+        case MemoryCategory::Staging:     return "staging";
+        default:                          return "other";
+    }
+}
+
+void MemoryBudget::recordAllocation(MemoryCategory category, VkDeviceSize size)
+{
+    category_bytes[(size_t)category] += size;
+    category_counts[(size_t)category]++;
+}
+
+void MemoryBudget::recordFree(MemoryCategory category, VkDeviceSize size)
+{
+    category_bytes[(size_t)category] -= size;
+    category_counts[(size_t)category]--;
+}
+
+CategoryUsage MemoryBudget::categoryUsage(MemoryCategory category)
+{
+    return {
+        .bytes = category_bytes[(size_t)category].load(),
+        .allocation_count = category_counts[(size_t)category].load()
+    };
+}
+
+void MemoryBudget::setup(VmaAllocator allocator, bool budget_extension)
+{
+    this->allocator = allocator;
+    this->budget_extension = budget_extension;
+
+    const VkPhysicalDeviceMemoryProperties* memory_properties;
+    vmaGetMemoryProperties(allocator, &memory_properties);
+    heaps.resize(memory_properties->memoryHeapCount);
+    for(uint32_t i = 0; i < memory_properties->memoryHeapCount; i++)
+    {
+        heaps[i] = {
+            .heap_index = i,
+            .device_local = (memory_properties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0
+        };
+    }
+    update(0);
+    std::cout << "memory budget tracking setup, VK_EXT_memory_budget " << (budget_extension ? "enabled" : "not available") << std::endl;
+}
+
+void MemoryBudget::update(uint64_t frame_number)
+{
+    frame = frame_number;
+    vmaSetCurrentFrameIndex(allocator, static_cast<uint32_t>(frame_number));
+
+    std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets;
+    vmaGetHeapBudgets(allocator, budgets.data());
+    for(auto& heap : heaps)
+    {
+        const VmaBudget& b = budgets[heap.heap_index];
+        heap.usage = b.usage;
+        heap.budget = b.budget;
+        heap.block_bytes = b.statistics.blockBytes;
+        heap.allocation_bytes = b.statistics.allocationBytes;
+        heap.block_count = b.statistics.blockCount;
+        heap.allocation_count = b.statistics.allocationCount;
+    }
+
+    for(auto& cb : callbacks)
+    {
+        for(const auto& heap : heaps)
+        {
+            float ratio = usageRatio(heap.heap_index);
+            if(cb.armed[heap.heap_index] && ratio >= cb.threshold)
+            {
+                cb.armed[heap.heap_index] = false;
+                cb.callback(heap, cb.threshold);
+            }
+            //small hysteresis so a heap hovering at the threshold does not spam the callback
+            else if(!cb.armed[heap.heap_index] && ratio < cb.threshold - 0.05f)
+            {
+                cb.armed[heap.heap_index] = true;
+            }
+        }
+    }
+
+    if(dump_interval_frames != 0 && frame_number % dump_interval_frames == 0)
+    {
+        dumpJson();
+    }
+}
+
+void MemoryBudget::addThresholdCallback(float threshold, std::function<void(const HeapBudget& heap, float threshold)>&& callback)
+{
+    callbacks.push_back({
+        .threshold = threshold,
+        .callback = std::move(callback),
+        .armed = std::vector<bool>(heaps.size(), true)
+    });
+}
+
+uint32_t MemoryBudget::deviceLocalHeap() const
+{
+    uint32_t best = 0;
+    VkDeviceSize best_budget = 0;
+    for(const auto& heap : heaps)
+    {
+        if(heap.device_local && heap.budget > best_budget)
+        {
+            best = heap.heap_index;
+            best_budget = heap.budget;
+        }
+    }
+    return best;
+}
+
+bool MemoryBudget::hasHeadroom(uint32_t heap_index, VkDeviceSize size) const
+{
+    const HeapBudget& heap = heaps[heap_index];
+    return heap.usage + size <= heap.budget;
+}
+
+float MemoryBudget::usageRatio(uint32_t heap_index) const
+{
+    const HeapBudget& heap = heaps[heap_index];
+    return heap.budget == 0 ? 0.0f : (float)heap.usage / (float)heap.budget;
+}
+
+void MemoryBudget::writeJson(std::ostream& out) const
+{
+    out << "{\n  \"frame\": " << frame << ",\n  \"heaps\": [";
+    for(size_t i = 0; i < heaps.size(); i++)
+    {
+        const HeapBudget& heap = heaps[i];
+        out << (i == 0 ? "\n" : ",\n")
+            << "    { \"index\": " << heap.heap_index
+            << ", \"device_local\": " << (heap.device_local ? "true" : "false")
+            << ", \"usage\": " << heap.usage
+            << ", \"budget\": " << heap.budget
+            << ", \"block_bytes\": " << heap.block_bytes
+            << ", \"allocation_bytes\": " << heap.allocation_bytes
+            << ", \"block_count\": " << heap.block_count
+            << ", \"allocation_count\": " << heap.allocation_count << " }";
+    }
+    out << "\n  ],\n  \"categories\": {";
+    for(uint32_t i = 0; i < (uint32_t)MemoryCategory::Count; i++)
+    {
+        CategoryUsage usage = categoryUsage((MemoryCategory)i);
+        out << (i == 0 ? "\n" : ",\n")
+            << "    \"" << memoryCategoryName((MemoryCategory)i) << "\": { \"bytes\": " << usage.bytes
+            << ", \"allocation_count\": " << usage.allocation_count << " }";
+    }
+    out << "\n  }\n}\n";
+}
+
+void MemoryBudget::dumpJson() const
+{
+    std::ofstream file(dump_path, std::ios::trunc);
+    if(!file)
+    {
+        std::cout << "could not write memory budget dump to " << dump_path << std::endl;
+        return;
+    }
+    writeJson(file);
+}
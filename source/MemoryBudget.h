@@ -0,0 +1,89 @@
+#pragma once
+#include <volk/volk.h>
+#include <vma/vk_mem_alloc.h>
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//every BufferAlloc and ImageAlloc is tagged with one of these so usage can be traced back to a subsystem
+enum class MemoryCategory : uint32_t
+{
+    Geometry,
+    Textures,
+    Attachments,
+    PerFrame,
+    Staging,
+    Other,
+    Count
+};
+
+const char* memoryCategoryName(MemoryCategory category);
+
+struct HeapBudget
+{
+    uint32_t heap_index;
+    bool device_local;
+    VkDeviceSize usage;
+    VkDeviceSize budget;
+    VkDeviceSize block_bytes;
+    VkDeviceSize allocation_bytes;
+    uint32_t block_count;
+    uint32_t allocation_count;
+};
+
+struct CategoryUsage
+{
+    VkDeviceSize bytes;
+    uint32_t allocation_count;
+};
+
+class MemoryBudget
+{
+    struct ThresholdCallback
+    {
+        float threshold;
+        std::function<void(const HeapBudget& heap, float threshold)> callback;
+        std::vector<bool> armed;
+    };
+
+    static std::array<std::atomic<VkDeviceSize>, (size_t)MemoryCategory::Count> category_bytes;
+    static std::array<std::atomic<uint32_t>, (size_t)MemoryCategory::Count> category_counts;
+
+    std::vector<ThresholdCallback> callbacks;
+
+public:
+    VmaAllocator allocator = VK_NULL_HANDLE;
+    bool budget_extension = false;
+    std::vector<HeapBudget> heaps;
+    uint64_t frame = 0;
+
+    //0 disables the periodic json dump
+    uint32_t dump_interval_frames = 0;
+    std::string dump_path = "memory_budget.json";
+
+    //called by BufferAlloc/ImageAlloc on create and destroy
+    static void recordAllocation(MemoryCategory category, VkDeviceSize size);
+    static void recordFree(MemoryCategory category, VkDeviceSize size);
+    static CategoryUsage categoryUsage(MemoryCategory category);
+
+    void setup(VmaAllocator allocator, bool budget_extension);
+
+    //call once per frame, refreshes heap budgets, fires callbacks and dumps json
+    void update(uint64_t frame_number);
+
+    //callback fires once when a heap's usage/budget ratio crosses the threshold and rearms when it drops below
+    void addThresholdCallback(float threshold, std::function<void(const HeapBudget& heap, float threshold)>&& callback);
+
+    //index of the largest device local heap, used for budget checks of gpu resources
+    uint32_t deviceLocalHeap() const;
+    //true when size more bytes still fit into the heap budget
+    bool hasHeadroom(uint32_t heap_index, VkDeviceSize size) const;
+    float usageRatio(uint32_t heap_index) const;
+
+    void writeJson(std::ostream& out) const;
+    void dumpJson() const;
+};
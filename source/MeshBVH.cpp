@@ -0,0 +1,289 @@
+#include "MeshBVH.h"
+#include "Model.h"
+
+#include <algorithm>
+#include <array>
+
+void Aabb::grow(glm::vec3 point)
+{
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+void Aabb::grow(const Aabb& other)
+{
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+}
+
+bool Aabb::valid() const
+{
+    return min.x <= max.x && min.y <= max.y && min.z <= max.z;
+}
+
+float Aabb::halfArea() const
+{
+    if(!valid())
+    {
+        return 0.0f;
+    }
+    glm::vec3 size = max - min;
+    return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+bool Aabb::overlaps(const Aabb& other) const
+{
+    return min.x <= other.max.x && other.min.x <= max.x &&
+        min.y <= other.max.y && other.min.y <= max.y &&
+        min.z <= other.max.z && other.min.z <= max.z;
+}
+
+float Aabb::distanceSquared(glm::vec3 point) const
+{
+    glm::vec3 outside = glm::max(glm::max(min - point, point - max), glm::vec3(0.0f));
+    return glm::dot(outside, outside);
+}
+
+Aabb Aabb::transformed(const glm::mat4& transform) const
+{
+    //center and extent form, the extent goes through the absolute matrix
+    glm::vec3 center = glm::vec3(transform * glm::vec4((min + max) * 0.5f, 1.0f));
+    glm::vec3 half = (max - min) * 0.5f;
+    glm::mat3 linear = glm::mat3(transform);
+    glm::vec3 extent = glm::abs(linear[0]) * half.x + glm::abs(linear[1]) * half.y + glm::abs(linear[2]) * half.z;
+    return {center - extent, center + extent};
+}
+
+Ray::Ray(glm::vec3 origin, glm::vec3 direction) :
+    origin(origin),
+    direction(direction),
+    inv_direction(1.0f / direction)
+{
+}
+
+bool intersectAabb(const Ray& ray, const Aabb& box, float max_t, float& t_enter)
+{
+    glm::vec3 t0 = (box.min - ray.origin) * ray.inv_direction;
+    glm::vec3 t1 = (box.max - ray.origin) * ray.inv_direction;
+    glm::vec3 t_min = glm::min(t0, t1);
+    glm::vec3 t_max = glm::max(t0, t1);
+    float enter = std::max({t_min.x, t_min.y, t_min.z, 0.0f});
+    float exit = std::min({t_max.x, t_max.y, t_max.z, max_t});
+    t_enter = enter;
+    return enter <= exit;
+}
+
+static bool intersectTriangle(const Ray& ray, const glm::vec3* corners, float max_t, float& t)
+{
+    glm::vec3 edge1 = corners[1] - corners[0];
+    glm::vec3 edge2 = corners[2] - corners[0];
+    glm::vec3 p = glm::cross(ray.direction, edge2);
+    float determinant = glm::dot(edge1, p);
+    //both sides count, picking should not depend on winding
+    if(std::abs(determinant) < 1e-12f)
+    {
+        return false;
+    }
+    float inv_determinant = 1.0f / determinant;
+    glm::vec3 s = ray.origin - corners[0];
+    float u = glm::dot(s, p) * inv_determinant;
+    if(u < 0.0f || u > 1.0f)
+    {
+        return false;
+    }
+    glm::vec3 q = glm::cross(s, edge1);
+    float v = glm::dot(ray.direction, q) * inv_determinant;
+    if(v < 0.0f || u + v > 1.0f)
+    {
+        return false;
+    }
+    float hit = glm::dot(edge2, q) * inv_determinant;
+    if(hit < 0.0f || hit >= max_t)
+    {
+        return false;
+    }
+    t = hit;
+    return true;
+}
+
+void MeshBVH::build(const Vertex* vertices, const uint16_t* indices, uint32_t index_count)
+{
+    nodes.clear();
+    triangles.clear();
+    uint32_t triangle_count = index_count / 3;
+    if(triangle_count == 0)
+    {
+        return;
+    }
+    std::vector<Aabb> triangle_bounds(triangle_count);
+    std::vector<glm::vec3> centroids(triangle_count);
+    std::vector<uint32_t> order(triangle_count);
+    for(uint32_t i = 0; i < triangle_count; i++)
+    {
+        for(uint32_t corner = 0; corner < 3; corner++)
+        {
+            triangle_bounds[i].grow(vertices[indices[i * 3 + corner]].pos);
+        }
+        centroids[i] = (triangle_bounds[i].min + triangle_bounds[i].max) * 0.5f;
+        order[i] = i;
+    }
+
+    nodes.reserve(triangle_count * 2);
+    nodes.push_back({.first = 0, .count = triangle_count});
+    //node and depth, raycast walks with a fixed size stack
+    std::vector<std::pair<uint32_t, uint32_t>> stack = {{0, 0}};
+    while(!stack.empty())
+    {
+        auto [node_index, depth] = stack.back();
+        stack.pop_back();
+        uint32_t first = nodes[node_index].first;
+        uint32_t count = nodes[node_index].count;
+        Aabb bounds;
+        Aabb centroid_bounds;
+        for(uint32_t i = first; i < first + count; i++)
+        {
+            bounds.grow(triangle_bounds[order[i]]);
+            centroid_bounds.grow(centroids[order[i]]);
+        }
+        nodes[node_index].bounds = bounds;
+        if(count <= leaf_size || depth >= max_depth)
+        {
+            continue;
+        }
+
+        //cheapest plane between bins on any axis, cost is area times triangles on each side
+        float best_cost = std::numeric_limits<float>::max();
+        uint32_t best_axis = 0;
+        uint32_t best_plane = 0;
+        glm::vec3 extent = centroid_bounds.max - centroid_bounds.min;
+        for(uint32_t axis = 0; axis < 3; axis++)
+        {
+            if(extent[axis] <= 0.0f)
+            {
+                continue;
+            }
+            std::array<Aabb, bin_count> bins;
+            std::array<uint32_t, bin_count> bin_counts = {};
+            float scale = bin_count / extent[axis];
+            for(uint32_t i = first; i < first + count; i++)
+            {
+                uint32_t bin = std::min(bin_count - 1, static_cast<uint32_t>((centroids[order[i]][axis] - centroid_bounds.min[axis]) * scale));
+                bins[bin].grow(triangle_bounds[order[i]]);
+                bin_counts[bin]++;
+            }
+            std::array<float, bin_count - 1> left_costs;
+            Aabb left;
+            uint32_t left_count = 0;
+            for(uint32_t plane = 0; plane < bin_count - 1; plane++)
+            {
+                left.grow(bins[plane]);
+                left_count += bin_counts[plane];
+                left_costs[plane] = left.halfArea() * left_count;
+            }
+            Aabb right;
+            uint32_t right_count = 0;
+            for(uint32_t plane = bin_count - 1; plane > 0; plane--)
+            {
+                right.grow(bins[plane]);
+                right_count += bin_counts[plane];
+                float cost = left_costs[plane - 1] + right.halfArea() * right_count;
+                if(right_count > 0 && right_count < count && cost < best_cost)
+                {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_plane = plane;
+                }
+            }
+        }
+        //splitting has to beat testing every triangle, small nodes that do not stay leaves
+        bool worth_splitting = best_cost < bounds.halfArea() * count || count > leaf_size * 4;
+        if(best_cost == std::numeric_limits<float>::max() || !worth_splitting)
+        {
+            continue;
+        }
+
+        float scale = bin_count / extent[best_axis];
+        auto middle = std::partition(order.begin() + first, order.begin() + first + count, [&](uint32_t triangle)
+        {
+            uint32_t bin = std::min(bin_count - 1, static_cast<uint32_t>((centroids[triangle][best_axis] - centroid_bounds.min[best_axis]) * scale));
+            return bin < best_plane;
+        });
+        uint32_t left_count = static_cast<uint32_t>(middle - (order.begin() + first));
+        if(left_count == 0 || left_count == count)
+        {
+            continue;
+        }
+        uint32_t left_child = static_cast<uint32_t>(nodes.size());
+        nodes.push_back({.first = first, .count = left_count});
+        nodes.push_back({.first = first + left_count, .count = count - left_count});
+        nodes[node_index].first = left_child;
+        nodes[node_index].count = 0;
+        stack.push_back({left_child, depth + 1});
+        stack.push_back({left_child + 1, depth + 1});
+    }
+
+    triangles.resize(triangle_count * 3);
+    for(uint32_t i = 0; i < triangle_count; i++)
+    {
+        for(uint32_t corner = 0; corner < 3; corner++)
+        {
+            triangles[i * 3 + corner] = vertices[indices[order[i] * 3 + corner]].pos;
+        }
+    }
+    nodes.shrink_to_fit();
+}
+
+bool MeshBVH::empty() const
+{
+    return nodes.empty();
+}
+
+const Aabb& MeshBVH::bounds() const
+{
+    return nodes[0].bounds;
+}
+
+bool MeshBVH::raycast(const Ray& ray, float& t) const
+{
+    float t_enter;
+    if(nodes.empty() || !intersectAabb(ray, nodes[0].bounds, t, t_enter))
+    {
+        return false;
+    }
+    bool hit = false;
+    std::array<uint32_t, max_depth + 2> stack;
+    uint32_t stack_size = 0;
+    stack[stack_size++] = 0;
+    while(stack_size > 0)
+    {
+        const Node& node = nodes[stack[--stack_size]];
+        if(node.count > 0)
+        {
+            for(uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                hit = intersectTriangle(ray, &triangles[i * 3], t, t) || hit;
+            }
+            continue;
+        }
+        //nearer child on top so its hits prune the farther one
+        float t_left, t_right;
+        bool left = intersectAabb(ray, nodes[node.first].bounds, t, t_left);
+        bool right = intersectAabb(ray, nodes[node.first + 1].bounds, t, t_right);
+        if(left && right)
+        {
+            bool left_first = t_left <= t_right;
+            stack[stack_size++] = left_first ? node.first + 1 : node.first;
+            stack[stack_size++] = left_first ? node.first : node.first + 1;
+        }
+        else if(left || right)
+        {
+            stack[stack_size++] = left ? node.first : node.first + 1;
+        }
+    }
+    return hit;
+}
+
+size_t MeshBVH::memoryBytes() const
+{
+    return nodes.size() * sizeof(Node) + triangles.size() * sizeof(glm::vec3);
+}
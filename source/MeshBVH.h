@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+struct Vertex;
+
+struct Aabb
+{
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+    void grow(glm::vec3 point);
+    void grow(const Aabb& other);
+    bool valid() const;
+    //half the surface area, all the surface area heuristic needs
+    float halfArea() const;
+    bool overlaps(const Aabb& other) const;
+    float distanceSquared(glm::vec3 point) const;
+    //box of the eight transformed corners
+    Aabb transformed(const glm::mat4& transform) const;
+};
+
+struct Ray
+{
+    glm::vec3 origin;
+    glm::vec3 direction;
+    //per axis 1 / direction, infinite on axes the ray is parallel to
+    glm::vec3 inv_direction;
+
+    Ray(glm::vec3 origin, glm::vec3 direction);
+};
+
+//distance along the ray to where it enters the box, false when it misses or enters past max_t
+bool intersectAabb(const Ray& ray, const Aabb& box, float max_t, float& t_enter);
+
+//triangle hierarchy in model space for exact hit tests, built once per mesh
+//binned surface area heuristic, leaves hold up to leaf_size triangles stored by value in leaf order
+//so a query touches only the BVH and never the vertex data, which may live on the gpu alone
+class MeshBVH
+{
+    struct Node
+    {
+        Aabb bounds;
+        //inner nodes: index of the left child, the right one follows it, leaves: first triangle
+        uint32_t first;
+        //triangles in a leaf, 0 for inner nodes
+        uint32_t count;
+    };
+
+    std::vector<Node> nodes;
+    //three corners per triangle
+    std::vector<glm::vec3> triangles;
+
+public:
+    static constexpr uint32_t leaf_size = 4;
+    static constexpr uint32_t bin_count = 12;
+    //deeper nodes stay leaves whatever their size, bounds the traversal stack
+    static constexpr uint32_t max_depth = 48;
+
+    void build(const Vertex* vertices, const uint16_t* indices, uint32_t index_count);
+    bool empty() const;
+    const Aabb& bounds() const;
+
+    //closest triangle hit nearer than t, which is lowered to it
+    bool raycast(const Ray& ray, float& t) const;
+
+    size_t memoryBytes() const;
+};
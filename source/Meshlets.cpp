@@ -0,0 +1,127 @@
+#include "Meshlets.h"
+#include "Model.h"
+
+#include <algorithm>
+#include <cmath>
+
+//cones narrower than this test are not worth the work, the test would pass almost never
+constexpr float min_cone_spread = 0.1f;
+
+static void finishMeshlet(const Vertex* mesh_vertices, MeshletData& data, Meshlet& meshlet)
+{
+    Aabb box;
+    for(uint32_t i = 0; i < meshlet.vertex_count; i++)
+    {
+        box.grow(mesh_vertices[data.vertices[meshlet.vertex_offset + i]].pos);
+    }
+    meshlet.center = (box.min + box.max) * 0.5f;
+    meshlet.radius = 0.0f;
+    for(uint32_t i = 0; i < meshlet.vertex_count; i++)
+    {
+        meshlet.radius = std::max(meshlet.radius, glm::length(mesh_vertices[data.vertices[meshlet.vertex_offset + i]].pos - meshlet.center));
+    }
+
+    //geometric normals, flipped to the side the vertex normals point to since the pipeline culls no winding
+    glm::vec3 normals[meshlet_max_triangles];
+    uint32_t normal_count = 0;
+    glm::vec3 axis = glm::vec3(0.0f);
+    for(uint32_t i = 0; i < meshlet.triangle_count; i++)
+    {
+        uint32_t packed = data.triangles[meshlet.triangle_offset + i];
+        const Vertex& a = mesh_vertices[data.vertices[meshlet.vertex_offset + (packed & 0xff)]];
+        const Vertex& b = mesh_vertices[data.vertices[meshlet.vertex_offset + ((packed >> 8) & 0xff)]];
+        const Vertex& c = mesh_vertices[data.vertices[meshlet.vertex_offset + ((packed >> 16) & 0xff)]];
+        glm::vec3 normal = glm::cross(b.pos - a.pos, c.pos - a.pos);
+        float length = glm::length(normal);
+        if(length <= 0.0f)
+        {
+            continue;
+        }
+        normal /= length;
+        if(glm::dot(normal, a.normal + b.normal + c.normal) < 0.0f)
+        {
+            normal = -normal;
+        }
+        normals[normal_count++] = normal;
+        axis += normal;
+    }
+    meshlet.cone_axis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.cone_cutoff = 1.0f;
+    float axis_length = glm::length(axis);
+    if(normal_count == 0 || axis_length <= 0.0f)
+    {
+        return;
+    }
+    axis /= axis_length;
+    float min_dot = 1.0f;
+    for(uint32_t i = 0; i < normal_count; i++)
+    {
+        min_dot = std::min(min_dot, glm::dot(axis, normals[i]));
+    }
+    meshlet.cone_axis = axis;
+    if(min_dot > min_cone_spread)
+    {
+        meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+    }
+}
+
+void MeshletData::build(const Vertex* mesh_vertices, uint32_t vertex_count, const uint16_t* indices, uint32_t index_count)
+{
+    meshlets.clear();
+    vertices.clear();
+    triangles.clear();
+    //local index of each mesh vertex in the meshlet being filled, 0xff when it is not part of it
+    std::vector<uint8_t> local(vertex_count, 0xff);
+    Meshlet meshlet = {};
+    auto flush = [&]()
+    {
+        if(meshlet.triangle_count == 0)
+        {
+            return;
+        }
+        for(uint32_t i = 0; i < meshlet.vertex_count; i++)
+        {
+            local[vertices[meshlet.vertex_offset + i]] = 0xff;
+        }
+        finishMeshlet(mesh_vertices, *this, meshlet);
+        meshlets.push_back(meshlet);
+        meshlet = {
+            .vertex_offset = static_cast<uint32_t>(vertices.size()),
+            .triangle_offset = static_cast<uint32_t>(triangles.size())
+        };
+    };
+
+    for(uint32_t i = 0; i + 2 < index_count; i += 3)
+    {
+        uint32_t corners[3] = {indices[i], indices[i + 1], indices[i + 2]};
+        uint32_t added = (local[corners[0]] == 0xff) + (local[corners[1]] == 0xff && corners[1] != corners[0]) +
+            (local[corners[2]] == 0xff && corners[2] != corners[0] && corners[2] != corners[1]);
+        if(meshlet.vertex_count + added > meshlet_max_vertices || meshlet.triangle_count == meshlet_max_triangles)
+        {
+            flush();
+        }
+        uint32_t packed = 0;
+        for(uint32_t c = 0; c < 3; c++)
+        {
+            if(local[corners[c]] == 0xff)
+            {
+                local[corners[c]] = static_cast<uint8_t>(meshlet.vertex_count++);
+                vertices.push_back(corners[c]);
+            }
+            packed |= static_cast<uint32_t>(local[corners[c]]) << (c * 8);
+        }
+        triangles.push_back(packed);
+        meshlet.triangle_count++;
+    }
+    flush();
+}
+
+bool MeshletData::empty() const
+{
+    return meshlets.empty();
+}
+
+size_t MeshletData::sizeBytes() const
+{
+    return meshlets.size() * sizeof(Meshlet) + vertices.size() * sizeof(uint32_t) + triangles.size() * sizeof(uint32_t);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+struct Vertex;
+
+constexpr uint32_t meshlet_max_vertices = 64;
+constexpr uint32_t meshlet_max_triangles = 124;
+
+//matches Meshlet in meshlet.slang, bounds are in model space
+struct Meshlet
+{
+    glm::vec3 center;
+    float radius;
+    //average facing of the triangles, all of them face away from a viewer that looks at the sphere along a direction
+    //within asin(cone_cutoff) of cone_axis, 1 when the normals spread too far for the cone to cull anything
+    glm::vec3 cone_axis;
+    float cone_cutoff;
+    //first entries of MeshletData::vertices and triangles
+    uint32_t vertex_offset;
+    uint32_t triangle_offset;
+    uint32_t vertex_count;
+    uint32_t triangle_count;
+};
+
+//a mesh split into clusters small enough for one mesh shader workgroup each, built once per mesh
+//triangles are taken in index order, so meshes whose triangle order is spatially coherent get tight clusters
+struct MeshletData
+{
+    std::vector<Meshlet> meshlets;
+    //mesh vertex index of each meshlet vertex
+    std::vector<uint32_t> vertices;
+    //meshlet local vertex indices of each triangle, 8 bits each in the low three bytes
+    std::vector<uint32_t> triangles;
+
+    void build(const Vertex* mesh_vertices, uint32_t vertex_count, const uint16_t* indices, uint32_t index_count);
+    bool empty() const;
+    size_t sizeBytes() const;
+};
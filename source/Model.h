@@ -9,6 +9,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include "Texture.h"
+#include "MeshBVH.h"
+#include <limits>
 
 struct Vertex
 {
@@ -24,16 +26,29 @@ public:
     std::vector<tinyobj::material_t> materials;
     std::vector<Vertex> vertices;
     std::vector<uint16_t> indices;
-    BufferAlloc model_buffer;
-    VkDeviceSize v_buf_size;
-    VkDeviceSize i_buf_size;
-    Texture* texture;
+    //id in RendererLoader::geometry_heap
+    uint32_t mesh = UINT32_MAX;
+    Texture* texture = nullptr;
+    glm::vec3 bounds_min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 bounds_max = glm::vec3(std::numeric_limits<float>::lowest());
+    glm::vec3 bounds_center;
+    float bounds_radius = 0.0f;
+    //exact hit tests for picking, empty while the model is a placeholder
+    MeshBVH bvh;
+
+    //filled by RendererLoader::loadModel from a cooked bundle
+    Model() = default;
 
     Model(std::string path)
     {
         std::cout << "loading model" << std::endl;
         std::ifstream filename(path);
         tinyobj::LoadObj(&attrib, &shapes, &materials, nullptr, nullptr, &filename);
+        if(shapes.empty())
+        {
+            std::cout << "could not load model " << path << std::endl;
+            return;
+        }
         for(auto& index : shapes[0].mesh.indices)
         {
             Vertex v = {
@@ -54,6 +69,13 @@ public:
             };
             vertices.push_back(v);
             indices.push_back(indices.size());
+            bounds_min = glm::min(bounds_min, v.pos);
+            bounds_max = glm::max(bounds_max, v.pos);
+        }
+        bounds_center = (bounds_min + bounds_max) * 0.5f;
+        for(const auto& v : vertices)
+        {
+            bounds_radius = std::max(bounds_radius, glm::length(v.pos - bounds_center));
         }
         std::cout << "loading model complete" << std::endl;
     }
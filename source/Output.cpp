@@ -1,44 +1,93 @@
 #include "Output.h"
 
+#include <algorithm>
+
 void Output::getImageFormat(Engine* engine)
 {
     uint32_t format_count;
     vkGetPhysicalDeviceSurfaceFormatsKHR(engine->physical_device, engine->surface, &format_count, nullptr);
     std::vector<VkSurfaceFormatKHR> formats(format_count);
     vkGetPhysicalDeviceSurfaceFormatsKHR(engine->physical_device, engine->surface, &format_count, formats.data());
+    //the scene color target shares the format and is blitted into the swapchain image
+    auto features = [&](VkFormat format)
+    {
+        VkFormatProperties2 format_properties = {
+            .sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_2
+        };
+        vkGetPhysicalDeviceFormatProperties2(engine->physical_device, format, &format_properties);
+        return format_properties.formatProperties.optimalTilingFeatures;
+    };
+    constexpr VkFormatFeatureFlags blit_features = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
     VkSurfaceFormatKHR surface_format = formats.data()[0];
+    bool blit_supported = false;
     for(VkSurfaceFormatKHR available_format : formats)
     {
-        if(available_format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR && 
-            available_format.format == VK_FORMAT_B8G8R8A8_SRGB)
+        if((features(available_format.format) & blit_features) != blit_features)
+        {
+            continue;
+        }
+        if(!blit_supported || (available_format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR &&
+            available_format.format == VK_FORMAT_B8G8R8A8_SRGB))
         {
             surface_format = available_format;
-            break;  
+            blit_supported = true;
         }
     }
+    if(!blit_supported)
+    {
+        std::cout << "no surface format supports blitting, the upscale blit is invalid on this device" << std::endl;
+    }
     image_format = surface_format.format;
     std::cout << "got image color format" << std::endl;
     image_color_space = surface_format.colorSpace;
     std::cout << "got image color space" << std::endl;
+    //linear filtering is optional for blits, nearest is always allowed
+    blit_filter = (features(image_format) & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
 }
 
-void Output::createSwapchain(Engine* engine)
+bool Output::updateExtent(Engine* engine)
 {
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(engine->physical_device, engine->surface, &engine->surface_caps);
+    VkExtent2D extent = engine->surface_caps.currentExtent;
+    if(extent.width == UINT32_MAX)
+    {
+        //the surface size is defined by the swapchain, follow the window
+        int width, height;
+        SDL_GetWindowSizeInPixels(engine->window, &width, &height);
+        extent = {
+            .width = std::clamp(static_cast<uint32_t>(width), engine->surface_caps.minImageExtent.width, engine->surface_caps.maxImageExtent.width),
+            .height = std::clamp(static_cast<uint32_t>(height), engine->surface_caps.minImageExtent.height, engine->surface_caps.maxImageExtent.height)
+        };
+    }
+    window_width = static_cast<int>(extent.width);
+    window_height = static_cast<int>(extent.height);
+    return extent.width != 0 && extent.height != 0;
+}
+
+void Output::createSwapchain(Engine* engine, VkSwapchainKHR old_swapchain)
+{
+    uint32_t min_image_count = engine->surface_caps.minImageCount + 1;
+    if(engine->surface_caps.maxImageCount != 0)
+    {
+        min_image_count = std::min(min_image_count, engine->surface_caps.maxImageCount);
+    }
     VkSwapchainCreateInfoKHR swapchain_create_info = {
         .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
         .surface = engine->surface,
-        .minImageCount = engine->surface_caps.minImageCount,
+        .minImageCount = min_image_count,
         .imageFormat = image_format,
         .imageColorSpace = image_color_space,
         .imageExtent = {
-            .width = engine->surface_caps.currentExtent.width,
-            .height = engine->surface_caps.currentExtent.height
+            .width = static_cast<uint32_t>(window_width),
+            .height = static_cast<uint32_t>(window_height)
         },
         .imageArrayLayers = 1,
-        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        //filled by blitting the internal color target
+        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
         .preTransform = engine->surface_caps.currentTransform,
         .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
-        .presentMode = VK_PRESENT_MODE_FIFO_KHR
+        .presentMode = VK_PRESENT_MODE_FIFO_KHR,
+        .oldSwapchain = old_swapchain
     };
     vkCreateSwapchainKHR(engine->device, &swapchain_create_info, nullptr, &swapchain);
     std::cout << "swapchain created" << std::endl;
@@ -70,18 +119,19 @@ void Output::createImageAndImageView(Engine* engine)
         vkCreateImageView(engine->device, &image_view_create_info, nullptr, &swapchain_image_views[i]);
     }
 
-    engine->main_deletion_queue.push([this, engine = engine]() mutable
+    VkSemaphoreCreateInfo semaphore_create_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
+    };
+    render_semaphores.resize(image_count);
+    for(auto& semaphore : render_semaphores)
     {
-        for (auto& view : swapchain_image_views)
-        {
-            vkDestroyImageView(engine->device, view, nullptr);
-        }
-        vkDestroySwapchainKHR(engine->device, swapchain, nullptr);
-    });
+        vkCreateSemaphore(engine->device, &semaphore_create_info, nullptr, &semaphore);
+    }
+
     std::cout << "created image views" << std::endl;
 }
 
-void Output::createDepthImageAndImageView(Engine* engine)
+void Output::getDepthFormat(Engine* engine)
 {
     std::vector<VkFormat> depth_format_list = {
         VK_FORMAT_D32_SFLOAT_S8_UINT,
@@ -99,30 +149,57 @@ void Output::createDepthImageAndImageView(Engine* engine)
             break;
         }
     }
-    VkImageCreateInfo depth_image_create_info = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-        .imageType = VK_IMAGE_TYPE_2D,
-        .format = depth_format,
-        .extent = {
-            .width = static_cast<uint32_t>(window_width),
-            .height = static_cast<uint32_t>(window_height),
-            .depth = 1
-        },
-        .mipLevels = 1,
-        .arrayLayers = 1,
-        .samples = VK_SAMPLE_COUNT_1_BIT,
-        .tiling = VK_IMAGE_TILING_OPTIMAL,
-        .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+    std::cout << "got depth format" << std::endl;
+}
+
+void Output::growAttachmentExtent()
+{
+    attachment_extent = {
+        .width = std::max(attachment_extent.width, static_cast<uint32_t>(window_width)),
+        .height = std::max(attachment_extent.height, static_cast<uint32_t>(window_height))
     };
-    VmaAllocationCreateFlags depth_vma_flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
-    VkImageAspectFlags depth_aspect_mask = VK_IMAGE_ASPECT_DEPTH_BIT;
-    depth_attachment = ImageAlloc::create(engine->allocator, engine->device, depth_image_create_info, depth_vma_flags, depth_aspect_mask);
-    
-    engine->main_deletion_queue.push([=]() mutable
+}
+
+bool Output::recreateSwapchain(Engine* engine)
+{
+    if(!updateExtent(engine))
+    {
+        return false;
+    }
+    for(auto& view : swapchain_image_views)
+    {
+        engine->retirement_queue.retireImageView(view);
+    }
+    for(auto& semaphore : render_semaphores)
     {
-        depth_attachment.destroy();
-    });
+        engine->retirement_queue.retireSemaphore(semaphore);
+    }
+
+    VkSwapchainKHR old_swapchain = swapchain;
+    getImageFormat(engine);
+    createSwapchain(engine, old_swapchain);
+    engine->retirement_queue.retireSwapchain(old_swapchain);
+    createImageAndImageView(engine);
+
+    growAttachmentExtent();
+    return true;
+}
 
-    std::cout << "depth image and image view created" << std::endl;
+void Output::destroy(Engine* engine)
+{
+    for(auto& view : swapchain_image_views)
+    {
+        vkDestroyImageView(engine->device, view, nullptr);
+    }
+    swapchain_image_views.clear();
+    for(auto& semaphore : render_semaphores)
+    {
+        vkDestroySemaphore(engine->device, semaphore, nullptr);
+    }
+    render_semaphores.clear();
+    if(swapchain != VK_NULL_HANDLE)
+    {
+        vkDestroySwapchainKHR(engine->device, swapchain, nullptr);
+        swapchain = VK_NULL_HANDLE;
+    }
 }
\ No newline at end of file
@@ -2,18 +2,23 @@
 
 #include <volk/volk.h>
 #include "Engine.h"
-#include "ImageAlloc.h"
 
 class Output
 {
 public:
     VkFormat image_format;
     VkColorSpaceKHR image_color_space;
-    VkSwapchainKHR swapchain;
+    //filter of the upscale blit, linear when the format supports it
+    VkFilter blit_filter = VK_FILTER_NEAREST;
+    VkSwapchainKHR swapchain = VK_NULL_HANDLE;
     uint32_t image_count;
     std::vector<VkImage> swapchain_images;
     std::vector<VkImageView> swapchain_image_views;
-    ImageAlloc depth_attachment;
+    //signalled by rendering into an image and waited by its present, one per swapchain image
+    std::vector<VkSemaphore> render_semaphores;
+    //size of the render graph's scene color and depth, can be larger than the window after shrinking
+    //the scene is rendered into them at a dynamic scale and blitted to the swapchain image
+    VkExtent2D attachment_extent = {};
     VkFormat depth_format;
     int window_width;
     int window_height;
@@ -21,14 +26,28 @@ public:
     Output(Engine* engine)
     {
         getImageFormat(engine);
-        createSwapchain(engine);
+        updateExtent(engine);
+        createSwapchain(engine, VK_NULL_HANDLE);
         createImageAndImageView(engine);
-        SDL_GetWindowSize(engine->window, &window_width, &window_height);
-        createDepthImageAndImageView(engine);
+        getDepthFormat(engine);
+        growAttachmentExtent();
+        engine->main_deletion_queue.push([=]()
+        {
+            destroy(engine);
+        });
     }
 
     void getImageFormat(Engine* engine);
-    void createSwapchain(Engine* engine);
+    //reads the surface size into window_width/height, false when the window has no area (minimized)
+    bool updateExtent(Engine* engine);
+    void createSwapchain(Engine* engine, VkSwapchainKHR old_swapchain);
     void createImageAndImageView(Engine* engine);
-    void createDepthImageAndImageView(Engine* engine);
+    void getDepthFormat(Engine* engine);
+    //grow only, so shrinking and growing back during a window drag keeps the graph's transients
+    void growAttachmentExtent();
+    //recreates the swapchain for the current surface size without waiting for the device
+    //frames in flight keep presenting to the old swapchain, its views and semaphores go to the retirement queue
+    //the attachments only grow when the new size does not fit, returns false while minimized
+    bool recreateSwapchain(Engine* engine);
+    void destroy(Engine* engine);
 };
\ No newline at end of file
@@ -2,36 +2,88 @@
 
 Pipeline::Pipeline(Engine* engine, RendererLoader* loader, Output* output)
 {
+    push_constant_stages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    if(loader->meshlet_shader_module != VK_NULL_HANDLE)
+    {
+        push_constant_stages |= VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+    }
     VkPushConstantRange push_constant_range = {
-        .stageFlags =  VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+        .stageFlags = push_constant_stages,
         .offset = 0,
         .size = sizeof(PushConstants)
     };
     VkPipelineLayoutCreateInfo pipeline_layout_create_info = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
         .setLayoutCount = 1,
-        .pSetLayouts = &loader->descriptor_set_layout_textures,
+        .pSetLayouts = &loader->bindless_textures.descriptor_set_layout,
         .pushConstantRangeCount = 1,
         .pPushConstantRanges = &push_constant_range
     };
     vkCreatePipelineLayout(engine->device, &pipeline_layout_create_info, nullptr, &pipeline_layout);
-    std::vector<VkPipelineShaderStageCreateInfo> shader_stages{
-        {
+
+    pipeline = createPipeline(engine, loader, output, false, VK_COMPARE_OP_LESS_OR_EQUAL, true, false, "scene");
+    depth_equal_pipeline = createPipeline(engine, loader, output, false, VK_COMPARE_OP_EQUAL, false, false, "scene depth equal");
+    depth_prepass_pipeline = createPipeline(engine, loader, output, true, VK_COMPARE_OP_LESS_OR_EQUAL, true, false, "depth prepass");
+    if(loader->meshlet_shader_module != VK_NULL_HANDLE)
+    {
+        mesh_pipeline = createPipeline(engine, loader, output, false, VK_COMPARE_OP_LESS_OR_EQUAL, true, true, "meshlet scene");
+        mesh_depth_equal_pipeline = createPipeline(engine, loader, output, false, VK_COMPARE_OP_EQUAL, false, true, "meshlet scene depth equal");
+        mesh_depth_prepass_pipeline = createPipeline(engine, loader, output, true, VK_COMPARE_OP_LESS_OR_EQUAL, true, true, "meshlet depth prepass");
+    }
+
+    engine->main_deletion_queue.push([=]()
+    {
+        vkDestroyPipelineLayout(engine->device, pipeline_layout, nullptr);
+        vkDestroyPipeline(engine->device, pipeline, nullptr);
+        vkDestroyPipeline(engine->device, depth_equal_pipeline, nullptr);
+        vkDestroyPipeline(engine->device, depth_prepass_pipeline, nullptr);
+        vkDestroyPipeline(engine->device, mesh_pipeline, nullptr);
+        vkDestroyPipeline(engine->device, mesh_depth_equal_pipeline, nullptr);
+        vkDestroyPipeline(engine->device, mesh_depth_prepass_pipeline, nullptr);
+    });
+}
+
+VkPipeline Pipeline::createPipeline(Engine* engine, RendererLoader* loader, Output* output, bool depth_only, VkCompareOp depth_compare, bool depth_write, bool mesh_shading, const char* name)
+{
+    VkShaderModule module = mesh_shading ? loader->meshlet_shader_module : loader->shader_module;
+    std::vector<VkPipelineShaderStageCreateInfo> shader_stages;
+    if(mesh_shading)
+    {
+        shader_stages.push_back({
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_TASK_BIT_EXT,
+            .module = module,
+            .pName = "taskMain"
+        });
+        shader_stages.push_back({
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_MESH_BIT_EXT,
+            .module = module,
+            .pName = depth_only ? "depthMeshMain" : "meshMain"
+        });
+    }
+    else
+    {
+        shader_stages.push_back({
             .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
             .stage = VK_SHADER_STAGE_VERTEX_BIT,
-            .module = loader->shader_module,
-            .pName = "vertexMain"
-        },
-        {
+            .module = module,
+            .pName = depth_only ? "depthVertexMain" : "vertexMain"
+        });
+    }
+    if(!depth_only)
+    {
+        shader_stages.push_back({
             .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
             .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-            .module = loader->shader_module,
+            .module = module,
             .pName = "fragmentMain"
-        }
-    };
+        });
+    }
+    //the depth only variant reads the geometry heap's position stream
     VkVertexInputBindingDescription vertex_binding = {
         .binding = 0,
-        .stride = sizeof(Vertex),
+        .stride = depth_only ? static_cast<uint32_t>(sizeof(glm::vec3)) : static_cast<uint32_t>(sizeof(Vertex)),
         .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
     };
     std::vector<VkVertexInputAttributeDescription> vertex_attributes = {
@@ -57,7 +109,7 @@ Pipeline::Pipeline(Engine* engine, RendererLoader* loader, Output* output)
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
         .vertexBindingDescriptionCount = 1,
         .pVertexBindingDescriptions = &vertex_binding,
-        .vertexAttributeDescriptionCount = static_cast<uint32_t>(vertex_attributes.size()),
+        .vertexAttributeDescriptionCount = depth_only ? 1 : static_cast<uint32_t>(vertex_attributes.size()),
         .pVertexAttributeDescriptions = vertex_attributes.data()
     };
     VkPipelineInputAssemblyStateCreateInfo input_assembly_state = {
@@ -89,29 +141,30 @@ Pipeline::Pipeline(Engine* engine, RendererLoader* loader, Output* output)
     VkPipelineDepthStencilStateCreateInfo depth_stencil_state = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
         .depthTestEnable = VK_TRUE,
-        .depthWriteEnable = VK_TRUE,
-        .depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL
+        .depthWriteEnable = depth_write,
+        .depthCompareOp = depth_compare
     };
     VkPipelineColorBlendAttachmentState blend_attachment = { 
         .colorWriteMask = 0xF
     };
     VkPipelineColorBlendStateCreateInfo color_blend_state = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-        .attachmentCount = 1,
+        .attachmentCount = depth_only ? 0u : 1u,
         .pAttachments = &blend_attachment
     };
     VkPipelineRenderingCreateInfo rendering_create_info = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
-        .colorAttachmentCount = 1, .pColorAttachmentFormats = &output->image_format,
+        .colorAttachmentCount = depth_only ? 0u : 1u, .pColorAttachmentFormats = &output->image_format,
         .depthAttachmentFormat = output->depth_format
     };
     VkGraphicsPipelineCreateInfo pipeline_create_info = {
         .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
         .pNext = &rendering_create_info,
-        .stageCount = 2,
+        .stageCount = static_cast<uint32_t>(shader_stages.size()),
         .pStages = shader_stages.data(),
-        .pVertexInputState = &vertex_input_state,
-        .pInputAssemblyState = &input_assembly_state,
+        //mesh shaders fetch their own vertices
+        .pVertexInputState = mesh_shading ? nullptr : &vertex_input_state,
+        .pInputAssemblyState = mesh_shading ? nullptr : &input_assembly_state,
         .pViewportState = &viewport_state,
         .pRasterizationState = &rasterization_state,
         .pMultisampleState = &multisample_state,
@@ -120,11 +173,8 @@ Pipeline::Pipeline(Engine* engine, RendererLoader* loader, Output* output)
         .pDynamicState = &dynamic_state,
         .layout = pipeline_layout
     };
-    vkCreateGraphicsPipelines(engine->device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &pipeline);
-
-    engine->main_deletion_queue.push([=]()
-    {
-        vkDestroyPipelineLayout(engine->device, pipeline_layout, nullptr);
-        vkDestroyPipeline(engine->device, pipeline, nullptr);
-    });
-}
\ No newline at end of file
+    VkPipeline created;
+    vkCreateGraphicsPipelines(engine->device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &created);
+    Instrumentation::setObjectName(engine->device, VK_OBJECT_TYPE_PIPELINE, (uint64_t)created, name);
+    return created;
+}
@@ -9,12 +9,32 @@ struct PushConstants
     VkDeviceAddress scene;
     uint32_t texture_index;
     uint32_t instance_id;
+    //mesh shader draws only, the vertex path leaves them zero
+    VkDeviceAddress meshlets;
+    VkDeviceAddress meshlet_vertices;
+    VkDeviceAddress meshlet_triangles;
+    VkDeviceAddress vertices;
+    uint32_t meshlet_count;
+    uint32_t pad;
 };
 class Pipeline
 {
+    VkPipeline createPipeline(Engine* engine, RendererLoader* loader, Output* output, bool depth_only, VkCompareOp depth_compare, bool depth_write, bool mesh_shading, const char* name);
+
 public:
     VkPipeline pipeline;
+    //shading after a depth pre-pass, only the visible fragment of each pixel passes the EQUAL test
+    VkPipeline depth_equal_pipeline;
+    //position stream only and no fragment shader, fills depth for the pre-pass
+    VkPipeline depth_prepass_pipeline;
+    //task shaders cull meshlets against the frustum and their normal cone before mesh shaders emit them
+    //same roles as the three above, VK_NULL_HANDLE when the device has no mesh shaders
+    VkPipeline mesh_pipeline = VK_NULL_HANDLE;
+    VkPipeline mesh_depth_equal_pipeline = VK_NULL_HANDLE;
+    VkPipeline mesh_depth_prepass_pipeline = VK_NULL_HANDLE;
     VkPipelineLayout pipeline_layout;
+    //stages the push constant range covers, vkCmdPushConstants has to name all of them
+    VkShaderStageFlags push_constant_stages;
 
     Pipeline(Engine* engine, RendererLoader* loader, Output* output);
 };
\ No newline at end of file
@@ -0,0 +1,737 @@
+#include "RenderGraph.h"
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+struct AccessInfo
+{
+    VkPipelineStageFlags2 stage;
+    VkAccessFlags2 access;
+    VkImageLayout layout;
+    VkImageUsageFlags usage;
+    bool reads;
+    bool writes;
+};
+
+static AccessInfo accessInfo(GraphAccess access)
+{
+    switch(access)
+    {
+        case GraphAccess::ColorAttachmentWrite:
+            return {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, false, true};
+        case GraphAccess::DepthAttachmentWrite:
+            return {VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, false, true};
+        case GraphAccess::DepthAttachmentRead:
+            return {VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+                VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, true, false};
+        case GraphAccess::TransferRead:
+            return {VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, true, false};
+        case GraphAccess::TransferWrite:
+            return {VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT, false, true};
+        case GraphAccess::ComputeStorageRead:
+            return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+                VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, true, false};
+        case GraphAccess::ComputeStorageWrite:
+            return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, false, true};
+        case GraphAccess::FragmentStorageRead:
+            return {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+                VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, true, false};
+        case GraphAccess::FragmentSampled:
+            return {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+                VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, true, false};
+        case GraphAccess::Present:
+            return {VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, VK_ACCESS_2_NONE,
+                VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, 0, true, false};
+    }
+    return {};
+}
+
+constexpr VkAccessFlags2 write_accesses = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+
+static uint64_t mix(uint64_t hash, uint64_t value)
+{
+    return (hash ^ value) * 0x100000001b3ull;
+}
+
+static uint64_t mix(uint64_t hash, const std::string& text)
+{
+    for(char c : text)
+    {
+        hash = mix(hash, static_cast<uint8_t>(c));
+    }
+    return mix(hash, text.size());
+}
+
+//barriers on combined depth stencil formats have to name both aspects
+static VkImageAspectFlags barrierAspect(const GraphImageDesc& desc)
+{
+    if(desc.format == VK_FORMAT_D32_SFLOAT_S8_UINT || desc.format == VK_FORMAT_D24_UNORM_S8_UINT || desc.format == VK_FORMAT_D16_UNORM_S8_UINT)
+    {
+        return desc.aspect | VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+    return desc.aspect;
+}
+
+void RenderGraph::setup(Engine* engine)
+{
+    this->engine = engine;
+}
+
+void RenderGraph::begin()
+{
+    resources.clear();
+    passes.clear();
+}
+
+GraphResource RenderGraph::createImage(const std::string& name, const GraphImageDesc& desc)
+{
+    resources.push_back({
+        .name = name,
+        .is_image = true,
+        .transient = true,
+        .desc = desc
+    });
+    return static_cast<GraphResource>(resources.size() - 1);
+}
+
+GraphResource RenderGraph::importImage(const std::string& name, VkImage image, VkImageView view, VkImageAspectFlags aspect, VkFormat format, const GraphState& initial)
+{
+    resources.push_back({
+        .name = name,
+        .is_image = true,
+        .transient = false,
+        .desc = {
+            .format = format,
+            .aspect = aspect
+        },
+        .handle = (uint64_t)image,
+        .view = view,
+        .has_initial = true,
+        .initial = initial
+    });
+    return static_cast<GraphResource>(resources.size() - 1);
+}
+
+GraphResource RenderGraph::importBuffer(const std::string& name, VkBuffer buffer)
+{
+    auto it = imported_states.find((uint64_t)buffer);
+    resources.push_back({
+        .name = name,
+        .is_image = false,
+        .transient = false,
+        .handle = (uint64_t)buffer,
+        .has_initial = it != imported_states.end(),
+        .initial = it != imported_states.end() ? it->second : GraphState{}
+    });
+    return static_cast<GraphResource>(resources.size() - 1);
+}
+
+void RenderGraph::exportResource(GraphResource resource, GraphAccess final_access)
+{
+    resources[resource].exported = true;
+    resources[resource].final_access = final_access;
+}
+
+uint32_t RenderGraph::addPass(const std::string& name, std::function<void(VkCommandBuffer)>&& record, bool side_effects)
+{
+    passes.push_back({
+        .name = name,
+        .record = std::move(record),
+        .side_effects = side_effects
+    });
+    return static_cast<uint32_t>(passes.size() - 1);
+}
+
+void RenderGraph::use(uint32_t pass, GraphResource resource, GraphAccess access)
+{
+    passes[pass].uses.push_back({resource, access});
+}
+
+uint64_t RenderGraph::describedHash() const
+{
+    //everything but the handles, which change every frame for the swapchain image
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for(const Resource& r : resources)
+    {
+        hash = mix(hash, r.name);
+        hash = mix(hash, (uint64_t)r.is_image | (uint64_t)r.transient << 1 | (uint64_t)r.has_initial << 2 | (uint64_t)r.exported << 3);
+        hash = mix(hash, (uint64_t)r.desc.format << 32 | r.desc.aspect);
+        hash = mix(hash, (uint64_t)r.desc.extent.width << 32 | r.desc.extent.height);
+        hash = mix(hash, r.desc.extra_usage);
+        hash = mix(hash, r.initial.stage);
+        hash = mix(hash, r.initial.access);
+        hash = mix(hash, (uint64_t)r.initial.layout << 32 | (uint32_t)r.final_access);
+    }
+    for(const Pass& p : passes)
+    {
+        hash = mix(hash, p.name);
+        hash = mix(hash, p.side_effects);
+        for(const Use& u : p.uses)
+        {
+            hash = mix(hash, (uint64_t)u.resource << 32 | (uint32_t)u.access);
+        }
+    }
+    return hash;
+}
+
+void RenderGraph::compile()
+{
+    compile_count++;
+    size_t resource_count = resources.size();
+    plan.live_passes.clear();
+    plan.barrier_begin.clear();
+    plan.barriers.clear();
+    plan.final_barriers.clear();
+
+    //walk back from the exported resources, a write that nothing later reads does not keep its pass
+    std::vector<uint8_t> needed(resource_count, 0);
+    for(size_t r = 0; r < resource_count; r++)
+    {
+        needed[r] = resources[r].exported;
+    }
+    std::vector<uint8_t> live(passes.size(), 0);
+    for(size_t p = passes.size(); p-- > 0;)
+    {
+        bool keep = passes[p].side_effects;
+        for(const Use& u : passes[p].uses)
+        {
+            keep = keep || (accessInfo(u.access).writes && needed[u.resource]);
+        }
+        if(!keep)
+        {
+            continue;
+        }
+        live[p] = 1;
+        for(const Use& u : passes[p].uses)
+        {
+            if(accessInfo(u.access).writes)
+            {
+                needed[u.resource] = 0;
+            }
+        }
+        for(const Use& u : passes[p].uses)
+        {
+            if(accessInfo(u.access).reads)
+            {
+                needed[u.resource] = 1;
+            }
+        }
+    }
+    for(uint32_t p = 0; p < passes.size(); p++)
+    {
+        if(live[p])
+        {
+            plan.live_passes.push_back(p);
+        }
+        else
+        {
+            std::cout << "render graph: culled pass " << passes[p].name << std::endl;
+        }
+    }
+
+    //lifetimes of transients over the live passes, and every stage each resource is touched in
+    std::vector<uint32_t> first_use(resource_count, UINT32_MAX);
+    std::vector<uint32_t> last_use(resource_count, 0);
+    std::vector<VkPipelineStageFlags2> use_stages(resource_count, 0);
+    for(uint32_t i = 0; i < plan.live_passes.size(); i++)
+    {
+        for(const Use& u : passes[plan.live_passes[i]].uses)
+        {
+            first_use[u.resource] = std::min(first_use[u.resource], i);
+            last_use[u.resource] = i;
+            use_stages[u.resource] |= accessInfo(u.access).stage;
+        }
+    }
+    std::vector<GraphState> initial_states(resource_count);
+    for(size_t r = 0; r < resource_count; r++)
+    {
+        initial_states[r] = resources[r].has_initial ? resources[r].initial : GraphState{VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED};
+    }
+    allocateTransients(first_use, last_use, use_stages, initial_states);
+
+    struct Track
+    {
+        VkPipelineStageFlags2 write_stage;
+        VkAccessFlags2 write_access;
+        VkPipelineStageFlags2 read_stage;
+        //stages and accesses the last write has been made visible to
+        VkPipelineStageFlags2 visible_stage;
+        VkAccessFlags2 visible_access;
+        VkImageLayout layout;
+    };
+    std::vector<Track> tracks(resource_count);
+    for(size_t r = 0; r < resource_count; r++)
+    {
+        tracks[r] = {
+            .write_stage = initial_states[r].stage,
+            .write_access = initial_states[r].access,
+            .layout = initial_states[r].layout
+        };
+    }
+
+    auto transition = [&](GraphResource r, const AccessInfo& info, std::vector<Barrier>& out)
+    {
+        Track& t = tracks[r];
+        bool is_image = resources[r].is_image;
+        bool relayout = is_image && info.layout != t.layout;
+        if(relayout || info.writes)
+        {
+            //writes and layout changes wait for every earlier access, reads included
+            VkPipelineStageFlags2 src_stage = t.write_stage | t.read_stage;
+            if(relayout || src_stage != 0)
+            {
+                out.push_back({
+                    .resource = r,
+                    .src_stage = src_stage,
+                    .src_access = t.write_access,
+                    .dst_stage = info.stage,
+                    .dst_access = info.access,
+                    .old_layout = t.layout,
+                    .new_layout = is_image ? info.layout : t.layout
+                });
+            }
+            t = {
+                .write_stage = info.stage,
+                .write_access = info.access & write_accesses,
+                .read_stage = info.reads ? info.stage : 0,
+                //nothing has seen this write yet, not even a later read in the writer's own stages
+                .visible_stage = 0,
+                .visible_access = 0,
+                .layout = is_image ? info.layout : t.layout
+            };
+            return;
+        }
+        //readers already covered by an earlier barrier of the same write need nothing
+        if(t.write_stage != 0 && ((t.visible_stage & info.stage) != info.stage || (t.visible_access & info.access) != info.access))
+        {
+            out.push_back({
+                .resource = r,
+                .src_stage = t.write_stage,
+                .src_access = t.write_access,
+                .dst_stage = info.stage,
+                .dst_access = info.access,
+                .old_layout = t.layout,
+                .new_layout = t.layout
+            });
+            t.visible_stage |= info.stage;
+            t.visible_access |= info.access;
+        }
+        t.read_stage |= info.stage;
+    };
+
+    for(uint32_t pass_index : plan.live_passes)
+    {
+        plan.barrier_begin.push_back(static_cast<uint32_t>(plan.barriers.size()));
+        //several uses of one resource in a pass become a single access
+        std::vector<std::pair<GraphResource, AccessInfo>> merged;
+        for(const Use& u : passes[pass_index].uses)
+        {
+            AccessInfo info = accessInfo(u.access);
+            auto it = std::find_if(merged.begin(), merged.end(), [&](const auto& m) { return m.first == u.resource; });
+            if(it == merged.end())
+            {
+                merged.push_back({u.resource, info});
+                continue;
+            }
+            it->second.stage |= info.stage;
+            it->second.access |= info.access;
+            it->second.usage |= info.usage;
+            it->second.reads = it->second.reads || info.reads;
+            it->second.writes = it->second.writes || info.writes;
+        }
+        for(const auto& [resource, info] : merged)
+        {
+            transition(resource, info, plan.barriers);
+        }
+    }
+    plan.barrier_begin.push_back(static_cast<uint32_t>(plan.barriers.size()));
+
+#ifndef NDEBUG
+    //the first read after a write in an earlier pass has to wait on it, like the main pass loading the pre-pass depth
+    std::vector<bool> unread_write(resource_count, false);
+    for(size_t i = 0; i < plan.live_passes.size(); i++)
+    {
+        const std::vector<Use>& uses = passes[plan.live_passes[i]].uses;
+        for(const Use& u : uses)
+        {
+            AccessInfo info = accessInfo(u.access);
+            if(info.reads && unread_write[u.resource])
+            {
+                bool waited = std::any_of(plan.barriers.begin() + plan.barrier_begin[i], plan.barriers.begin() + plan.barrier_begin[i + 1],
+                    [&](const Barrier& b) { return b.resource == u.resource && (b.dst_access & info.access) != 0; });
+                assert(waited && "render graph read after write without a barrier");
+            }
+        }
+        for(const Use& u : uses)
+        {
+            AccessInfo info = accessInfo(u.access);
+            unread_write[u.resource] = info.writes || (!info.reads && unread_write[u.resource]);
+        }
+    }
+#endif
+
+    for(GraphResource r = 0; r < resource_count; r++)
+    {
+        if(resources[r].exported)
+        {
+            transition(r, accessInfo(resources[r].final_access), plan.final_barriers);
+        }
+    }
+    plan.end_states.resize(resource_count);
+    for(size_t r = 0; r < resource_count; r++)
+    {
+        plan.end_states[r] = {
+            .stage = tracks[r].write_stage | tracks[r].read_stage,
+            .access = tracks[r].write_access,
+            .layout = tracks[r].layout
+        };
+    }
+    std::cout << "render graph compiled: " << plan.live_passes.size() << " of " << passes.size() << " passes, "
+        << plan.barriers.size() + plan.final_barriers.size() << " barriers" << std::endl;
+}
+
+void RenderGraph::allocateTransients(const std::vector<uint32_t>& first_use, const std::vector<uint32_t>& last_use, const std::vector<VkPipelineStageFlags2>& use_stages, std::vector<GraphState>& initial_states)
+{
+    struct Candidate
+    {
+        GraphResource resource;
+        VkImageCreateInfo create_info;
+        VkMemoryRequirements requirements;
+        uint32_t slot;
+    };
+    struct Slot
+    {
+        VkMemoryRequirements requirements;
+        std::vector<uint32_t> candidates;
+    };
+
+    std::vector<VkImageUsageFlags> usage(resources.size(), 0);
+    for(const Pass& p : passes)
+    {
+        for(const Use& u : p.uses)
+        {
+            usage[u.resource] |= accessInfo(u.access).usage;
+        }
+    }
+    std::vector<Candidate> candidates;
+    for(GraphResource r = 0; r < resources.size(); r++)
+    {
+        if(!resources[r].transient || first_use[r] == UINT32_MAX)
+        {
+            continue;
+        }
+        const GraphImageDesc& desc = resources[r].desc;
+        Candidate candidate = {
+            .resource = r,
+            .create_info = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                .imageType = VK_IMAGE_TYPE_2D,
+                .format = desc.format,
+                .extent = {
+                    .width = desc.extent.width,
+                    .height = desc.extent.height,
+                    .depth = 1
+                },
+                .mipLevels = 1,
+                .arrayLayers = 1,
+                .samples = VK_SAMPLE_COUNT_1_BIT,
+                .tiling = VK_IMAGE_TILING_OPTIMAL,
+                .usage = usage[r] | desc.extra_usage,
+                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+            }
+        };
+        //1.3 answers without creating the image, so an unchanged assignment costs no allocation
+        VkDeviceImageMemoryRequirements requirements_info = {
+            .sType = VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS,
+            .pCreateInfo = &candidate.create_info
+        };
+        VkMemoryRequirements2 requirements = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2
+        };
+        vkGetDeviceImageMemoryRequirements(engine->device, &requirements_info, &requirements);
+        candidate.requirements = requirements.memoryRequirements;
+        candidates.push_back(candidate);
+    }
+
+    //largest first into the first slot whose occupants are all dead or not yet born
+    std::vector<uint32_t> order(candidates.size());
+    for(uint32_t i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+    {
+        return candidates[a].requirements.size > candidates[b].requirements.size;
+    });
+    std::vector<Slot> slots;
+    for(uint32_t i : order)
+    {
+        Candidate& c = candidates[i];
+        uint32_t chosen = UINT32_MAX;
+        for(uint32_t s = 0; s < slots.size() && chosen == UINT32_MAX; s++)
+        {
+            if((slots[s].requirements.memoryTypeBits & c.requirements.memoryTypeBits) == 0)
+            {
+                continue;
+            }
+            bool overlaps = false;
+            for(uint32_t other : slots[s].candidates)
+            {
+                GraphResource o = candidates[other].resource;
+                overlaps = overlaps || (first_use[c.resource] <= last_use[o] && first_use[o] <= last_use[c.resource]);
+            }
+            if(!overlaps)
+            {
+                chosen = s;
+            }
+        }
+        if(chosen == UINT32_MAX)
+        {
+            slots.push_back({.requirements = c.requirements});
+            chosen = static_cast<uint32_t>(slots.size() - 1);
+        }
+        Slot& slot = slots[chosen];
+        slot.requirements.size = std::max(slot.requirements.size, c.requirements.size);
+        slot.requirements.alignment = std::max(slot.requirements.alignment, c.requirements.alignment);
+        slot.requirements.memoryTypeBits &= c.requirements.memoryTypeBits;
+        slot.candidates.push_back(i);
+        c.slot = chosen;
+    }
+
+    //each occupant starts from whatever last touched its memory, the one before it in the frame
+    //or, for the first, the slot's last occupant in the previous frame
+    for(Slot& slot : slots)
+    {
+        std::sort(slot.candidates.begin(), slot.candidates.end(), [&](uint32_t a, uint32_t b)
+        {
+            return first_use[candidates[a].resource] < first_use[candidates[b].resource];
+        });
+        for(size_t k = 0; k < slot.candidates.size(); k++)
+        {
+            const Candidate& previous = candidates[slot.candidates[(k + slot.candidates.size() - 1) % slot.candidates.size()]];
+            initial_states[candidates[slot.candidates[k]].resource] = {
+                .stage = use_stages[previous.resource],
+                .access = VK_ACCESS_2_NONE,
+                .layout = VK_IMAGE_LAYOUT_UNDEFINED
+            };
+        }
+    }
+
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for(const Candidate& c : candidates)
+    {
+        hash = mix(hash, (uint64_t)c.resource << 32 | c.slot);
+        hash = mix(hash, (uint64_t)c.create_info.format << 32 | c.create_info.usage);
+        hash = mix(hash, (uint64_t)c.create_info.extent.width << 32 | c.create_info.extent.height);
+    }
+    if(hash == transients.hash && transients.images.size() == resources.size())
+    {
+        return;
+    }
+
+    releaseTransients();
+    allocation_count++;
+    transients.hash = hash;
+    transients.images.assign(resources.size(), ImageAlloc{});
+    transients.requested_bytes = 0;
+    for(const Slot& slot : slots)
+    {
+        VmaAllocationCreateInfo allocation_create_info = {
+            .flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT,
+            .preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+        };
+        VmaAllocation allocation;
+        VmaAllocationInfo allocation_info;
+        vmaAllocateMemory(engine->allocator, &slot.requirements, &allocation_create_info, &allocation, &allocation_info);
+        vmaSetAllocationName(engine->allocator, allocation, memoryCategoryName(MemoryCategory::Attachments));
+        MemoryBudget::recordAllocation(MemoryCategory::Attachments, allocation_info.size);
+        transients.memory.push_back(allocation);
+        transients.allocated_bytes += allocation_info.size;
+    }
+    for(const Candidate& c : candidates)
+    {
+        //the image owns no memory, the slot allocation is freed on its own
+        ImageAlloc& image = transients.images[c.resource];
+        image.allocator = engine->allocator;
+        image.device = engine->device;
+        image.allocation = VK_NULL_HANDLE;
+        image.size = 0;
+        image.category = MemoryCategory::Attachments;
+        vkCreateImage(engine->device, &c.create_info, nullptr, &image.handle);
+        vmaBindImageMemory(engine->allocator, transients.memory[c.slot], image.handle);
+        VkImageViewCreateInfo view_create_info = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = image.handle,
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = c.create_info.format,
+            .subresourceRange = {
+                .aspectMask = resources[c.resource].desc.aspect,
+                .levelCount = 1,
+                .layerCount = 1
+            }
+        };
+        vkCreateImageView(engine->device, &view_create_info, nullptr, &image.view);
+        Instrumentation::setObjectName(engine->device, VK_OBJECT_TYPE_IMAGE, (uint64_t)image.handle, resources[c.resource].name.c_str());
+        Instrumentation::setObjectName(engine->device, VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)image.view, resources[c.resource].name.c_str());
+        transients.requested_bytes += c.requirements.size;
+    }
+    std::cout << "render graph: " << candidates.size() << " transient images in " << slots.size() << " allocations, "
+        << transients.allocated_bytes / 1024 << " KiB for " << transients.requested_bytes / 1024 << " KiB of images" << std::endl;
+}
+
+void RenderGraph::releaseTransients()
+{
+    //frames in flight may still be rendering into them
+    for(ImageAlloc& image : transients.images)
+    {
+        engine->retirement_queue.retire(image);
+    }
+    for(VmaAllocation allocation : transients.memory)
+    {
+        VmaAllocationInfo allocation_info;
+        vmaGetAllocationInfo(engine->allocator, allocation, &allocation_info);
+        engine->retirement_queue.retireMemory(allocation, MemoryCategory::Attachments, allocation_info.size);
+    }
+    transients.images.clear();
+    transients.memory.clear();
+    transients.allocated_bytes = 0;
+}
+
+void RenderGraph::execute(VkCommandBuffer cmd)
+{
+    uint64_t hash = describedHash();
+    if(hash != plan.hash || plan.barrier_begin.size() != plan.live_passes.size() + 1)
+    {
+        compile();
+        plan.hash = hash;
+    }
+    for(GraphResource r = 0; r < resources.size(); r++)
+    {
+        if(resources[r].transient && r < transients.images.size())
+        {
+            resources[r].handle = (uint64_t)transients.images[r].handle;
+            resources[r].view = transients.images[r].view;
+        }
+    }
+
+    FrameArena& arena = FrameArena::local();
+    auto emit = [&](const Barrier* begin, const Barrier* end)
+    {
+        if(begin == end)
+        {
+            return;
+        }
+        FrameVector<VkImageMemoryBarrier2> image_barriers(arena);
+        FrameVector<VkBufferMemoryBarrier2> buffer_barriers(arena);
+        for(const Barrier* b = begin; b != end; ++b)
+        {
+            const Resource& r = resources[b->resource];
+            if(r.is_image)
+            {
+                image_barriers.push_back({
+                    .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+                    .srcStageMask = b->src_stage,
+                    .srcAccessMask = b->src_access,
+                    .dstStageMask = b->dst_stage,
+                    .dstAccessMask = b->dst_access,
+                    .oldLayout = b->old_layout,
+                    .newLayout = b->new_layout,
+                    .image = (VkImage)r.handle,
+                    .subresourceRange = {
+                        .aspectMask = barrierAspect(r.desc),
+                        .levelCount = 1,
+                        .layerCount = 1
+                    }
+                });
+            }
+            else
+            {
+                buffer_barriers.push_back({
+                    .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+                    .srcStageMask = b->src_stage,
+                    .srcAccessMask = b->src_access,
+                    .dstStageMask = b->dst_stage,
+                    .dstAccessMask = b->dst_access,
+                    .buffer = (VkBuffer)r.handle,
+                    .size = VK_WHOLE_SIZE
+                });
+            }
+        }
+        VkDependencyInfo dependency_info = {
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .bufferMemoryBarrierCount = static_cast<uint32_t>(buffer_barriers.size()),
+            .pBufferMemoryBarriers = buffer_barriers.data(),
+            .imageMemoryBarrierCount = static_cast<uint32_t>(image_barriers.size()),
+            .pImageMemoryBarriers = image_barriers.data()
+        };
+        vkCmdPipelineBarrier2(cmd, &dependency_info);
+    };
+
+    for(size_t i = 0; i < plan.live_passes.size(); i++)
+    {
+        Pass& pass = passes[plan.live_passes[i]];
+        //the label spans the pass's barriers so captures show what each one waited for
+        Instrumentation::beginLabel(cmd, pass.name.c_str());
+        emit(plan.barriers.data() + plan.barrier_begin[i], plan.barriers.data() + plan.barrier_begin[i + 1]);
+        pass.record(cmd);
+        Instrumentation::endLabel(cmd);
+    }
+    emit(plan.final_barriers.data(), plan.final_barriers.data() + plan.final_barriers.size());
+
+    //imported images come with their state, only buffers carry theirs over
+    for(GraphResource r = 0; r < resources.size(); r++)
+    {
+        if(!resources[r].is_image)
+        {
+            imported_states[resources[r].handle] = plan.end_states[r];
+        }
+    }
+}
+
+VkImage RenderGraph::image(GraphResource resource) const
+{
+    return (VkImage)resources[resource].handle;
+}
+
+VkImageView RenderGraph::imageView(GraphResource resource) const
+{
+    return resources[resource].view;
+}
+
+VkImageLayout RenderGraph::layout(GraphAccess access)
+{
+    return accessInfo(access).layout;
+}
+
+void RenderGraph::logStats() const
+{
+    std::cout << "render graph: compiled " << compile_count << " times, transients allocated " << allocation_count << " times, "
+        << transients.allocated_bytes / 1024 << " KiB for " << transients.requested_bytes / 1024 << " KiB of images" << std::endl;
+}
+
+void RenderGraph::destroy()
+{
+    for(ImageAlloc& image : transients.images)
+    {
+        image.destroy();
+    }
+    for(VmaAllocation allocation : transients.memory)
+    {
+        VmaAllocationInfo allocation_info;
+        vmaGetAllocationInfo(engine->allocator, allocation, &allocation_info);
+        MemoryBudget::recordFree(MemoryCategory::Attachments, allocation_info.size);
+        vmaFreeMemory(engine->allocator, allocation);
+    }
+    transients.images.clear();
+    transients.memory.clear();
+}
@@ -0,0 +1,169 @@
+#pragma once
+#include <volk/volk.h>
+#include <vma/vk_mem_alloc.h>
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <unordered_map>
+
+#include "Engine.h"
+#include "ImageAlloc.h"
+
+//index into the graph's resources, valid for the frame it was declared in
+using GraphResource = uint32_t;
+
+//how a pass touches a resource, each maps to fixed stages, accesses and an image layout
+//attachment and transfer writes are taken to overwrite the whole resource,
+//a pass that keeps earlier contents declares a read access on it as well
+enum class GraphAccess : uint32_t
+{
+    ColorAttachmentWrite,
+    DepthAttachmentWrite,
+    //depth test without writes, stays in the attachment layout so it needs no transition
+    DepthAttachmentRead,
+    TransferRead,
+    TransferWrite,
+    ComputeStorageRead,
+    ComputeStorageWrite,
+    FragmentStorageRead,
+    FragmentSampled,
+    //export only, the image ends the frame ready for vkQueuePresentKHR
+    Present
+};
+
+//state a resource is in when the graph first touches it, e.g. the stage a semaphore wait covers
+struct GraphState
+{
+    VkPipelineStageFlags2 stage;
+    VkAccessFlags2 access;
+    VkImageLayout layout;
+};
+
+struct GraphImageDesc
+{
+    VkFormat format;
+    VkExtent2D extent;
+    VkImageAspectFlags aspect;
+    //added to the usage derived from the declared accesses
+    VkImageUsageFlags extra_usage;
+};
+
+//frame graph of passes that declare what they read and write
+//the render loop describes the frame every frame, the graph compiles it only when its shape changes:
+//passes nothing consumes are culled, barriers are batched into one vkCmdPipelineBarrier2 in front of each pass,
+//and transient images whose lifetimes do not overlap share memory
+//passes record their own commands, barriers inside a pass (between a clear and a dispatch) stay the pass's job
+class RenderGraph
+{
+    struct Use
+    {
+        GraphResource resource;
+        GraphAccess access;
+    };
+
+    struct Pass
+    {
+        std::string name;
+        std::vector<Use> uses;
+        std::function<void(VkCommandBuffer)> record;
+        bool side_effects;
+    };
+
+    struct Resource
+    {
+        std::string name;
+        bool is_image;
+        bool transient;
+        GraphImageDesc desc;
+        //set every frame for imported resources, by compile for transients
+        uint64_t handle;
+        VkImageView view;
+        bool has_initial;
+        GraphState initial;
+        bool exported;
+        GraphAccess final_access;
+    };
+
+    struct Barrier
+    {
+        GraphResource resource;
+        VkPipelineStageFlags2 src_stage;
+        VkAccessFlags2 src_access;
+        VkPipelineStageFlags2 dst_stage;
+        VkAccessFlags2 dst_access;
+        VkImageLayout old_layout;
+        VkImageLayout new_layout;
+    };
+
+    //compiled form, reused for as long as the described graph hashes the same
+    struct Plan
+    {
+        uint64_t hash = 0;
+        std::vector<uint32_t> live_passes;
+        //barriers of live_passes[i] are barriers[barrier_begin[i], barrier_begin[i + 1])
+        std::vector<uint32_t> barrier_begin;
+        std::vector<Barrier> barriers;
+        //transitions of exported resources after the last pass
+        std::vector<Barrier> final_barriers;
+        //last state of every resource at the end of the frame
+        std::vector<GraphState> end_states;
+    };
+
+    struct Transients
+    {
+        uint64_t hash = 0;
+        //indexed by resource, empty for imports and culled transients
+        std::vector<ImageAlloc> images;
+        std::vector<VmaAllocation> memory;
+        VkDeviceSize allocated_bytes = 0;
+        VkDeviceSize requested_bytes = 0;
+    };
+
+    Engine* engine = nullptr;
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+    Plan plan;
+    Transients transients;
+    //end of frame state of imported buffers, the initial state next time the handle is imported
+    std::unordered_map<uint64_t, GraphState> imported_states;
+
+    uint64_t describedHash() const;
+    void compile();
+    void allocateTransients(const std::vector<uint32_t>& first_use, const std::vector<uint32_t>& last_use, const std::vector<VkPipelineStageFlags2>& use_stages, std::vector<GraphState>& initial_states);
+    void releaseTransients();
+
+public:
+    //times the frame was compiled and transients were reallocated, logged at shutdown
+    uint32_t compile_count = 0;
+    uint32_t allocation_count = 0;
+
+    void setup(Engine* engine);
+
+    //starts describing a frame, drops the previous frame's passes and resources
+    void begin();
+
+    //image owned by the graph, its contents do not survive the frame
+    GraphResource createImage(const std::string& name, const GraphImageDesc& desc);
+    //image owned elsewhere, initial is the state it arrives in
+    GraphResource importImage(const std::string& name, VkImage image, VkImageView view, VkImageAspectFlags aspect, VkFormat format, const GraphState& initial);
+    //buffer owned elsewhere, it starts the frame in the state the previous frame left it in
+    GraphResource importBuffer(const std::string& name, VkBuffer buffer);
+    //resource that must end the frame in final_access, passes leading to it are never culled
+    void exportResource(GraphResource resource, GraphAccess final_access);
+
+    //record runs when the graph executes, after the pass's barriers
+    //side_effects keeps the pass even when nothing reads what it writes
+    uint32_t addPass(const std::string& name, std::function<void(VkCommandBuffer)>&& record, bool side_effects = false);
+    void use(uint32_t pass, GraphResource resource, GraphAccess access);
+
+    //compiles when the description changed since the last frame, then records every live pass into cmd
+    void execute(VkCommandBuffer cmd);
+
+    VkImage image(GraphResource resource) const;
+    VkImageView imageView(GraphResource resource) const;
+    static VkImageLayout layout(GraphAccess access);
+
+    void logStats() const;
+    void destroy();
+};
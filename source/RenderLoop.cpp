@@ -7,291 +7,559 @@ void RenderLoop::render(Engine* engine, Output* output, RendererLoader* loader,
 
     while(!quit)
     {
-        vkWaitForFences(engine->device, 1, &loader->fences[frame_index], VK_TRUE, UINT64_MAX);
-        vkResetFences(engine->device, 1, &loader->fences[frame_index]);
+        //recreated before beginFrame so the old swapchain is tagged with the last submitted frame
+        if(update_swapchain && !output->recreateSwapchain(engine))
+        {
+            //minimized, nothing to present to until the window comes back
+            SDL_WaitEventTimeout(nullptr, 100);
+            processEvents(engine, scene, 0.0f);
+            continue;
+        }
+        update_swapchain = false;
 
+        FrameScheduler& scheduler = engine->frame_scheduler;
+        scheduler.beginFrame();
+        uint32_t frame_index = scheduler.frameIndex();
+        uint64_t frame_value = scheduler.frame_value;
 
-        vkAcquireNextImageKHR(engine->device, output->swapchain, UINT64_MAX, loader->present_semaphores[frame_index], VK_NULL_HANDLE, &image_index);
+        VkResult acquire_result = vkAcquireNextImageKHR(engine->device, output->swapchain, UINT64_MAX, loader->present_semaphores[frame_index], VK_NULL_HANDLE, &image_index);
+        if(acquire_result == VK_ERROR_OUT_OF_DATE_KHR)
+        {
+            //nothing was submitted, the next attempt records the same frame value
+            update_swapchain = true;
+            continue;
+        }
+        if(acquire_result == VK_SUBOPTIMAL_KHR)
+        {
+            //the semaphore is signalled, render this frame and recreate after presenting
+            update_swapchain = true;
+        }
+
+        engine->memory_budget.update(frame_value);
+        engine->defragmenter.beginFrame(scheduler.completedValue());
+        engine->retirement_queue.beginFrame(frame_value, scheduler.completedValue());
+        loader->bindless_textures.beginFrame(frame_value, scheduler.completedValue());
+        loader->geometry_heap.beginFrame(frame_value, scheduler.completedValue());
+        loader->frame_allocator.beginFrame(frame_index);
+        loader->dynamic_resolution.update(frame_index);
+        loader->frame_stats.update(frame_index);
+        FrameArena::beginFrame();
+        FrameArena& arena = FrameArena::local();
+
+        //begun before the scene is read so finished loads are swapped in and uploaded ahead of this frame's draws
+        VkCommandBuffer cmd = loader->command_buffers[frame_index];
+        VkCommandBufferBeginInfo begin = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+        };
+        vkBeginCommandBuffer(cmd, &begin);
+        loader->dynamic_resolution.writeBegin(cmd, frame_index);
+        loader->frame_stats.beginFrame(cmd, frame_index);
+        loader->assets.applyCompleted(cmd);
+        loader->scene_streamer.update();
 
 
-        scene->camera.proj = glm::perspective(glm::radians(45.0f), (float)output->window_width / (float)output->window_height, 0.1f, 32.0f);
+        scene->camera.proj = glm::perspective(glm::radians(45.0f), (float)output->window_width / (float)output->window_height, scene->camera.z_near, scene->camera.z_far);
         scene->camera.view = glm::translate(glm::mat4(1.0f), scene->camera.pos);
+        loader->texture_streamer.updateRequests(engine, scene, static_cast<float>(output->window_height), frame_value);
+        //the scene is rendered at this size into the graph's scene color and blitted up to the window
+        VkExtent2D render_extent = loader->dynamic_resolution.renderExtent(output->window_width, output->window_height, output->attachment_extent);
 
 
+        LightList lights = loader->light_clusters.uploadLights(loader->frame_allocator, scene);
         SceneData scene_data = {
             .projection = scene->camera.proj,
             .view = scene->camera.view,
             .light_pos = scene->light_pos,
-            .selected_instance = selected_instance
-        };
-        SceneData* mapped = reinterpret_cast<SceneData*>(loader->shader_data_buffers[frame_index].allocation_info.pMappedData);
-        *mapped = scene_data;
-
-
-        VkCommandBuffer cmd = loader->command_buffers[frame_index];
-        VkCommandBufferBeginInfo begin = {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+            .lights = lights.address,
+            .cluster_ranges = loader->light_clusters.rangesAddress(),
+            .cluster_indices = loader->light_clusters.indicesAddress(),
+            .selected_instance = selected_instance,
+            .light_count = lights.count,
+            .screen_size = glm::vec2(render_extent.width, render_extent.height),
+            .z_near = scene->camera.z_near,
+            .z_far = scene->camera.z_far,
+            .cluster_grid_x = cluster_grid_x,
+            .cluster_grid_y = cluster_grid_y,
+            .cluster_grid_z = cluster_grid_z,
+            .cone_culling = cone_culling ? 1u : 0u
         };
-        vkBeginCommandBuffer(cmd, &begin);
-
-
-        std::array<VkImageMemoryBarrier2, 2> barriers = {
-            VkImageMemoryBarrier2{
-                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-                .srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-                .dstStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-                .dstAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
-                .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-                .newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                .image = output->swapchain_images[image_index],
-                .subresourceRange = {
-                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                    .levelCount = 1,
-                    .layerCount = 1
+        VkDeviceAddress scene_data_address = loader->frame_allocator.push(scene_data);
+
+        //entities are culled and turned into packets by parallel jobs, then compacted in scene order
+        size_t entity_count = scene->entities.size();
+        FrameVector<DrawPacket> candidates(entity_count, arena);
+        FrameVector<uint8_t> visible(entity_count, arena);
+        //projected bounding disc area summed over the screen area, a cheap overdraw estimate
+        std::atomic<float> covered_pixels = 0.0f;
+        float half_height = scene->camera.proj[1][1] * output->window_height * 0.5f;
+        //side planes of the symmetric frustum in view space, x * focal + z <= 0 inside
+        glm::vec2 focal = glm::vec2(scene->camera.proj[0][0], scene->camera.proj[1][1]);
+        glm::vec2 side_scale = 1.0f / glm::sqrt(focal * focal + 1.0f);
+        float depth_scale = 1.0f / (scene->camera.z_far - scene->camera.z_near);
+        engine->job_system.parallelFor(0, entity_count, 256, [&](size_t begin, size_t end)
+        {
+            float chunk_pixels = 0.0f;
+            for(size_t i = begin; i < end; ++i)
+            {
+                const Entity& e = scene->entities[i];
+                visible[i] = 0;
+                if(!e.model || !e.model->texture || e.model->mesh == UINT32_MAX)
+                {
+                    continue;
                 }
-            },
-            VkImageMemoryBarrier2{
-                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-                .srcStageMask = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
-                .dstStageMask = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
-                .dstAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-                .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-                .newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-                .image = output->depth_attachment.handle,
-                .subresourceRange = {
-                    .aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT,
-                    .levelCount = 1,
-                    .layerCount = 1
+                float scale = std::max({glm::length(glm::vec3(e.transform[0])), glm::length(glm::vec3(e.transform[1])), glm::length(glm::vec3(e.transform[2]))});
+                glm::vec3 center = glm::vec3(scene->camera.view * e.transform * glm::vec4(e.model->bounds_center, 1.0f));
+                float radius = e.model->bounds_radius * scale;
+                float depth = -center.z;
+                if(depth + radius < scene->camera.z_near || depth - radius > scene->camera.z_far ||
+                    (std::abs(center.x) * focal.x - depth) * side_scale.x > radius ||
+                    (std::abs(center.y) * focal.y - depth) * side_scale.y > radius)
+                {
+                    continue;
                 }
+                float radius_px = radius * half_height / std::max(glm::length(center), radius);
+                chunk_pixels += glm::pi<float>() * radius_px * radius_px;
+                visible[i] = 1;
+                //one pipeline and no blending yet, every packet is opaque with pipeline 0
+                uint32_t page = loader->geometry_heap.mesh(e.model->mesh).page;
+                candidates[i] = {
+                    .model = e.model,
+                    .transform = &e.transform,
+                    .texture_index = e.model->texture->texture_index,
+                    .instance_id = static_cast<uint32_t>(i),
+                    .sort_key = drawSortKey(DrawLayer::Opaque, 0, page, e.model->texture->texture_index, e.model->mesh, (depth - scene->camera.z_near) * depth_scale)
+                };
             }
-        };
-        VkDependencyInfo barrier_dependency_info = {
-            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-            .imageMemoryBarrierCount = 2,
-            .pImageMemoryBarriers = barriers.data()
-        };
-        vkCmdPipelineBarrier2(cmd, &barrier_dependency_info);
-
-
-        VkRenderingAttachmentInfo color_attachment_info = {
-            .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
-            .imageView = output->swapchain_image_views[image_index],
-            .imageLayout = VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL,
-            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-            .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-            .clearValue{
-                .color{ 0.0f, 0.0f, 0.0f, 1.0f }
-            }
-        };
-        VkRenderingAttachmentInfo depth_attachment_info = {
-            .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
-            .imageView = output->depth_attachment.view,
-            .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-            .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-            .clearValue = {
-                .depthStencil = {1.0f,  0}
+            covered_pixels += chunk_pixels;
+        });
+        FrameVector<DrawPacket> draw_packets(arena);
+        draw_packets.reserve(entity_count);
+        for(size_t i = 0; i < entity_count; ++i)
+        {
+            if(visible[i])
+            {
+                draw_packets.push_back(candidates[i]);
             }
-        };
-        VkRenderingInfo rendering_info = {
-            .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
-            .renderArea = {
-                .extent = {
-                    .width = static_cast<uint32_t>(output->window_width),
-                    .height = static_cast<uint32_t>(output->window_height)
-                }
-            },
-            .layerCount = 1,
-            .colorAttachmentCount = 1,
-            .pColorAttachments = &color_attachment_info,
-            .pDepthAttachment = &depth_attachment_info
-        };
-        vkCmdBeginRendering(cmd, &rendering_info);
-
+        }
+        if(sort_draws)
+        {
+            sortDrawPackets(engine->job_system, draw_packets);
+        }
+        bool prepass = usePrepass(covered_pixels / static_cast<float>(output->window_width * output->window_height));
+
+        loader->texture_streamer.recordResidencyChanges(engine, &loader->bindless_textures, cmd, frame_value);
+        loader->geometry_heap.compact(cmd);
+        engine->defragmenter.recordMoves(cmd, frame_value);
+
+        //the frame from the light binning to the present, barriers between the passes come from the graph
+        RenderGraph& graph = loader->render_graph;
+        graph.begin();
+        GraphResource scene_color = graph.createImage("scene color", {
+            .format = output->image_format,
+            .extent = output->attachment_extent,
+            .aspect = VK_IMAGE_ASPECT_COLOR_BIT
+        });
+        GraphResource scene_depth = graph.createImage("scene depth", {
+            .format = output->depth_format,
+            .extent = output->attachment_extent,
+            .aspect = VK_IMAGE_ASPECT_DEPTH_BIT
+        });
+        //the acquire semaphore wait covers the blit stage
+        GraphResource swapchain_image = graph.importImage("swapchain", output->swapchain_images[image_index], output->swapchain_image_views[image_index],
+            VK_IMAGE_ASPECT_COLOR_BIT, output->image_format, {VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED});
+        graph.exportResource(swapchain_image, GraphAccess::Present);
+        GraphResource cluster_grid = graph.importBuffer("light clusters", loader->light_clusters.gridBuffer());
+
+        uint32_t clusters_pass = graph.addPass("light clusters", [&](VkCommandBuffer cmd)
+        {
+            loader->light_clusters.record(cmd, scene_data_address);
+        });
+        graph.use(clusters_pass, cluster_grid, GraphAccess::TransferWrite);
+        graph.use(clusters_pass, cluster_grid, GraphAccess::ComputeStorageWrite);
 
         VkViewport viewport = {
-            .width = static_cast<float>(output->window_width),
-            .height = static_cast<float>(output->window_height),
+            .width = static_cast<float>(render_extent.width),
+            .height = static_cast<float>(render_extent.height),
             .minDepth = 0.0f,
             .maxDepth = 1.0f
         };
-        vkCmdSetViewport(cmd, 0, 1, &viewport);
         VkRect2D scissor = {
-            .extent = {
-                .width = static_cast<uint32_t>(output->window_width),
-                .height = static_cast<uint32_t>(output->window_height)
-            }
+            .extent = render_extent
         };
-        vkCmdSetScissor(cmd, 0, 1, &scissor);
 
+        //meshes share geometry pages, buffers are only rebound when the page changes
+        //models with meshlets are drawn first through mesh_pipeline, placeholders and the rest through draw_pipeline
+        //a model takes the same path in every pass, so the pre-pass depth matches for the EQUAL test
+        RenderCounters& counters = loader->frame_stats.counters;
+        bool draw_meshlets = mesh_shading && pipeline->mesh_pipeline != VK_NULL_HANDLE;
+        //only the vertex pipeline draws are inside the pass's statistics query, mesh shader draws are not allowed in one
+        //that counts input assembly or vertex shader invocations, they show up in the cpu counters as mesh_draws
+        auto record_draws = [&](VkPipeline draw_pipeline, VkPipeline mesh_pipeline, bool positions_only, const char* stats_name)
+        {
+            vkCmdSetViewport(cmd, 0, 1, &viewport);
+            vkCmdSetScissor(cmd, 0, 1, &scissor);
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline_layout, 0, 1, &loader->bindless_textures.descriptor_set, 0, nullptr);
+            counters.descriptor_binds++;
+
+            uint32_t vertex_draws = 0;
+            if(draw_meshlets)
+            {
+                vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, mesh_pipeline);
+                counters.pipeline_binds++;
+                for(const DrawPacket& packet : draw_packets)
+                {
+                    const GeometryMesh& mesh = loader->geometry_heap.mesh(packet.model->mesh);
+                    if(mesh.meshlet_count == 0)
+                    {
+                        vertex_draws++;
+                        continue;
+                    }
+                    PushConstants pc = {
+                        .model_mat = *packet.transform,
+                        .scene = scene_data_address,
+                        .texture_index = packet.texture_index,
+                        .instance_id = packet.instance_id,
+                        .meshlets = mesh.meshlet_buffer.device_address,
+                        .meshlet_vertices = mesh.meshlet_buffer.device_address + mesh.meshlet_vertices_offset,
+                        .meshlet_triangles = mesh.meshlet_buffer.device_address + mesh.meshlet_triangles_offset,
+                        .vertices = loader->geometry_heap.vertexAddress(packet.model->mesh),
+                        .meshlet_count = mesh.meshlet_count
+                    };
+                    vkCmdPushConstants(cmd, pipeline->pipeline_layout, pipeline->push_constant_stages, 0, sizeof(PushConstants), &pc);
+                    //32 meshlets per task workgroup, see taskMain
+                    vkCmdDrawMeshTasksEXT(cmd, (mesh.meshlet_count + 31) / 32, 1, 1);
+                    counters.push_constant_bytes += sizeof(PushConstants);
+                    counters.draws++;
+                    counters.mesh_draws++;
+                    counters.instances++;
+                    counters.triangles += mesh.index_count / 3;
+                    counters.meshlets += mesh.meshlet_count;
+                }
+                if(vertex_draws == 0)
+                {
+                    return;
+                }
+            }
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, draw_pipeline);
+            counters.pipeline_binds++;
 
-        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
-        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline_layout, 0, 1, &loader->descriptor_set_textures, 0, nullptr);
+            loader->frame_stats.beginPass(cmd, stats_name);
+            uint32_t bound_page = UINT32_MAX;
+            for(const DrawPacket& packet : draw_packets)
+            {
+                const GeometryMesh& mesh = loader->geometry_heap.mesh(packet.model->mesh);
+                if(draw_meshlets && mesh.meshlet_count > 0)
+                {
+                    continue;
+                }
+                if(mesh.page != bound_page)
+                {
+                    VkBuffer page_buffer = loader->geometry_heap.buffer(mesh.page);
+                    VkDeviceSize vertex_region = positions_only ? loader->geometry_heap.positionRegion(mesh.page) : 0;
+                    vkCmdBindVertexBuffers(cmd, 0, 1, &page_buffer, &vertex_region);
+                    vkCmdBindIndexBuffer(cmd, page_buffer, loader->geometry_heap.indexRegion(mesh.page), VK_INDEX_TYPE_UINT16);
+                    bound_page = mesh.page;
+                    counters.buffer_binds++;
+                }
+                PushConstants pc = {
+                    .model_mat = *packet.transform,
+                    .scene = scene_data_address,
+                    .texture_index = packet.texture_index,
+                    .instance_id = packet.instance_id
+                };
+                vkCmdPushConstants(cmd, pipeline->pipeline_layout, pipeline->push_constant_stages, 0, sizeof(PushConstants), &pc);
+                vkCmdDrawIndexed(cmd, mesh.index_count, 1, mesh.first_index, static_cast<int32_t>(mesh.vertex_offset), 0);
+                counters.push_constant_bytes += sizeof(PushConstants);
+                counters.draws++;
+                counters.instances++;
+                counters.triangles += mesh.index_count / 3;
+            }
+            loader->frame_stats.endPass(cmd);
+        };
 
 
-        for(size_t i = 0; i < scene->entities.size(); ++i)
+        if(prepass)
         {
-            const Entity& e = scene->entities[i];
-            if(!e.model || !e.model->texture)
+            uint32_t prepass_pass = graph.addPass("depth prepass", [&](VkCommandBuffer cmd)
             {
-                continue;
-            }
-            PushConstants pc = {
-                .model_mat = e.transform,
-                .scene = loader->shader_data_addresses[frame_index],
-                .texture_index = e.model->texture->texture_index,
-                .instance_id = static_cast<uint32_t>(i)
-            };
-            vkCmdPushConstants(cmd, pipeline->pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstants), &pc);
-            VkDeviceSize vOffset = 0;
-            VkDeviceSize iOffset = e.model->v_buf_size;
-            vkCmdBindVertexBuffers(cmd, 0, 1, &e.model->model_buffer.handle, &vOffset);
-            vkCmdBindIndexBuffer(cmd, e.model->model_buffer.handle, iOffset, VK_INDEX_TYPE_UINT16);
-            vkCmdDrawIndexed(cmd, static_cast<uint32_t>(e.model->indices.size()), 1, 0, 0, 0);
+                //depth only, positions come from their own stream so the pass reads 12 bytes per vertex
+                VkRenderingAttachmentInfo depth_attachment_info = {
+                    .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+                    .imageView = graph.imageView(scene_depth),
+                    .imageLayout = RenderGraph::layout(GraphAccess::DepthAttachmentWrite),
+                    .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                    .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+                    .clearValue = {
+                        .depthStencil = {1.0f,  0}
+                    }
+                };
+                VkRenderingInfo prepass_rendering_info = {
+                    .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+                    .renderArea = scissor,
+                    .layerCount = 1,
+                    .pDepthAttachment = &depth_attachment_info
+                };
+                vkCmdBeginRendering(cmd, &prepass_rendering_info);
+                record_draws(pipeline->depth_prepass_pipeline, pipeline->mesh_depth_prepass_pipeline, true, "depth prepass");
+                vkCmdEndRendering(cmd);
+            });
+            graph.use(prepass_pass, scene_depth, GraphAccess::DepthAttachmentWrite);
         }
-        vkCmdEndRendering(cmd);
-        VkImageMemoryBarrier2 barrier_present = {
-            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-            .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-            .dstAccessMask = 0,
-            .oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-            .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-            .image = output->swapchain_images[image_index],
-            .subresourceRange{
-                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                .levelCount = 1,
-                .layerCount = 1 
-            }
-        };
-        VkDependencyInfo barrier_present_dependency_info = {
-            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-            .imageMemoryBarrierCount = 1,
-            .pImageMemoryBarriers = &barrier_present
-        };
-        vkCmdPipelineBarrier2(cmd, &barrier_present_dependency_info);
-        vkEndCommandBuffer(cmd);
 
+        uint32_t main_pass = graph.addPass("main", [&](VkCommandBuffer cmd)
+        {
+            VkRenderingAttachmentInfo depth_attachment_info = {
+                .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+                .imageView = graph.imageView(scene_depth),
+                .imageLayout = RenderGraph::layout(GraphAccess::DepthAttachmentWrite),
+                .loadOp = prepass ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR,
+                //DONT_CARE counts as a write, NONE keeps the pre-pass case a pure read
+                .storeOp = prepass ? VK_ATTACHMENT_STORE_OP_NONE : VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                .clearValue = {
+                    .depthStencil = {1.0f,  0}
+                }
+            };
+            VkRenderingAttachmentInfo color_attachment_info = {
+                .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+                .imageView = graph.imageView(scene_color),
+                .imageLayout = RenderGraph::layout(GraphAccess::ColorAttachmentWrite),
+                .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+                .clearValue{
+                    .color{ 0.0f, 0.0f, 0.0f, 1.0f }
+                }
+            };
+            VkRenderingInfo rendering_info = {
+                .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+                .renderArea = scissor,
+                .layerCount = 1,
+                .colorAttachmentCount = 1,
+                .pColorAttachments = &color_attachment_info,
+                .pDepthAttachment = &depth_attachment_info
+            };
+            vkCmdBeginRendering(cmd, &rendering_info);
+            //with the pre-pass depth is final, EQUAL shades only the visible fragment of each pixel
+            record_draws(prepass ? pipeline->depth_equal_pipeline : pipeline->pipeline,
+                prepass ? pipeline->mesh_depth_equal_pipeline : pipeline->mesh_pipeline, false, "main");
+            vkCmdEndRendering(cmd);
+            //the blit waits for the swapchain image, ending here keeps the acquire out of the measured time
+            loader->dynamic_resolution.writeEnd(cmd, frame_index);
+        });
+        graph.use(main_pass, scene_color, GraphAccess::ColorAttachmentWrite);
+        graph.use(main_pass, scene_depth, prepass ? GraphAccess::DepthAttachmentRead : GraphAccess::DepthAttachmentWrite);
+        graph.use(main_pass, cluster_grid, GraphAccess::FragmentStorageRead);
+
+        uint32_t blit_pass = graph.addPass("upscale blit", [&](VkCommandBuffer cmd)
+        {
+            VkImageBlit2 blit_region = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_BLIT_2,
+                .srcSubresource = {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .layerCount = 1
+                },
+                .srcOffsets = {{0, 0, 0}, {static_cast<int32_t>(render_extent.width), static_cast<int32_t>(render_extent.height), 1}},
+                .dstSubresource = {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .layerCount = 1
+                },
+                .dstOffsets = {{0, 0, 0}, {output->window_width, output->window_height, 1}}
+            };
+            VkBlitImageInfo2 blit_info = {
+                .sType = VK_STRUCTURE_TYPE_BLIT_IMAGE_INFO_2,
+                .srcImage = graph.image(scene_color),
+                .srcImageLayout = RenderGraph::layout(GraphAccess::TransferRead),
+                .dstImage = graph.image(swapchain_image),
+                .dstImageLayout = RenderGraph::layout(GraphAccess::TransferWrite),
+                .regionCount = 1,
+                .pRegions = &blit_region,
+                .filter = output->blit_filter
+            };
+            vkCmdBlitImage2(cmd, &blit_info);
+        });
+        graph.use(blit_pass, scene_color, GraphAccess::TransferRead);
+        graph.use(blit_pass, swapchain_image, GraphAccess::TransferWrite);
 
-        VkPipelineStageFlags wait_stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        VkSubmitInfo submit_info = {
-            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            .waitSemaphoreCount = 1,
-            .pWaitSemaphores = &loader->present_semaphores[frame_index],
-            .pWaitDstStageMask = &wait_stages,
-            .commandBufferCount = 1,
-            .pCommandBuffers = &cmd,
-            .signalSemaphoreCount = 1,
-            .pSignalSemaphores = &loader->render_semaphores[image_index],
-        };
-        vkQueueSubmit(engine->queue, 1, &submit_info, loader->fences[frame_index]);
+        graph.execute(cmd);
+        vkEndCommandBuffer(cmd);
+        loader->frame_stats.endFrame();
 
 
-        frame_index = (frame_index + 1) % max_frames_in_flight;
+        VkCommandBufferSubmitInfo cmd_submit_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+            .commandBuffer = cmd
+        };
+        VkSemaphoreSubmitInfo wait_info = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            .semaphore = loader->present_semaphores[frame_index],
+            .stageMask = VK_PIPELINE_STAGE_2_BLIT_BIT
+        };
+        std::array<VkSemaphoreSubmitInfo, 2> signal_infos = {
+            VkSemaphoreSubmitInfo{
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+                .semaphore = output->render_semaphores[image_index],
+                .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT
+            },
+            scheduler.signalInfo()
+        };
+        VkSubmitInfo2 submit_info = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+            .waitSemaphoreInfoCount = 1,
+            .pWaitSemaphoreInfos = &wait_info,
+            .commandBufferInfoCount = 1,
+            .pCommandBufferInfos = &cmd_submit_info,
+            .signalSemaphoreInfoCount = static_cast<uint32_t>(signal_infos.size()),
+            .pSignalSemaphoreInfos = signal_infos.data()
+        };
+        vkQueueSubmit2(engine->queue, 1, &submit_info, VK_NULL_HANDLE);
+        scheduler.endFrame();
 
 
         VkPresentInfoKHR present_info{
             .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
             .waitSemaphoreCount = 1,
-            .pWaitSemaphores = &loader->render_semaphores[image_index],
+            .pWaitSemaphores = &output->render_semaphores[image_index],
             .swapchainCount = 1,
             .pSwapchains = &output->swapchain,
             .pImageIndices = &image_index
         };
-        vkQueuePresentKHR(engine->queue, &present_info);
+        VkResult present_result = vkQueuePresentKHR(engine->queue, &present_info);
+        if(present_result == VK_ERROR_OUT_OF_DATE_KHR || present_result == VK_SUBOPTIMAL_KHR)
+        {
+            update_swapchain = true;
+        }
 
 
         float elapsed_time{ (SDL_GetTicks() - last_time) / 1000.0f };
         last_time = SDL_GetTicks();
-        SDL_Event event;
-        while(SDL_PollEvent(&event))
+        //SDL calls queued by jobs, SDL wants them on the thread that created the window
+        engine->job_system.pumpMainThread();
+        processEvents(engine, scene, elapsed_time);
+        //inserting a streamed scene chunk by chunk costs far more than one build once it is complete, picking still updates it
+        if(!loader->scene_streamer.streaming())
+        {
+            scene->bvh.update(*scene);
+        }
+    }
+    FrameArena& arena = FrameArena::local();
+    std::cout << "frame arena: peak " << arena.peak << " bytes, " << arena.overflow_count << " overflows" << std::endl;
+    loader->frame_stats.logTotals();
+    scene->bvh.logStats();
+        std::cout << "render loop finished" << std::endl;
+
+}
+
+void RenderLoop::pick(Engine* engine, Scene* scene, float x, float y)
+{
+    int width, height;
+    SDL_GetWindowSize(engine->window, &width, &height);
+    //through the eye and the point under the cursor at ndc z 1, the far plane with the [0, 1] forward depth used here
+    //under reverse z that is the near plane instead, which lies on the same ray, so only the comment would change
+    glm::vec2 ndc = glm::vec2(2.0f * x / static_cast<float>(width) - 1.0f, 2.0f * y / static_cast<float>(height) - 1.0f);
+    glm::vec4 far_point = glm::inverse(scene->camera.proj * scene->camera.view) * glm::vec4(ndc, 1.0f, 1.0f);
+    glm::vec3 eye = glm::vec3(glm::inverse(scene->camera.view)[3]);
+    glm::vec3 direction = glm::vec3(far_point) / far_point.w - eye;
+
+    uint64_t start = SDL_GetPerformanceCounter();
+    scene->bvh.update(*scene);
+    PickHit hit = scene->bvh.raycast(*scene, eye, direction);
+    double micros = static_cast<double>(SDL_GetPerformanceCounter() - start) * 1000000.0 / static_cast<double>(SDL_GetPerformanceFrequency());
+    if(hit.entity == UINT32_MAX)
+    {
+        std::cout << "picked nothing in " << micros << " us" << std::endl;
+        return;
+    }
+    selected_instance = hit.entity;
+    std::cout << "picked entity " << hit.entity << " at distance " << hit.t * glm::length(direction) << " in " << micros << " us" << std::endl;
+}
+
+bool RenderLoop::usePrepass(float overdraw)
+{
+    if(prepass_mode != DepthPrepassMode::Auto)
+    {
+        return prepass_mode == DepthPrepassMode::On;
+    }
+    //hysteresis so a scene sitting at the threshold does not flip every frame
+    bool active = prepass_active ? overdraw > prepass_overdraw_threshold * 0.8f : overdraw > prepass_overdraw_threshold;
+    if(active != prepass_active)
+    {
+        std::cout << "depth pre-pass " << (active ? "enabled" : "disabled") << ", estimated overdraw " << overdraw << std::endl;
+        prepass_active = active;
+    }
+    return prepass_active;
+}
+
+void RenderLoop::processEvents(Engine* engine, Scene* scene, float elapsed_time)
+{
+    SDL_Event event;
+    while(SDL_PollEvent(&event))
+    {
+        if(event.type == SDL_EVENT_QUIT)
         {
-            if(event.type == SDL_EVENT_QUIT)
+            quit = true;
+            break;
+        }
+        if(event.type == SDL_EVENT_MOUSE_MOTION && (event.motion.state & SDL_BUTTON_LMASK))
+        {
+            if (selected_instance < scene->entities.size())
             {
-                quit = true;
-                break;
+                float sens = elapsed_time * 2.0f;
+                glm::quat rotY = glm::angleAxis( event.motion.xrel * sens, glm::vec3(0,1,0));
+                glm::quat rotX = glm::angleAxis(-event.motion.yrel * sens, glm::vec3(1,0,0));
+                scene->moveEntity(selected_instance, scene->entities[selected_instance].transform * glm::mat4_cast(rotY * rotX));
             }
-            if(event.type == SDL_EVENT_MOUSE_MOTION && (event.motion.state & SDL_BUTTON_LMASK))
+        }
+        //clicking selects the entity under the cursor, dragging then rotates it
+        if(event.type == SDL_EVENT_MOUSE_BUTTON_DOWN && event.button.button == SDL_BUTTON_LEFT)
+        {
+            pick(engine, scene, event.button.x, event.button.y);
+        }
+        if(event.type == SDL_EVENT_MOUSE_WHEEL)
+        {
+            scene->camera.pos.z += event.wheel.y * elapsed_time * 10.0f;
+        }
+
+        if(event.type == SDL_EVENT_KEY_DOWN)
+        {
+            if(event.key.key == SDLK_PLUS || event.key.key == SDLK_KP_PLUS)
             {
-                if (selected_instance < scene->entities.size())
-                {
-                    float sens = elapsed_time * 2.0f;
-                    glm::quat rotY = glm::angleAxis( event.motion.xrel * sens, glm::vec3(0,1,0));
-                    glm::quat rotX = glm::angleAxis(-event.motion.yrel * sens, glm::vec3(1,0,0));
-                    scene->entities[selected_instance].transform = scene->entities[selected_instance].transform * glm::mat4_cast(rotY * rotX);
-                }
+                selected_instance = (selected_instance + 1) % static_cast<uint32_t>(scene->entities.size());
             }
-            if(event.type == SDL_EVENT_MOUSE_WHEEL)
+            if(event.key.key == SDLK_MINUS || event.key.key == SDLK_KP_MINUS)
             {
-                scene->camera.pos.z += event.wheel.y * elapsed_time * 10.0f;
+                selected_instance = selected_instance == 0 ? static_cast<uint32_t>(scene->entities.size())-1 : selected_instance-1;
             }
-
-            if(event.type == SDL_EVENT_KEY_DOWN)
+            //p cycles the depth pre-pass between auto, on and off
+            if(event.key.key == SDLK_P)
             {
-                if(event.key.key == SDLK_PLUS || event.key.key == SDLK_KP_PLUS)
-                {
-                    selected_instance = (selected_instance + 1) % static_cast<uint32_t>(scene->entities.size());
-                }
-                if(event.key.key == SDLK_MINUS || event.key.key == SDLK_KP_MINUS)
-                {
-                    selected_instance = selected_instance == 0 ? static_cast<uint32_t>(scene->entities.size())-1 : selected_instance-1;
-                }
+                prepass_mode = prepass_mode == DepthPrepassMode::Auto ? DepthPrepassMode::On :
+                    prepass_mode == DepthPrepassMode::On ? DepthPrepassMode::Off : DepthPrepassMode::Auto;
+                prepass_active = prepass_mode == DepthPrepassMode::On;
             }
-            if(event.type == SDL_EVENT_WINDOW_RESIZED)
+            if(event.key.key == SDLK_O)
             {
-                update_swapchain = true;
+                sort_draws = !sort_draws;
+                std::cout << "draw sorting " << (sort_draws ? "on" : "off") << std::endl;
             }
-        }
-        if(update_swapchain)
-        {
-            update_swapchain = false;
-            vkDeviceWaitIdle(engine->device);
-
-            SDL_GetWindowSize(engine->window, &output->window_width, &output->window_height);
-
-            for (auto& v : output->swapchain_image_views)
+            if(event.key.key == SDLK_M)
             {
-                vkDestroyImageView(engine->device, v, nullptr);
+                mesh_shading = !mesh_shading;
+                std::cout << "mesh shading " << (mesh_shading ? "on" : "off") << std::endl;
             }
-            output->swapchain_image_views.clear();
-
-            VkSwapchainKHR old = output->swapchain;
-
-            vkGetPhysicalDeviceSurfaceCapabilitiesKHR(engine->physical_device, engine->surface, &engine->surface_caps);
-
-            output->getImageFormat(engine);
-            VkSwapchainCreateInfoKHR swapchain_create_info = {
-                .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
-                .surface = engine->surface,
-                .minImageCount = engine->surface_caps.minImageCount + 1,
-                .imageFormat = output->image_format,
-                .imageColorSpace = output->image_color_space,
-                .imageExtent = {
-                    .width = static_cast<uint32_t>(output->window_width),
-                    .height = static_cast<uint32_t>(output->window_height)
-                },
-                .imageArrayLayers = 1,
-                .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-                .preTransform = engine->surface_caps.currentTransform,
-                .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
-                .presentMode = VK_PRESENT_MODE_FIFO_KHR,
-                .oldSwapchain = old
-            };
-            vkCreateSwapchainKHR(engine->device, &swapchain_create_info, nullptr, &output->swapchain);
-
-            output->createImageAndImageView(engine);
-
-            if(old != VK_NULL_HANDLE)
+            if(event.key.key == SDLK_N)
             {
-                vkDestroySwapchainKHR(engine->device, old, nullptr);
+                cone_culling = !cone_culling;
+                std::cout << "meshlet cone culling " << (cone_culling ? "on" : "off") << std::endl;
+            }
+            //1-4 pick frames in flight, 1 for latency, 3 or more to keep the gpu fed
+            if(event.key.key >= SDLK_1 && event.key.key <= SDLK_4)
+            {
+                engine->frame_scheduler.setFramesInFlight(static_cast<uint32_t>(event.key.key - SDLK_1) + 1);
             }
-
-            output->depth_attachment.destroy();
-            output->createDepthImageAndImageView(engine);
+        }
+        if(event.type == SDL_EVENT_WINDOW_RESIZED || event.type == SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED)
+        {
+            update_swapchain = true;
         }
     }
-        std::cout << "render loop finished" << std::endl;
-
-}
\ No newline at end of file
+}
@@ -5,18 +5,44 @@
 #include "Pipeline.h"
 #include "RendererLoader.h"
 #include "Scene.h"
+#include "FrameArena.h"
+#include "DrawPackets.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+
+//Auto runs the depth pre-pass only while the estimated overdraw is high enough to pay for it
+enum class DepthPrepassMode
+{
+    Auto,
+    On,
+    Off
+};
 
 class RenderLoop
 {
-    uint32_t frame_index = 0;
     uint32_t image_index = 0;
     bool quit = false;
     bool update_swapchain = false;
     uint32_t selected_instance = 0;
     uint64_t last_time = 0;
+    DepthPrepassMode prepass_mode = DepthPrepassMode::Auto;
+    //average layers of covered pixels per screen pixel before the pre-pass is worth the extra geometry
+    float prepass_overdraw_threshold = 1.5f;
+    bool prepass_active = false;
+    //packets in sort key order instead of scene order, o toggles it to compare
+    bool sort_draws = true;
+    //models with meshlets go through the task and mesh shaders when the device has them, m toggles it
+    bool mesh_shading = true;
+    //task shaders drop meshlets facing away from the camera, n toggles it
+    bool cone_culling = true;
+
+    bool usePrepass(float overdraw);
+
+    void processEvents(Engine* engine, Scene* scene, float elapsed_time);
+    //selects the entity under window point x, y
+    void pick(Engine* engine, Scene* scene, float x, float y);
 
 public:
     //call in the main after all setup is done
@@ -1,62 +1,24 @@
 #include "RendererLoader.h"
 #include "Scene.h"
 
-void RendererLoader::setupShaderDataBuffers(Engine* engine)
-{
-    //cosntructor sets up shared resources and synchronization objects
-    for(auto i = 0; i < max_frames_in_flight; i++)
-    {
-        size_t size = sizeof(SceneData);
-        VkBufferUsageFlags usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
-        VmaAllocationCreateFlags vma_flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_ALLOW_TRANSFER_INSTEAD_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
-        shader_data_buffers[i] = BufferAlloc::create(engine->allocator, engine->device, size, usage, vma_flags);
-
-        VkBufferDeviceAddressInfo addressInfo = {
-            .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
-            .buffer = shader_data_buffers[i].handle
-        };
-        shader_data_addresses[i] = vkGetBufferDeviceAddress(engine->device, &addressInfo);
-
-        engine->main_deletion_queue.push([=]() mutable
-        {
-            shader_data_buffers[i].destroy();
-        });
-    }
-    std::cout << "shader data buffers setup complete" << std::endl;
-}
+#include <unordered_map>
 
-void RendererLoader::setupSynchronizationObjects(Engine* engine, Output* output)
+void RendererLoader::setupSynchronizationObjects(Engine* engine)
 {
+    //frame completion is tracked by engine->frame_scheduler, only the binary acquire semaphores live here
     VkSemaphoreCreateInfo semaphore_create_info = {
         .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
     };
-    VkFenceCreateInfo fence_create_info = {
-        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-        .flags = VK_FENCE_CREATE_SIGNALED_BIT
-    };
     for(auto i = 0; i < max_frames_in_flight; i++)
     {
-        vkCreateFence(engine->device, &fence_create_info, nullptr, &fences[i]);
         vkCreateSemaphore(engine->device, &semaphore_create_info, nullptr, &present_semaphores[i]);
         
         engine->main_deletion_queue.push([=]()
         {
-            vkDestroyFence(engine->device, fences[i], nullptr);
             vkDestroySemaphore(engine->device, present_semaphores[i], nullptr);
         });
 
     }
-    render_semaphores.resize(output->swapchain_images.size());
-    for(auto& semaphore : render_semaphores)
-    {
-        vkCreateSemaphore(engine->device, &semaphore_create_info, nullptr, &semaphore);
-        engine->main_deletion_queue.push([=]()
-        {
-            vkDestroySemaphore(engine->device, semaphore, nullptr);
-            
-        });
-    }
-
     std::cout << "synchronization objects created" << std::endl;
 }
 
@@ -106,225 +68,369 @@ void RendererLoader::setupSamplers(Engine* engine)
 
 void RendererLoader::loadModel(Engine* engine, Model* model)
 {
-    model->v_buf_size = sizeof(Vertex) * model->vertices.size();
-    model->i_buf_size = sizeof(uint16_t) * model->indices.size();
-    size_t size = model->v_buf_size + model->i_buf_size;
-    VkBufferUsageFlags usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
-    VmaAllocationCreateFlags vma_flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_ALLOW_TRANSFER_INSTEAD_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
-    model->model_buffer = BufferAlloc::create(engine->allocator, engine->device, size, usage, vma_flags);
-    memcpy(model->model_buffer.allocation_info.pMappedData, model->vertices.data(), model->v_buf_size);
-    memcpy(((char*)model->model_buffer.allocation_info.pMappedData) + model->v_buf_size, model->indices.data(), model->i_buf_size);
-
-    engine->main_deletion_queue.push([=]() mutable
+    uploadMesh(engine, model, model->vertices.data(), static_cast<uint32_t>(model->vertices.size()), model->indices.data(), static_cast<uint32_t>(model->indices.size()));
+}
+
+AssetBundle* RendererLoader::openBundle(const std::string& path)
+{
+    auto bundle = std::make_unique<AssetBundle>();
+    if(!bundle->open(path))
     {
-        model->model_buffer.destroy();
-    });
-    std::cout << "mesh uploaded to cpu" << std::endl;
+        return nullptr;
+    }
+    ktx_loader.mountBundle(bundle.get());
+    bundles.push_back(std::move(bundle));
+    return bundles.back().get();
 }
 
-void RendererLoader::setupDescriptors(Engine* engine, Scene* scene)
+bool RendererLoader::loadModel(Engine* engine, Model* model, const AssetBundle& bundle, const std::string& name)
 {
-    VkDescriptorBindingFlags desc_var_flag = VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT;
-    VkDescriptorSetLayoutBindingFlagsCreateInfo desc_binding_flags = {
-    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
-    .bindingCount = 1,
-    .pBindingFlags = &desc_var_flag
-    };
-    VkDescriptorSetLayoutBinding desc_layout_binding_textures = {
-        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-        .descriptorCount = static_cast<uint32_t>(scene->textures.size()),
-        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
-    };
-    VkDescriptorSetLayoutCreateInfo desc_layout_texture_create_info = {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-        .pNext = &desc_binding_flags,
-        .bindingCount = 1,
-        .pBindings = &desc_layout_binding_textures
-    };
-    vkCreateDescriptorSetLayout(engine->device, &desc_layout_texture_create_info, nullptr, &descriptor_set_layout_textures);
+    const BundleEntry* entry = bundle.find(name);
+    const BundleMesh* mesh = entry ? bundle.mesh(*entry) : nullptr;
+    if(mesh == nullptr || mesh->vertex_stride != sizeof(Vertex) || mesh->index_size != sizeof(uint16_t))
+    {
+        std::cout << "no mesh " << name << " in " << bundle.path << std::endl;
+        return false;
+    }
+    model->bounds_min = glm::vec3(mesh->bounds_min[0], mesh->bounds_min[1], mesh->bounds_min[2]);
+    model->bounds_max = glm::vec3(mesh->bounds_max[0], mesh->bounds_max[1], mesh->bounds_max[2]);
+    model->bounds_center = glm::vec3(mesh->bounds_center[0], mesh->bounds_center[1], mesh->bounds_center[2]);
+    model->bounds_radius = mesh->bounds_radius;
+    const uint8_t* data = bundle.entryData(*entry);
+    uploadMesh(engine, model,
+        reinterpret_cast<const Vertex*>(data + mesh->vertex_offset), mesh->vertex_count,
+        reinterpret_cast<const uint16_t*>(data + mesh->index_offset), mesh->index_count);
+    if(mesh->texture_entry >= 0)
+    {
+        model->texture = loadTexture(engine, bundle, bundle.entry(static_cast<uint32_t>(mesh->texture_entry)));
+    }
+    return true;
+}
+
+void RendererLoader::uploadMesh(Engine* engine, Model* model, const Vertex* vertices, uint32_t vertex_count, const uint16_t* indices, uint32_t index_count)
+{
+    model->mesh = geometry_heap.allocate(vertex_count, index_count);
+    if(!geometry_heap.writeMapped(model->mesh, vertices, indices))
+    {
+        immediateSubmit(engine, [&](VkCommandBuffer cmd)
+        {
+            geometry_heap.recordUpload(cmd, model->mesh, vertices, indices);
+        });
+    }
+    model->bvh.build(vertices, indices, index_count);
+    if(engine->mesh_shader_supported)
+    {
+        MeshletData meshlets;
+        meshlets.build(vertices, vertex_count, indices, index_count);
+        if(!meshlets.empty() && !geometry_heap.writeMeshlets(model->mesh, meshlets))
+        {
+            immediateSubmit(engine, [&](VkCommandBuffer cmd)
+            {
+                geometry_heap.recordMeshletUpload(cmd, model->mesh, meshlets);
+            });
+        }
+    }
+    std::cout << "mesh uploaded to gpu" << std::endl;
+}
+
+void RendererLoader::unloadModel(Model* model)
+{
+    if(model->mesh == UINT32_MAX)
+    {
+        return;
+    }
+    geometry_heap.free(model->mesh);
+    model->mesh = UINT32_MAX;
+    model->bvh = MeshBVH();
+}
 
-    VkDescriptorPoolSize pool_size = {
-    .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-    .descriptorCount = static_cast<uint32_t>(scene->textures.size())
+void RendererLoader::immediateSubmit(Engine* engine, std::function<void(VkCommandBuffer)>&& record)
+{
+    VkFence fence;
+    VkFenceCreateInfo fence_create_info = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO
     };
-    VkDescriptorPoolCreateInfo desc_pool_create_info = {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-        .maxSets = 1,
-        .poolSizeCount = 1,
-        .pPoolSizes = &pool_size
+    vkCreateFence(engine->device, &fence_create_info, nullptr, &fence);
+    VkCommandBuffer cmd;
+    VkCommandBufferAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = command_pool,
+        .commandBufferCount = 1
     };
-    vkCreateDescriptorPool(engine->device, &desc_pool_create_info, nullptr, &descriptor_pool);
-
-    uint32_t var_desc_count = static_cast<uint32_t>(scene->textures.size());
-    VkDescriptorSetVariableDescriptorCountAllocateInfo var_desc_count_alloc_info = {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT,
-        .descriptorSetCount = 1,
-        .pDescriptorCounts = &var_desc_count
+    vkAllocateCommandBuffers(engine->device, &alloc_info, &cmd);
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
     };
-    VkDescriptorSetAllocateInfo texture_desc_set_alloc_info = {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-        .pNext = &var_desc_count_alloc_info,
-        .descriptorPool = descriptor_pool,
-        .descriptorSetCount = 1,
-        .pSetLayouts = &descriptor_set_layout_textures
+    vkBeginCommandBuffer(cmd, &begin_info);
+    record(cmd);
+    vkEndCommandBuffer(cmd);
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &cmd
     };
-    vkAllocateDescriptorSets(engine->device, &texture_desc_set_alloc_info, &descriptor_set_textures);
+    vkQueueSubmit(engine->queue, 1, &submit_info, fence);
+    vkWaitForFences(engine->device, 1, &fence, VK_TRUE, UINT64_MAX);
 
-    engine->main_deletion_queue.push([=]() 
-    {
-        vkDestroyDescriptorPool(engine->device, descriptor_pool, nullptr);
-        vkDestroyDescriptorSetLayout(engine->device, descriptor_set_layout_textures, nullptr);
-    });
+    vkDestroyFence(engine->device, fence, nullptr);
+    vkFreeCommandBuffers(engine->device, command_pool, 1, &cmd);
 }
 
-void RendererLoader::updateSceneDescriptors(Engine* engine, Scene* scene)
+static bool readFile(const std::string& filename, std::vector<uint8_t>& data)
 {
-    std::vector<VkDescriptorImageInfo> texture_descriptor_infos;
-    for(const auto& tex : scene->textures)
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if(!file)
     {
-        texture_descriptor_infos.push_back(tex->descriptor);
+        return false;
     }
-
-    VkWriteDescriptorSet write_desc_set = {
-        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-        .dstSet = descriptor_set_textures,
-        .dstBinding = 0,
-        .descriptorCount = static_cast<uint32_t>(texture_descriptor_infos.size()),
-        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-        .pImageInfo = texture_descriptor_infos.data()
-    };
-    vkUpdateDescriptorSets(engine->device, 1, &write_desc_set, 0, nullptr);
+    data.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(data.data()), data.size());
+    return file.good();
 }
 
 Texture* RendererLoader::loadTexture(Engine* engine, std::string filename)
 {
-    ktxTexture* ktx_texture = nullptr;
-    KTX_error_code result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktx_texture);
-    if(result != KTX_SUCCESS || ktx_texture == nullptr)
+    if(Texture* shared = texture_registry.findByPath(filename))
+    {
+        return shared;
+    }
+    std::vector<uint8_t> data;
+    if(!readFile(filename, data))
     {
         std::cout << "could not load texture" << std::endl;
         return NULL;
     }
+    TextureKey key = TextureRegistry::hashContents(data);
+    if(Texture* shared = texture_registry.findByHash(key, filename))
+    {
+        return shared;
+    }
+    ktxTexture* ktx_texture = ktx_loader.loadMemory(data, filename);
+    if(ktx_texture == nullptr)
+    {
+        std::cout << "could not load texture" << std::endl;
+        return NULL;
+    }
+    return texture_registry.insert(key, filename, createTexture(engine, ktx_texture, filename));
+}
+
+Texture* RendererLoader::loadTexture(Engine* engine, const AssetBundle& bundle, const BundleEntry& entry)
+{
+    //the same name the streamer later hands to ktx_loader.load for finer mips
+    std::string path = bundle.path + "#" + entry.name;
+    if(Texture* shared = texture_registry.findByPath(path))
+    {
+        return shared;
+    }
+    //cooked entries carry their content hash, only the check hash is computed over the mapping
+    TextureKey key = TextureRegistry::hashBundleEntry(entry, bundle.entryData(entry));
+    if(Texture* shared = texture_registry.findByHash(key, path))
+    {
+        return shared;
+    }
+    ktxTexture* ktx_texture = ktx_loader.loadMemory(bundle.entryData(entry), entry.size, path);
+    if(ktx_texture == nullptr)
+    {
+        std::cout << "could not load texture " << path << std::endl;
+        return NULL;
+    }
+    return texture_registry.insert(key, path, createTexture(engine, ktx_texture, path));
+}
+
+std::vector<Texture*> RendererLoader::loadTextures(Engine* engine, const std::vector<std::string>& filenames)
+{
+    std::vector<Texture*> textures(filenames.size(), nullptr);
+    std::vector<std::vector<uint8_t>> contents(filenames.size());
+    std::vector<TextureKey> keys(filenames.size());
+
+    //duplicates are resolved before transcoding so every unique file is only processed once
+    std::vector<size_t> unique;
+    std::unordered_map<TextureKey, size_t, TextureKeyHash> first_with_key;
+    for(size_t i = 0; i < filenames.size(); i++)
+    {
+        if((textures[i] = texture_registry.findByPath(filenames[i])))
+        {
+            continue;
+        }
+        if(!readFile(filenames[i], contents[i]))
+        {
+            std::cout << "could not load texture " << filenames[i] << std::endl;
+            continue;
+        }
+        keys[i] = TextureRegistry::hashContents(contents[i]);
+        if((textures[i] = texture_registry.findByHash(keys[i], filenames[i])))
+        {
+            continue;
+        }
+        if(first_with_key.emplace(keys[i], i).second)
+        {
+            unique.push_back(i);
+        }
+    }
+
+    std::vector<const std::vector<uint8_t>*> unique_contents;
+    std::vector<std::string> unique_names;
+    for(size_t i : unique)
+    {
+        unique_contents.push_back(&contents[i]);
+        unique_names.push_back(filenames[i]);
+    }
+    std::vector<ktxTexture*> ktx_textures = ktx_loader.loadMany(unique_contents, unique_names);
+    for(size_t j = 0; j < unique.size(); j++)
+    {
+        size_t i = unique[j];
+        if(ktx_textures[j] == nullptr)
+        {
+            std::cout << "could not load texture " << filenames[i] << std::endl;
+            continue;
+        }
+        textures[i] = texture_registry.insert(keys[i], filenames[i], createTexture(engine, ktx_textures[j], filenames[i]));
+    }
+
+    //duplicates inside this batch pick up the texture created above
+    for(size_t i = 0; i < filenames.size(); i++)
+    {
+        if(textures[i] == nullptr && !contents[i].empty())
+        {
+            textures[i] = texture_registry.findByHash(keys[i], filenames[i]);
+        }
+    }
+    return textures;
+}
+
+void RendererLoader::releaseTexture(Engine* engine, Texture* texture)
+{
+    std::unique_ptr<Texture> released = texture_registry.release(texture);
+    if(released)
+    {
+        texture_streamer.unregisterTexture(texture);
+        bindless_textures.free(released->texture_index);
+        engine->defragmenter.untrack(released->image.allocation);
+        engine->retirement_queue.retire(released->image);
+    }
+}
 
+Texture* RendererLoader::createTexture(Engine* engine, ktxTexture* ktx_texture, const std::string& filename, VkCommandBuffer cmd)
+{
     Texture* tex = new Texture();
+    tex->format = ktxTexture_GetVkFormat(ktx_texture);
+    tex->width = ktx_texture->baseWidth;
+    tex->height = ktx_texture->baseHeight;
+    tex->mip_levels = ktx_texture->numLevels;
+    tex->resident_mip = texture_streamer.tailMip(tex);
+    uint32_t resident_levels = tex->mip_levels - tex->resident_mip;
 
     VkImageCreateInfo texture_image_create_info = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
         .imageType = VK_IMAGE_TYPE_2D,
-        .format = ktxTexture_GetVkFormat(ktx_texture),
-        .extent = {
-            .width = ktx_texture->baseWidth,
-            .height = ktx_texture->baseHeight,
-            .depth = 1
-        },
-        .mipLevels = ktx_texture->numLevels,
+        .format = tex->format,
+        .extent = tex->mipExtent(tex->resident_mip),
+        .mipLevels = resident_levels,
         .arrayLayers = 1,
         .samples = VK_SAMPLE_COUNT_1_BIT,
         .tiling = VK_IMAGE_TILING_OPTIMAL,
-        .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
     };
     tex->image = ImageAlloc::create(engine->allocator, 
         engine->device, 
         texture_image_create_info, 
         0, 
-        VK_IMAGE_ASPECT_COLOR_BIT);
+        VK_IMAGE_ASPECT_COLOR_BIT,
+        MemoryCategory::Textures);
 
+    //only the tail goes into the staging buffer, mip offsets are rebased onto its start
+    //(ktx1 stores the largest level first, ktx2 the smallest)
+    ktx_size_t tail_offset = ktx_texture->dataSize;
+    ktx_size_t tail_end = 0;
+    for(uint32_t level = tex->resident_mip; level < tex->mip_levels; level++)
+    {
+        ktx_size_t level_offset;
+        ktxTexture_GetImageOffset(ktx_texture, level, 0, 0, &level_offset);
+        tail_offset = std::min(tail_offset, level_offset);
+        tail_end = std::max(tail_end, level_offset + ktxTexture_GetImageSize(ktx_texture, level));
+    }
+    ktx_size_t tail_size = tail_end - tail_offset;
     BufferAlloc staging = BufferAlloc::create(engine->allocator, 
         engine->device, 
-        ktx_texture->dataSize, 
+        tail_size, 
         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
-    memcpy(staging.allocation_info.pMappedData, ktx_texture->pData, ktx_texture->dataSize);
-
-    VkFence fence;
-    VkFenceCreateInfo fence_create_info = {
-        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO
-    };
-    vkCreateFence(engine->device, &fence_create_info, nullptr, &fence);
-    VkCommandBuffer cmd;
-    VkCommandBufferAllocateInfo alloc_info = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = command_pool,
-        .commandBufferCount = 1
-    };
-    vkAllocateCommandBuffers(engine->device, &alloc_info, &cmd);
-    VkCommandBufferBeginInfo begin_info = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
-    };
-    vkBeginCommandBuffer(cmd, &begin_info);
-    VkImageMemoryBarrier2 barrier_texture_image = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-        .srcStageMask = VK_PIPELINE_STAGE_2_NONE,
-        .srcAccessMask = VK_ACCESS_2_NONE,
-        .dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-        .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
-        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        .image = tex->image.handle,
-        .subresourceRange = {
-            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-            .levelCount = ktx_texture->numLevels,
-            .layerCount = 1
-        }
-    };
-    VkDependencyInfo dep_info = {
-        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-        .imageMemoryBarrierCount = 1,
-        .pImageMemoryBarriers = &barrier_texture_image
-    };
-    vkCmdPipelineBarrier2(cmd, &dep_info);
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        MemoryCategory::Staging);
+    memcpy(staging.allocation_info.pMappedData, ktx_texture->pData + tail_offset, tail_size);
 
     std::vector<VkBufferImageCopy> copy_regions;
-    for(auto j = 0; j < ktx_texture->numLevels; j++)
+    for(uint32_t j = tex->resident_mip; j < tex->mip_levels; j++)
     {
         ktx_size_t mipOffset;
         ktxTexture_GetImageOffset(ktx_texture, j, 0, 0, &mipOffset);
         copy_regions.push_back({
-            .bufferOffset = mipOffset,
+            .bufferOffset = mipOffset - tail_offset,
             .imageSubresource = {
                 .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                .mipLevel = (uint32_t)j,
+                .mipLevel = j - tex->resident_mip,
                 .layerCount = 1
             },
-            .imageExtent = {
-                .width = ktx_texture->baseWidth >> j,
-                .height = ktx_texture->baseHeight >> j,
-                .depth = 1
-            },
+            .imageExtent = tex->mipExtent(j),
         });
     }
-    vkCmdCopyBufferToImage(cmd, staging.handle, tex->image.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copy_regions.size()), copy_regions.data());
-    VkImageMemoryBarrier2 barrier_texture_read = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-        .srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
-        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-        .dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
-        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        .newLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
-        .image = tex->image.handle,
-        .subresourceRange = {
-            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-            .levelCount = ktx_texture->numLevels,
-            .layerCount = 1
-        }
-    };
-    dep_info.pImageMemoryBarriers = &barrier_texture_read;
-    vkCmdPipelineBarrier2(cmd, &dep_info);
-    vkEndCommandBuffer(cmd);
-    VkSubmitInfo submit_info = {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .commandBufferCount = 1,
-        .pCommandBuffers = &cmd
-    };
-    vkQueueSubmit(engine->queue, 1, &submit_info, fence);
-    vkWaitForFences(engine->device, 1, &fence, VK_TRUE, UINT64_MAX);
 
-    vkDestroyFence(engine->device, fence, nullptr);
-    vkFreeCommandBuffers(engine->device, command_pool, 1, &cmd);
-    staging.destroy();
+    auto record_upload = [&](VkCommandBuffer cmd)
+    {
+        VkImageMemoryBarrier2 barrier_texture_image = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+            .srcStageMask = VK_PIPELINE_STAGE_2_NONE,
+            .srcAccessMask = VK_ACCESS_2_NONE,
+            .dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+            .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .image = tex->image.handle,
+            .subresourceRange = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .levelCount = resident_levels,
+                .layerCount = 1
+            }
+        };
+        VkDependencyInfo dep_info = {
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .imageMemoryBarrierCount = 1,
+            .pImageMemoryBarriers = &barrier_texture_image
+        };
+        vkCmdPipelineBarrier2(cmd, &dep_info);
+
+        vkCmdCopyBufferToImage(cmd, staging.handle, tex->image.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copy_regions.size()), copy_regions.data());
+        VkImageMemoryBarrier2 barrier_texture_read = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+            .srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .newLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
+            .image = tex->image.handle,
+            .subresourceRange = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .levelCount = resident_levels,
+                .layerCount = 1
+            }
+        };
+        dep_info.pImageMemoryBarriers = &barrier_texture_read;
+        vkCmdPipelineBarrier2(cmd, &dep_info);
+    };
+    if(cmd != VK_NULL_HANDLE)
+    {
+        //read by the frame being recorded
+        record_upload(cmd);
+        engine->retirement_queue.retire(staging);
+    }
+    else
+    {
+        immediateSubmit(engine, record_upload);
+        staging.destroy();
+    }
 
     tex->sampler = default_sampler;
     tex->descriptor = {
@@ -333,16 +439,16 @@ Texture* RendererLoader::loadTexture(Engine* engine, std::string filename)
         .imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL
     };
 
+    tex->texture_index = bindless_textures.allocate(tex->descriptor);
+    bindless_textures.trackTexture(engine, tex, texture_image_create_info);
+
     ktxTexture_Destroy(ktx_texture);
-    engine->main_deletion_queue.push([=]()
-    {
-        tex->destroy(engine->device);
-    });
+    texture_streamer.registerTexture(tex, filename);
 
     return tex;
 }
 
-void RendererLoader::loadShaders(Engine* engine, const char* shader_file)
+void RendererLoader::loadShaders(Engine* engine, const char* shader_file, const char* meshlet_shader_file)
 {
     slang::createGlobalSession(slang_global_session.writeRef());
     auto slang_targets = std::to_array<slang::TargetDesc>({{
@@ -366,9 +472,25 @@ void RendererLoader::loadShaders(Engine* engine, const char* shader_file)
         .pCode = (uint32_t*)spirv->getBufferPointer()
     };
     vkCreateShaderModule(engine->device, &shader_module_create_info, nullptr, &shader_module);    
+    light_clusters.setup(engine, shader_module);
+
+    //separate module so devices without mesh shaders never see the task and mesh entry points
+    if(engine->mesh_shader_supported)
+    {
+        meshlet_slang_module = slang_session->loadModuleFromSource("meshlet_shader", meshlet_shader_file, nullptr, nullptr);
+        meshlet_slang_module->getTargetCode(0, meshlet_spirv.writeRef());
+        VkShaderModuleCreateInfo meshlet_module_create_info = {
+            .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+            .codeSize = meshlet_spirv->getBufferSize(),
+            .pCode = (uint32_t*)meshlet_spirv->getBufferPointer()
+        };
+        vkCreateShaderModule(engine->device, &meshlet_module_create_info, nullptr, &meshlet_shader_module);
+    }
 
     engine->main_deletion_queue.push([=]()
     {
+        light_clusters.destroy();
         vkDestroyShaderModule(engine->device, shader_module, nullptr);
+        vkDestroyShaderModule(engine->device, meshlet_shader_module, nullptr);
     });
 }
\ No newline at end of file
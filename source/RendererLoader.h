@@ -7,6 +7,7 @@
 #include <array>
 #include <string>
 #include <fstream>
+#include <functional>
 
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_vulkan.h>
@@ -29,80 +30,176 @@
 #include "ImageAlloc.h"
 #include "Texture.h"
 #include "Model.h"
+#include "TextureStreamer.h"
+#include "KtxLoader.h"
+#include "TextureRegistry.h"
+#include "BindlessTable.h"
+#include "FrameAllocator.h"
+#include "GeometryHeap.h"
+#include "LightClusters.h"
+#include "DynamicResolution.h"
+#include "FrameStats.h"
+#include "RenderGraph.h"
+#include "AssetBundle.h"
+#include "AssetLoader.h"
+#include "SceneStreamer.h"
 
 class Scene;
 
+//matches SceneData in shader.slang, addresses first after the vectors to keep both layouts packed
 struct SceneData
 {
     glm::mat4 projection;
     glm::mat4 view;
     glm::vec4 light_pos;
+    VkDeviceAddress lights;
+    VkDeviceAddress cluster_ranges;
+    VkDeviceAddress cluster_indices;
     uint32_t selected_instance;
-    float pad[3];
+    uint32_t light_count;
+    glm::vec2 screen_size;
+    float z_near;
+    float z_far;
+    uint32_t cluster_grid_x;
+    uint32_t cluster_grid_y;
+    uint32_t cluster_grid_z;
+    //nonzero to let task shaders cull meshlets that face away from the camera
+    uint32_t cone_culling;
 };
 
 
-constexpr uint32_t max_frames_in_flight = 2;
+constexpr uint32_t max_bindless_textures = 16384;
 
 
 class RendererLoader
 {
 public:
-    std::array<BufferAlloc, max_frames_in_flight> shader_data_buffers;
-
-    std::array<VkFence, max_frames_in_flight> fences;
+    //per-frame resources cover max_frames_in_flight slots so engine->frame_scheduler can change the count at runtime
     std::array<VkSemaphore, max_frames_in_flight> present_semaphores;
-    std::vector<VkSemaphore> render_semaphores;
 
     std::array<VkCommandBuffer, max_frames_in_flight> command_buffers;
 
-    std::array<VkDeviceAddress, max_frames_in_flight> shader_data_addresses;
+    //transient per-frame shader data, SceneData and anything else read through a device address
+    FrameAllocator frame_allocator;
+
+    //vertex and index data of every loaded model
+    GeometryHeap geometry_heap;
+
+    //point lights binned per froxel, set up with the shaders
+    LightClusters light_clusters;
+
+    //render scale picked from measured gpu frame time
+    DynamicResolution dynamic_resolution;
 
+    //gpu pipeline statistics per pass and cpu draw counters
+    FrameStats frame_stats;
+
+    //frame passes, their barriers and the transient attachments
+    RenderGraph render_graph;
 
     VkCommandPool command_pool;
 
     VkSampler default_sampler;
 
-    VkDescriptorPool descriptor_pool;
-    VkDescriptorSetLayout descriptor_set_layout_textures;
-    VkDescriptorSet descriptor_set_textures;
+    BindlessTable bindless_textures;
 
     Slang::ComPtr<slang::IGlobalSession> slang_global_session;
     Slang::ComPtr<slang::ISession> slang_session;
     Slang::ComPtr<slang::IModule> slang_module;
     Slang::ComPtr<ISlangBlob> spirv;
     VkShaderModule shader_module;
+    //task and mesh entry points next to the shared fragment shader, only compiled when the device has mesh shaders
+    Slang::ComPtr<slang::IModule> meshlet_slang_module;
+    Slang::ComPtr<ISlangBlob> meshlet_spirv;
+    VkShaderModule meshlet_shader_module = VK_NULL_HANDLE;
+
+    KtxLoader ktx_loader;
+    TextureStreamer texture_streamer;
+    TextureRegistry texture_registry;
+
+    //cooked bundles stay mapped while the loader lives, streamed mips are read straight from the mapping
+    std::vector<std::unique_ptr<AssetBundle>> bundles;
+
+    //background loads that render with placeholders until they are swapped in
+    AssetLoader assets;
 
+    //scene files, their entities are added a chunk per frame
+    SceneStreamer scene_streamer;
 
 
     RendererLoader(Engine* engine, Output* output)
     {
-        setupShaderDataBuffers(engine);
-        setupSynchronizationObjects(engine, output);
+        frame_allocator.setup(engine);
+        dynamic_resolution.setup(engine);
+        frame_stats.setup(engine);
+        render_graph.setup(engine);
+        engine->main_deletion_queue.push([=]()
+        {
+            render_graph.logStats();
+            render_graph.destroy();
+            frame_stats.destroy();
+            dynamic_resolution.destroy();
+            frame_allocator.destroy();
+        });
+        setupSynchronizationObjects(engine);
         setupCommandBuffers(engine);
         setupSamplers(engine);
+        bindless_textures.setup(engine, max_bindless_textures);
+        geometry_heap.setup(engine);
+        ktx_loader.setup(engine);
+        texture_streamer.start(engine, &ktx_loader);
+        engine->main_deletion_queue.push([=]()
+        {
+            texture_registry.logStats();
+            texture_registry.destroy(engine->device);
+            geometry_heap.logStats();
+            geometry_heap.destroy();
+        });
+        assets.start(engine, this);
+        scene_streamer.start(this);
     }
 
-    void setupShaderDataBuffers(Engine* engine);
-
-    void setupSynchronizationObjects(Engine* engine, Output* output);
+    void setupSynchronizationObjects(Engine* engine);
 
     void setupCommandBuffers(Engine* engine);
 
     void setupSamplers(Engine* engine);
 
-    //call from main to load models
+    void uploadMesh(Engine* engine, Model* model, const Vertex* vertices, uint32_t vertex_count, const uint16_t* indices, uint32_t index_count);
+
+    //records commands through record, submits them and waits for completion
+    void immediateSubmit(Engine* engine, std::function<void(VkCommandBuffer)>&& record);
+
+    //call from main to load models, the geometry goes into geometry_heap
     void loadModel(Engine* engine, Model* model);
 
-    //call from main to setup descriptors after entities loaded
-    void setupDescriptors(Engine* engine, Scene* scene);
+    //maps a bundle written by asset_cooker, nullptr when it is missing or was cooked by another version
+    AssetBundle* openBundle(const std::string& path);
+
+    //fills model with a cooked mesh and its texture, the geometry is uploaded from the mapping without a copy
+    //false when the bundle has no mesh of that name
+    bool loadModel(Engine* engine, Model* model, const AssetBundle& bundle, const std::string& name);
 
-    //call from main to update descriptors after entities loaded
-    void updateSceneDescriptors(Engine* engine, Scene* scene);
+    //texture entry of a bundle, shared through texture_registry like file textures
+    Texture* loadTexture(Engine* engine, const AssetBundle& bundle, const BundleEntry& entry);
 
-    //call from main to load textures
+    //releases the model's geometry once frames in flight are done with it
+    void unloadModel(Model* model);
+
+    //call from main to load textures, only the mip tail is uploaded and finer mips are streamed by texture_streamer
+    //files with the same contents share one texture owned by texture_registry
     Texture* loadTexture(Engine* engine, std::string filename);
 
-    //call from main to load shader file
-    void loadShaders(Engine* engine, const char* shader_file);
+    //call from main to load several textures, files are read and transcoded on worker threads
+    std::vector<Texture*> loadTextures(Engine* engine, const std::vector<std::string>& filenames);
+
+    //uploads the mip tail of an opened ktx texture and takes ownership of it
+    //the upload is recorded into cmd when given, otherwise submitted and waited for
+    Texture* createTexture(Engine* engine, ktxTexture* ktx_texture, const std::string& filename, VkCommandBuffer cmd = VK_NULL_HANDLE);
+
+    //drops one reference taken by loadTexture, the last one retires the gpu texture
+    void releaseTexture(Engine* engine, Texture* texture);
+
+    //call from main to load shader file, meshlet_shader_file is skipped when the device has no mesh shaders
+    void loadShaders(Engine* engine, const char* shader_file, const char* meshlet_shader_file);
 };
\ No newline at end of file
@@ -0,0 +1,150 @@
+#include "RetirementQueue.h"
+
+void RetirementQueue::setup(VkDevice device, VmaAllocator allocator)
+{
+    this->device = device;
+    this->allocator = allocator;
+}
+
+void RetirementQueue::destroy(const RetiredHandle& retired)
+{
+    switch(retired.type)
+    {
+        case RetiredType::Buffer:
+            vmaDestroyBuffer(allocator, (VkBuffer)retired.handle, retired.allocation);
+            MemoryBudget::recordFree(retired.category, retired.size);
+            break;
+        case RetiredType::Image:
+            if(retired.view != 0)
+            {
+                vkDestroyImageView(device, (VkImageView)retired.view, nullptr);
+            }
+            vmaDestroyImage(allocator, (VkImage)retired.handle, retired.allocation);
+            MemoryBudget::recordFree(retired.category, retired.size);
+            break;
+        case RetiredType::ImageView:
+            vkDestroyImageView(device, (VkImageView)retired.handle, nullptr);
+            break;
+        case RetiredType::Swapchain:
+            vkDestroySwapchainKHR(device, (VkSwapchainKHR)retired.handle, nullptr);
+            break;
+        case RetiredType::Semaphore:
+            vkDestroySemaphore(device, (VkSemaphore)retired.handle, nullptr);
+            break;
+        case RetiredType::Fence:
+            vkDestroyFence(device, (VkFence)retired.handle, nullptr);
+            break;
+        case RetiredType::Memory:
+            vmaFreeMemory(allocator, retired.allocation);
+            MemoryBudget::recordFree(retired.category, retired.size);
+            break;
+    }
+}
+
+void RetirementQueue::beginFrame(uint64_t frame_value, uint64_t completed_value)
+{
+    this->frame_value = frame_value;
+    size_t count = 0;
+    while(count < retired.size() && retired[count].frame_value <= completed_value)
+    {
+        destroy(retired[count]);
+        count++;
+    }
+    retired.erase(retired.begin(), retired.begin() + count);
+}
+
+void RetirementQueue::push(RetiredHandle&& handle)
+{
+    handle.frame_value = frame_value;
+    retired.push_back(handle);
+}
+
+void RetirementQueue::retire(BufferAlloc& buffer)
+{
+    if(buffer.handle == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    push({
+        .type = RetiredType::Buffer,
+        .category = buffer.category,
+        .handle = (uint64_t)buffer.handle,
+        .allocation = buffer.allocation,
+        .size = buffer.size
+    });
+    buffer.handle = VK_NULL_HANDLE;
+}
+
+void RetirementQueue::retire(ImageAlloc& image)
+{
+    if(image.handle == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    push({
+        .type = RetiredType::Image,
+        .category = image.category,
+        .handle = (uint64_t)image.handle,
+        .view = (uint64_t)image.view,
+        .allocation = image.allocation,
+        .size = image.size
+    });
+    image.handle = VK_NULL_HANDLE;
+    image.view = VK_NULL_HANDLE;
+}
+
+void RetirementQueue::retireImageView(VkImageView view)
+{
+    push({
+        .type = RetiredType::ImageView,
+        .handle = (uint64_t)view
+    });
+}
+
+void RetirementQueue::retireSwapchain(VkSwapchainKHR swapchain)
+{
+    push({
+        .type = RetiredType::Swapchain,
+        .handle = (uint64_t)swapchain
+    });
+}
+
+void RetirementQueue::retireSemaphore(VkSemaphore semaphore)
+{
+    push({
+        .type = RetiredType::Semaphore,
+        .handle = (uint64_t)semaphore
+    });
+}
+
+void RetirementQueue::retireFence(VkFence fence)
+{
+    push({
+        .type = RetiredType::Fence,
+        .handle = (uint64_t)fence
+    });
+}
+
+void RetirementQueue::retireMemory(VmaAllocation allocation, MemoryCategory category, VkDeviceSize size)
+{
+    push({
+        .type = RetiredType::Memory,
+        .category = category,
+        .allocation = allocation,
+        .size = size
+    });
+}
+
+void RetirementQueue::flushAll()
+{
+    for(const auto& handle : retired)
+    {
+        destroy(handle);
+    }
+    retired.clear();
+}
+
+size_t RetirementQueue::pendingCount() const
+{
+    return retired.size();
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <volk/volk.h>
+#include <vma/vk_mem_alloc.h>
+
+#include <vector>
+
+#include "BufferAlloc.h"
+#include "ImageAlloc.h"
+#include "MemoryBudget.h"
+
+enum class RetiredType : uint32_t
+{
+    Buffer,
+    Image,
+    ImageView,
+    Swapchain,
+    Semaphore,
+    Fence,
+    //memory allocated without a resource, images bound into it are retired separately
+    Memory
+};
+
+//plain handle record, destroying it needs no captured state
+struct RetiredHandle
+{
+    RetiredType type;
+    MemoryCategory category;
+    uint64_t handle;
+    //image view of an ImageAlloc, destroyed together with the image
+    uint64_t view;
+    VmaAllocation allocation;
+    VkDeviceSize size;
+    //frame value that last used the handle
+    uint64_t frame_value;
+};
+
+//resources dropped while frames are in flight are tagged with the frame value being recorded
+//and destroyed once the frame timeline has reached it
+//the queue keeps its capacity, so steady state retirement does not allocate
+class RetirementQueue
+{
+    //ordered by frame_value since values only grow
+    std::vector<RetiredHandle> retired;
+    uint64_t frame_value = 0;
+    VkDevice device = VK_NULL_HANDLE;
+    VmaAllocator allocator = VK_NULL_HANDLE;
+
+    void destroy(const RetiredHandle& retired);
+    void push(RetiredHandle&& handle);
+
+public:
+    void setup(VkDevice device, VmaAllocator allocator);
+
+    //call once per frame with the value being recorded and the last completed one
+    //destroys everything whose frame has completed
+    void beginFrame(uint64_t frame_value, uint64_t completed_value);
+
+    //the passed objects are reset so later destroy() calls on them are no-ops
+    void retire(BufferAlloc& buffer);
+    void retire(ImageAlloc& image);
+    void retireImageView(VkImageView view);
+    void retireSwapchain(VkSwapchainKHR swapchain);
+    void retireSemaphore(VkSemaphore semaphore);
+    void retireFence(VkFence fence);
+    void retireMemory(VmaAllocation allocation, MemoryCategory category, VkDeviceSize size);
+
+    //call with the device idle, destroys everything still queued
+    void flushAll();
+
+    size_t pendingCount() const;
+};
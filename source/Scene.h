@@ -2,6 +2,7 @@
 #include<vector>
 #include <memory>
 #include "Model.h"
+#include "SceneBVH.h"
 
 struct Entity
 {
@@ -14,16 +15,34 @@ struct Camera
     glm::vec3 pos;
     glm::mat4 view;
     glm::mat4 proj;
+    float z_near = 0.1f;
+    float z_far = 32.0f;
+};
+
+//laid out to match PointLight in shader.slang, position is in view space once uploaded
+struct PointLight
+{
+    glm::vec3 position;
+    float radius;
+    glm::vec3 color;
+    float intensity;
 };
 
 class Scene
 {
 public:
     std::vector<std::unique_ptr<Model>> models;
-    std::vector<std::unique_ptr<Texture>> textures;
+    //owned by RendererLoader::texture_registry, shared textures appear once
+    std::vector<Texture*> textures;
     std::vector<Entity> entities;
     Camera camera;
     glm::vec4 light_pos;
+    //binned into clusters every frame, only lights touching a fragment's cluster shade it
+    std::vector<PointLight> lights;
+    //entity bounds for picking and spatial queries, brought up to date by bvh.update
+    SceneBVH bvh;
+    //entities whose transform changed since the last bvh.update
+    std::vector<uint32_t> moved_entities;
 
     void addEntity(Model* m, glm::vec3 pos)
     {
@@ -32,4 +51,10 @@ public:
         e.transform = glm::translate(glm::mat4(1.0f), pos);
         entities.push_back(e);
     }
+
+    void moveEntity(uint32_t index, const glm::mat4& transform)
+    {
+        entities[index].transform = transform;
+        moved_entities.push_back(index);
+    }
 };
\ No newline at end of file
@@ -0,0 +1,453 @@
+#include "SceneBVH.h"
+#include "Scene.h"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+
+constexpr uint32_t scene_bin_count = 16;
+//below it binned splits may keep peeling single entities off, past it ranges are split at the median
+constexpr uint32_t scene_sah_depth = 48;
+
+static bool sameBounds(const Aabb& a, const Aabb& b)
+{
+    return a.min == b.min && a.max == b.max;
+}
+
+static Aabb merged(const Aabb& a, const Aabb& b)
+{
+    Aabb bounds = a;
+    bounds.grow(b);
+    return bounds;
+}
+
+Aabb SceneBVH::entityBounds(const Scene& scene, uint32_t entity)
+{
+    const Entity& e = scene.entities[entity];
+    Aabb local = {
+        .min = e.model ? e.model->bounds_min : glm::vec3(0.0f),
+        .max = e.model ? e.model->bounds_max : glm::vec3(0.0f)
+    };
+    if(!local.valid())
+    {
+        //nothing to hit yet, a point keeps the entity in the tree for box and nearest queries
+        local = {glm::vec3(0.0f), glm::vec3(0.0f)};
+    }
+    return local.transformed(e.transform);
+}
+
+uint32_t SceneBVH::allocateNode()
+{
+    nodes.push_back({});
+    return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+uint32_t SceneBVH::buildRange(std::vector<BuildItem>& items, uint32_t begin, uint32_t end, uint32_t depth)
+{
+    if(end - begin == 1)
+    {
+        return items[begin].leaf;
+    }
+    Aabb centroid_bounds;
+    for(uint32_t i = begin; i < end; i++)
+    {
+        centroid_bounds.grow(items[i].centroid);
+    }
+    glm::vec3 extent = centroid_bounds.max - centroid_bounds.min;
+    uint32_t axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+    uint32_t middle = begin + (end - begin) / 2;
+    if(extent[axis] > 0.0f && depth < scene_sah_depth)
+    {
+        //binned along the longest centroid axis, entities are numerous enough that the other axes rarely win
+        std::array<Aabb, scene_bin_count> bins;
+        std::array<uint32_t, scene_bin_count> bin_counts = {};
+        float scale = scene_bin_count / extent[axis];
+        auto binOf = [&](const BuildItem& item)
+        {
+            return std::min(scene_bin_count - 1, static_cast<uint32_t>((item.centroid[axis] - centroid_bounds.min[axis]) * scale));
+        };
+        for(uint32_t i = begin; i < end; i++)
+        {
+            uint32_t bin = binOf(items[i]);
+            bins[bin].grow(items[i].bounds);
+            bin_counts[bin]++;
+        }
+        std::array<float, scene_bin_count - 1> left_costs;
+        Aabb left;
+        uint32_t left_count = 0;
+        for(uint32_t plane = 0; plane < scene_bin_count - 1; plane++)
+        {
+            left.grow(bins[plane]);
+            left_count += bin_counts[plane];
+            left_costs[plane] = left.halfArea() * left_count;
+        }
+        float best_cost = std::numeric_limits<float>::max();
+        uint32_t best_plane = 0;
+        Aabb right;
+        uint32_t right_count = 0;
+        for(uint32_t plane = scene_bin_count - 1; plane > 0; plane--)
+        {
+            right.grow(bins[plane]);
+            right_count += bin_counts[plane];
+            float cost = left_costs[plane - 1] + right.halfArea() * right_count;
+            if(right_count > 0 && right_count < end - begin && cost < best_cost)
+            {
+                best_cost = cost;
+                best_plane = plane;
+            }
+        }
+        if(best_plane > 0)
+        {
+            middle = static_cast<uint32_t>(std::partition(items.begin() + begin, items.begin() + end, [&](const BuildItem& item)
+            {
+                return binOf(item) < best_plane;
+            }) - items.begin());
+        }
+    }
+    else
+    {
+        std::nth_element(items.begin() + begin, items.begin() + middle, items.begin() + end, [&](const BuildItem& a, const BuildItem& b)
+        {
+            return a.centroid[axis] < b.centroid[axis];
+        });
+    }
+    if(middle == begin || middle == end)
+    {
+        middle = begin + (end - begin) / 2;
+    }
+
+    uint32_t left_child = buildRange(items, begin, middle, depth + 1);
+    uint32_t right_child = buildRange(items, middle, end, depth + 1);
+    uint32_t node = allocateNode();
+    nodes[node] = {
+        .bounds = merged(nodes[left_child].bounds, nodes[right_child].bounds),
+        .parent = UINT32_MAX,
+        .left = left_child,
+        .right = right_child,
+        .entity = UINT32_MAX
+    };
+    nodes[left_child].parent = node;
+    nodes[right_child].parent = node;
+    inner_area += nodes[node].bounds.halfArea();
+    return node;
+}
+
+void SceneBVH::rebuild(const Scene& scene)
+{
+    nodes.clear();
+    root = UINT32_MAX;
+    inner_area = 0.0f;
+    model_bounds.clear();
+    for(const auto& model : scene.models)
+    {
+        model_bounds[model.get()] = {model->bounds_min, model->bounds_max};
+    }
+    uint32_t count = static_cast<uint32_t>(scene.entities.size());
+    entity_leaves.resize(count);
+    nodes.reserve(count * 2);
+    std::vector<BuildItem> items(count);
+    for(uint32_t i = 0; i < count; i++)
+    {
+        Aabb bounds = entityBounds(scene, i);
+        nodes.push_back({
+            .bounds = bounds,
+            .parent = UINT32_MAX,
+            .left = UINT32_MAX,
+            .right = UINT32_MAX,
+            .entity = i
+        });
+        entity_leaves[i] = i;
+        items[i] = {bounds, (bounds.min + bounds.max) * 0.5f, i};
+    }
+    if(count > 0)
+    {
+        root = buildRange(items, 0, count, 0);
+    }
+    built_cost = cost();
+    rebuild_count++;
+}
+
+void SceneBVH::setBounds(uint32_t node, const Aabb& bounds)
+{
+    if(nodes[node].left != UINT32_MAX)
+    {
+        inner_area += bounds.halfArea() - nodes[node].bounds.halfArea();
+    }
+    nodes[node].bounds = bounds;
+}
+
+void SceneBVH::refitLeaf(uint32_t leaf, const Aabb& bounds)
+{
+    nodes[leaf].bounds = bounds;
+    refit_count++;
+    //ancestors stop changing as soon as one of them keeps its bounds
+    for(uint32_t node = nodes[leaf].parent; node != UINT32_MAX; node = nodes[node].parent)
+    {
+        Aabb refit = merged(nodes[nodes[node].left].bounds, nodes[nodes[node].right].bounds);
+        if(sameBounds(refit, nodes[node].bounds))
+        {
+            break;
+        }
+        setBounds(node, refit);
+    }
+}
+
+void SceneBVH::insertLeaf(uint32_t leaf)
+{
+    if(root == UINT32_MAX)
+    {
+        root = leaf;
+        nodes[leaf].parent = UINT32_MAX;
+        return;
+    }
+    //walk down to the sibling that grows the tree least, every ancestor pays for its enlargement
+    Aabb leaf_bounds = nodes[leaf].bounds;
+    uint32_t sibling = root;
+    while(nodes[sibling].left != UINT32_MAX)
+    {
+        const Node& node = nodes[sibling];
+        float combined = merged(node.bounds, leaf_bounds).halfArea();
+        float here = 2.0f * combined;
+        float inherited = 2.0f * (combined - node.bounds.halfArea());
+        auto descend = [&](uint32_t child)
+        {
+            float grown = merged(nodes[child].bounds, leaf_bounds).halfArea();
+            return nodes[child].left == UINT32_MAX ? grown + inherited : grown - nodes[child].bounds.halfArea() + inherited;
+        };
+        float left_cost = descend(node.left);
+        float right_cost = descend(node.right);
+        if(here < left_cost && here < right_cost)
+        {
+            break;
+        }
+        sibling = left_cost < right_cost ? node.left : node.right;
+    }
+
+    uint32_t old_parent = nodes[sibling].parent;
+    uint32_t parent = allocateNode();
+    nodes[parent] = {
+        .bounds = merged(nodes[sibling].bounds, leaf_bounds),
+        .parent = old_parent,
+        .left = sibling,
+        .right = leaf,
+        .entity = UINT32_MAX
+    };
+    inner_area += nodes[parent].bounds.halfArea();
+    nodes[sibling].parent = parent;
+    nodes[leaf].parent = parent;
+    if(old_parent == UINT32_MAX)
+    {
+        root = parent;
+        return;
+    }
+    if(nodes[old_parent].left == sibling)
+    {
+        nodes[old_parent].left = parent;
+    }
+    else
+    {
+        nodes[old_parent].right = parent;
+    }
+    for(uint32_t node = old_parent; node != UINT32_MAX; node = nodes[node].parent)
+    {
+        setBounds(node, merged(nodes[nodes[node].left].bounds, nodes[nodes[node].right].bounds));
+    }
+}
+
+void SceneBVH::update(Scene& scene)
+{
+    uint32_t count = static_cast<uint32_t>(scene.entities.size());
+    //a bulk add outnumbering the tree is cheaper to build from scratch than to insert leaf by leaf
+    if((root == UINT32_MAX && count > 0) || count < entity_leaves.size() || count - entity_leaves.size() > entity_leaves.size())
+    {
+        rebuild(scene);
+        scene.moved_entities.clear();
+        return;
+    }
+    for(uint32_t i = static_cast<uint32_t>(entity_leaves.size()); i < count; i++)
+    {
+        uint32_t leaf = allocateNode();
+        nodes[leaf] = {
+            .bounds = entityBounds(scene, i),
+            .parent = UINT32_MAX,
+            .left = UINT32_MAX,
+            .right = UINT32_MAX,
+            .entity = i
+        };
+        entity_leaves.push_back(leaf);
+        insertLeaf(leaf);
+    }
+
+    //models are few, entities are walked only when a load actually changed some bounds
+    std::vector<const Model*> changed_models;
+    for(const auto& model : scene.models)
+    {
+        Aabb bounds = {model->bounds_min, model->bounds_max};
+        auto [it, inserted] = model_bounds.try_emplace(model.get(), bounds);
+        if(!inserted && !sameBounds(it->second, bounds))
+        {
+            it->second = bounds;
+            changed_models.push_back(model.get());
+        }
+    }
+    if(!changed_models.empty())
+    {
+        for(uint32_t i = 0; i < count; i++)
+        {
+            if(std::find(changed_models.begin(), changed_models.end(), scene.entities[i].model) != changed_models.end())
+            {
+                refitLeaf(entity_leaves[i], entityBounds(scene, i));
+            }
+        }
+    }
+    for(uint32_t i : scene.moved_entities)
+    {
+        if(i < count)
+        {
+            refitLeaf(entity_leaves[i], entityBounds(scene, i));
+        }
+    }
+    scene.moved_entities.clear();
+
+    if(cost() > std::max(built_cost, 1.0f) * rebuild_ratio)
+    {
+        rebuild(scene);
+    }
+}
+
+PickHit SceneBVH::raycast(const Scene& scene, glm::vec3 origin, glm::vec3 direction) const
+{
+    PickHit best;
+    Ray ray(origin, direction);
+    float t_enter;
+    if(root == UINT32_MAX || !intersectAabb(ray, nodes[root].bounds, best.t, t_enter))
+    {
+        return best;
+    }
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    stack.push_back(root);
+    while(!stack.empty())
+    {
+        const Node& node = nodes[stack.back()];
+        stack.pop_back();
+        if(node.left == UINT32_MAX)
+        {
+            const Entity& e = scene.entities[node.entity];
+            if(!e.model || e.model->mesh == UINT32_MAX)
+            {
+                continue;
+            }
+            //into model space, the direction is not renormalized so t stays comparable across entities
+            glm::mat4 inverse = glm::inverse(e.transform);
+            Ray local(glm::vec3(inverse * glm::vec4(origin, 1.0f)), glm::mat3(inverse) * direction);
+            float t = best.t;
+            bool hit = false;
+            if(e.model->bvh.empty())
+            {
+                Aabb box = {e.model->bounds_min, e.model->bounds_max};
+                hit = box.valid() && intersectAabb(local, box, t, t);
+            }
+            else
+            {
+                hit = e.model->bvh.raycast(local, t);
+            }
+            if(hit)
+            {
+                best = {node.entity, t};
+            }
+            continue;
+        }
+        //nearer child on top so its hit prunes the farther one
+        float t_left, t_right;
+        bool left = intersectAabb(ray, nodes[node.left].bounds, best.t, t_left);
+        bool right = intersectAabb(ray, nodes[node.right].bounds, best.t, t_right);
+        if(left && right)
+        {
+            bool left_first = t_left <= t_right;
+            stack.push_back(left_first ? node.right : node.left);
+            stack.push_back(left_first ? node.left : node.right);
+        }
+        else if(left || right)
+        {
+            stack.push_back(left ? node.left : node.right);
+        }
+    }
+    return best;
+}
+
+void SceneBVH::queryBox(const Aabb& box, std::vector<uint32_t>& entities) const
+{
+    if(root == UINT32_MAX)
+    {
+        return;
+    }
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    stack.push_back(root);
+    while(!stack.empty())
+    {
+        const Node& node = nodes[stack.back()];
+        stack.pop_back();
+        if(!node.bounds.overlaps(box))
+        {
+            continue;
+        }
+        if(node.left == UINT32_MAX)
+        {
+            entities.push_back(node.entity);
+            continue;
+        }
+        stack.push_back(node.left);
+        stack.push_back(node.right);
+    }
+}
+
+uint32_t SceneBVH::nearest(glm::vec3 point, float max_distance) const
+{
+    uint32_t best = UINT32_MAX;
+    float best_distance = max_distance * max_distance;
+    if(root == UINT32_MAX)
+    {
+        return best;
+    }
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    stack.push_back(root);
+    while(!stack.empty())
+    {
+        const Node& node = nodes[stack.back()];
+        stack.pop_back();
+        float distance = node.bounds.distanceSquared(point);
+        if(distance > best_distance)
+        {
+            continue;
+        }
+        if(node.left == UINT32_MAX)
+        {
+            best = node.entity;
+            best_distance = distance;
+            continue;
+        }
+        bool left_first = nodes[node.left].bounds.distanceSquared(point) <= nodes[node.right].bounds.distanceSquared(point);
+        stack.push_back(left_first ? node.right : node.left);
+        stack.push_back(left_first ? node.left : node.right);
+    }
+    return best;
+}
+
+float SceneBVH::cost() const
+{
+    if(root == UINT32_MAX || nodes[root].bounds.halfArea() <= 0.0f)
+    {
+        return 0.0f;
+    }
+    return inner_area / nodes[root].bounds.halfArea();
+}
+
+void SceneBVH::logStats() const
+{
+    std::cout << "scene bvh: " << entity_leaves.size() << " entities, rebuilt " << rebuild_count << " times, "
+        << refit_count << " leaf refits, cost " << cost() << " (" << built_cost << " after the last rebuild)" << std::endl;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+#include "MeshBVH.h"
+
+class Scene;
+class Model;
+
+struct PickHit
+{
+    uint32_t entity = UINT32_MAX;
+    //along the ray in units of its direction
+    float t = std::numeric_limits<float>::max();
+};
+
+//dynamic hierarchy over entity world bounds for picking and spatial queries, one leaf per entity
+//moved entities are refit in place and new ones inserted where they grow the tree least,
+//both let the surface area cost drift, so the tree is rebuilt with binned SAH once it passes rebuild_ratio
+//times the cost it had after the last rebuild
+class SceneBVH
+{
+    struct Node
+    {
+        Aabb bounds;
+        uint32_t parent;
+        //UINT32_MAX for leaves
+        uint32_t left;
+        uint32_t right;
+        //leaves only
+        uint32_t entity;
+    };
+
+    //leaves being built, partitioned in place so each range stays contiguous in memory
+    struct BuildItem
+    {
+        Aabb bounds;
+        glm::vec3 centroid;
+        uint32_t leaf;
+    };
+
+    std::vector<Node> nodes;
+    uint32_t root = UINT32_MAX;
+    std::vector<uint32_t> entity_leaves;
+    //bounds each model had when its entities were last fit, async loads replace proxy bounds
+    std::unordered_map<const Model*, Aabb> model_bounds;
+    //half areas of all inner nodes, kept current by refits and inserts
+    float inner_area = 0.0f;
+    float built_cost = 0.0f;
+
+    uint32_t allocateNode();
+    uint32_t buildRange(std::vector<BuildItem>& items, uint32_t begin, uint32_t end, uint32_t depth);
+    void setBounds(uint32_t node, const Aabb& bounds);
+    void refitLeaf(uint32_t leaf, const Aabb& bounds);
+    void insertLeaf(uint32_t leaf);
+
+public:
+    float rebuild_ratio = 1.5f;
+    uint32_t rebuild_count = 0;
+    uint64_t refit_count = 0;
+
+    static Aabb entityBounds(const Scene& scene, uint32_t entity);
+
+    void rebuild(const Scene& scene);
+    //takes in Scene::moved_entities, added entities and changed model bounds, call before querying
+    void update(Scene& scene);
+
+    //nearest entity whose mesh the ray hits, exact against the model's MeshBVH
+    //or its bounding box while the model has none (a placeholder still loading)
+    PickHit raycast(const Scene& scene, glm::vec3 origin, glm::vec3 direction) const;
+    //entities whose world bounds overlap box
+    void queryBox(const Aabb& box, std::vector<uint32_t>& entities) const;
+    //entity with the closest world bounds within max_distance of point, UINT32_MAX when there is none
+    uint32_t nearest(glm::vec3 point, float max_distance) const;
+
+    //inner node area relative to the root, the surface area heuristic's traversal cost
+    float cost() const;
+    void logStats() const;
+};
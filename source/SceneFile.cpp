@@ -0,0 +1,411 @@
+#include "SceneFile.h"
+
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+static bool readFile(const std::string& path, std::vector<char>& data)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if(!file)
+    {
+        return false;
+    }
+    data.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(data.data(), static_cast<std::streamsize>(data.size()));
+    return static_cast<bool>(file);
+}
+
+//appends count structs from data at offset, false when the file is too short
+template<typename T>
+static bool readArray(const std::vector<char>& data, size_t& offset, uint32_t count, std::vector<T>& out)
+{
+    size_t bytes = static_cast<size_t>(count) * sizeof(T);
+    if(offset > data.size() || data.size() - offset < bytes)
+    {
+        return false;
+    }
+    out.resize(count);
+    memcpy(out.data(), data.data() + offset, bytes);
+    offset += bytes;
+    return true;
+}
+
+template<typename T>
+static void writeArray(std::ofstream& file, const std::vector<T>& values)
+{
+    file.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+}
+
+bool SceneFile::load(const std::string& path)
+{
+    clear();
+    std::vector<char> data;
+    if(!readFile(path, data))
+    {
+        std::cout << "could not read scene " << path << std::endl;
+        return false;
+    }
+    bool loaded = data.size() >= sizeof(scene_magic) && memcmp(data.data(), scene_magic, sizeof(scene_magic)) == 0
+        ? loadBinary(data, path)
+        : loadText(data, path);
+    if(!loaded || !validate(path))
+    {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+bool SceneFile::loadBinary(const std::vector<char>& data, const std::string& path)
+{
+    SceneFileHeader header;
+    if(data.size() < sizeof(header))
+    {
+        std::cout << path << " is not a valid binary scene" << std::endl;
+        return false;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    if(header.version != scene_version)
+    {
+        std::cout << path << " is scene version " << header.version << ", expected " << scene_version << ", cook it again" << std::endl;
+        return false;
+    }
+    size_t offset = sizeof(header);
+    bool complete = header.string_size % 4 == 0 && readArray(data, offset, header.string_size, strings) &&
+        readArray(data, offset, header.texture_count, textures) &&
+        readArray(data, offset, header.model_count, models) &&
+        readArray(data, offset, header.light_count, lights) &&
+        readArray(data, offset, header.entity_count, entities);
+    if(!complete)
+    {
+        std::cout << path << " is truncated" << std::endl;
+        return false;
+    }
+    memcpy(camera_position, header.camera_position, sizeof(camera_position));
+    z_near = header.z_near;
+    z_far = header.z_far;
+    memcpy(sun, header.sun, sizeof(sun));
+    return true;
+}
+
+bool SceneFile::loadText(const std::vector<char>& data, const std::string& path)
+{
+    std::unordered_map<std::string, uint32_t> texture_indices;
+    std::unordered_map<std::string, uint32_t> model_indices;
+    std::istringstream text(std::string(data.begin(), data.end()));
+    std::string line;
+    uint32_t line_number = 0;
+    auto fail = [&](const std::string& message)
+    {
+        std::cout << path << ":" << line_number << ": " << message << std::endl;
+        return false;
+    };
+    while(std::getline(text, line))
+    {
+        line_number++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream tokens(line);
+        std::string keyword;
+        if(!(tokens >> keyword))
+        {
+            continue;
+        }
+        if(keyword == "camera")
+        {
+            if(!(tokens >> camera_position[0] >> camera_position[1] >> camera_position[2]))
+            {
+                return fail("camera needs a position");
+            }
+            tokens >> z_near >> z_far;
+        }
+        else if(keyword == "sun")
+        {
+            if(!(tokens >> sun[0] >> sun[1] >> sun[2] >> sun[3]))
+            {
+                return fail("sun needs four components");
+            }
+        }
+        else if(keyword == "texture")
+        {
+            std::string name, texture_path;
+            if(!(tokens >> name >> texture_path))
+            {
+                return fail("texture needs a name and a path");
+            }
+            if(!texture_indices.try_emplace(name, static_cast<uint32_t>(textures.size())).second)
+            {
+                return fail("texture " + name + " is defined twice");
+            }
+            textures.push_back({addString(name), addString(texture_path)});
+        }
+        else if(keyword == "model")
+        {
+            std::string name;
+            if(!(tokens >> name))
+            {
+                return fail("model needs a name");
+            }
+            SceneFileModel model = {addString(name), scene_none, scene_none, scene_none, scene_none};
+            std::string field;
+            while(tokens >> field)
+            {
+                std::string value, entry;
+                if(field == "obj" && tokens >> value)
+                {
+                    model.obj_path = addString(value);
+                }
+                else if(field == "texture" && tokens >> value)
+                {
+                    auto it = texture_indices.find(value);
+                    if(it == texture_indices.end())
+                    {
+                        return fail("texture " + value + " is not defined above");
+                    }
+                    model.texture = it->second;
+                }
+                else if(field == "bundle" && tokens >> value >> entry)
+                {
+                    model.bundle_path = addString(value);
+                    model.bundle_entry = addString(entry);
+                }
+                else
+                {
+                    return fail("unexpected " + field + " in model " + name);
+                }
+            }
+            if(model.obj_path == scene_none && model.bundle_path == scene_none)
+            {
+                return fail("model " + name + " needs an obj or a bundle entry");
+            }
+            if(!model_indices.try_emplace(name, static_cast<uint32_t>(models.size())).second)
+            {
+                return fail("model " + name + " is defined twice");
+            }
+            models.push_back(model);
+        }
+        else if(keyword == "light")
+        {
+            SceneFileLight light;
+            if(!(tokens >> light.position[0] >> light.position[1] >> light.position[2] >> light.radius
+                >> light.color[0] >> light.color[1] >> light.color[2] >> light.intensity))
+            {
+                return fail("light needs a position, radius, color and intensity");
+            }
+            lights.push_back(light);
+        }
+        else if(keyword == "entity")
+        {
+            std::string model_name;
+            if(!(tokens >> model_name))
+            {
+                return fail("entity needs a model name or -");
+            }
+            SceneFileEntity entity = {
+                .model = scene_none,
+                .parent = scene_none,
+                .position = {0.0f, 0.0f, 0.0f},
+                .rotation = {0.0f, 0.0f, 0.0f, 1.0f},
+                .scale = {1.0f, 1.0f, 1.0f}
+            };
+            if(model_name != "-")
+            {
+                auto it = model_indices.find(model_name);
+                if(it == model_indices.end())
+                {
+                    return fail("model " + model_name + " is not defined above");
+                }
+                entity.model = it->second;
+            }
+            std::vector<std::string> fields;
+            for(std::string field; tokens >> field;)
+            {
+                fields.push_back(field);
+            }
+            //numbers following fields[i], false when fewer than count of them are there
+            auto numbers = [&](size_t i, uint32_t count, float* out)
+            {
+                for(uint32_t n = 0; n < count; n++)
+                {
+                    char* end = nullptr;
+                    if(i + 1 + n >= fields.size())
+                    {
+                        return false;
+                    }
+                    out[n] = std::strtof(fields[i + 1 + n].c_str(), &end);
+                    if(end == fields[i + 1 + n].c_str() || *end != '\0')
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            };
+            for(size_t i = 0; i < fields.size(); i++)
+            {
+                const std::string& field = fields[i];
+                float values[4];
+                uint32_t count = 0;
+                if(field == "parent" && i + 1 < fields.size())
+                {
+                    //an entity index, strtoul would quietly wrap a leading minus so only digits are taken
+                    const std::string& index = fields[i + 1];
+                    char* end = nullptr;
+                    errno = 0;
+                    unsigned long parent = std::isdigit(static_cast<unsigned char>(index[0])) ? std::strtoul(index.c_str(), &end, 10) : 0;
+                    if(end == nullptr || *end != '\0' || errno == ERANGE || parent >= entities.size())
+                    {
+                        return fail("parent needs the index of an entity above, got " + index);
+                    }
+                    entity.parent = static_cast<uint32_t>(parent);
+                    count = 1;
+                }
+                else if(field == "at" && numbers(i, 3, entity.position))
+                {
+                    count = 3;
+                }
+                else if(field == "rotate" && numbers(i, 3, values))
+                {
+                    glm::quat rotation = glm::quat(glm::radians(glm::vec3(values[0], values[1], values[2])));
+                    entity.rotation[0] = rotation.x;
+                    entity.rotation[1] = rotation.y;
+                    entity.rotation[2] = rotation.z;
+                    entity.rotation[3] = rotation.w;
+                    count = 3;
+                }
+                else if(field == "orient" && numbers(i, 4, entity.rotation))
+                {
+                    count = 4;
+                }
+                //three values are per axis, one is uniform
+                else if(field == "scale" && numbers(i, 3, entity.scale))
+                {
+                    count = 3;
+                }
+                else if(field == "scale" && numbers(i, 1, values))
+                {
+                    entity.scale[0] = entity.scale[1] = entity.scale[2] = values[0];
+                    count = 1;
+                }
+                if(count == 0)
+                {
+                    return fail("unexpected or incomplete " + field + " in entity");
+                }
+                i += count;
+            }
+            entities.push_back(entity);
+        }
+        else
+        {
+            return fail("unknown keyword " + keyword);
+        }
+    }
+    std::cout << "parsed scene " << path << std::endl;
+    return true;
+}
+
+bool SceneFile::validate(const std::string& path) const
+{
+    auto valid_string = [&](uint32_t offset, bool optional)
+    {
+        return (optional && offset == scene_none) || offset < strings.size();
+    };
+    if(!strings.empty() && strings.back() != '\0')
+    {
+        std::cout << path << ": string table is not terminated" << std::endl;
+        return false;
+    }
+    for(const SceneFileTexture& texture : textures)
+    {
+        if(!valid_string(texture.name, false) || !valid_string(texture.path, false))
+        {
+            std::cout << path << ": texture with a bad string offset" << std::endl;
+            return false;
+        }
+    }
+    for(const SceneFileModel& model : models)
+    {
+        if(!valid_string(model.name, false) || !valid_string(model.obj_path, true) || !valid_string(model.bundle_path, true) ||
+            !valid_string(model.bundle_entry, true) || (model.texture != scene_none && model.texture >= textures.size()))
+        {
+            std::cout << path << ": model with a bad string offset or texture" << std::endl;
+            return false;
+        }
+    }
+    uint32_t model_count = static_cast<uint32_t>(models.size());
+    for(uint32_t i = 0; i < entities.size(); i++)
+    {
+        const SceneFileEntity& entity = entities[i];
+        //parents come first, so a single pass in file order can place every entity
+        if((entity.model != scene_none && entity.model >= model_count) || (entity.parent != scene_none && entity.parent >= i))
+        {
+            std::cout << path << ": entity " << i << " has a bad model or a parent that does not come before it" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SceneFile::saveBinary(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if(!file)
+    {
+        return false;
+    }
+    std::vector<char> padded_strings = strings;
+    padded_strings.resize((strings.size() + 3) & ~size_t(3), '\0');
+    SceneFileHeader header = {
+        .version = scene_version,
+        .texture_count = static_cast<uint32_t>(textures.size()),
+        .model_count = static_cast<uint32_t>(models.size()),
+        .light_count = static_cast<uint32_t>(lights.size()),
+        .entity_count = static_cast<uint32_t>(entities.size()),
+        .string_size = static_cast<uint32_t>(padded_strings.size()),
+        .z_near = z_near,
+        .z_far = z_far
+    };
+    memcpy(header.magic, scene_magic, sizeof(scene_magic));
+    memcpy(header.camera_position, camera_position, sizeof(camera_position));
+    memcpy(header.sun, sun, sizeof(sun));
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writeArray(file, padded_strings);
+    writeArray(file, textures);
+    writeArray(file, models);
+    writeArray(file, lights);
+    writeArray(file, entities);
+    return static_cast<bool>(file);
+}
+
+void SceneFile::clear()
+{
+    string_offsets.clear();
+    strings.clear();
+    textures.clear();
+    models.clear();
+    lights.clear();
+    entities.clear();
+}
+
+uint32_t SceneFile::addString(const std::string& value)
+{
+    auto [it, inserted] = string_offsets.try_emplace(value, static_cast<uint32_t>(strings.size()));
+    if(inserted)
+    {
+        strings.insert(strings.end(), value.begin(), value.end());
+        strings.push_back('\0');
+    }
+    return it->second;
+}
+
+const char* SceneFile::string(uint32_t offset) const
+{
+    return offset == scene_none ? "" : strings.data() + offset;
+}
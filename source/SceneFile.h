@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//scene layout with models, textures, entities, camera and lights, in a text form for editing
+//and a binary form for large scenes, load() tells them apart by the magic
+//
+//text, one item per line, # starts a comment, names and paths have no spaces:
+//  camera <x> <y> <z> [<near> <far>]
+//  sun <x> <y> <z> <w>
+//  texture <name> <path.ktx>
+//  model <name> [obj <path.obj>] [texture <texture name>] [bundle <path.vkb> <entry>]
+//  light <x> <y> <z> <radius> <r> <g> <b> <intensity>
+//  entity <model name or -> [parent <entity index>] [at <x> <y> <z>] [rotate <pitch> <yaw> <roll>]
+//      [orient <qx> <qy> <qz> <qw>] [scale <s> or <sx> <sy> <sz>]
+//a model prefers its bundle entry and falls back to the obj, entities without a model only group children,
+//parent is the zero based index of an earlier entity line, the entity's transform is relative to it
+//
+//binary, written by asset_cooker -s: [SceneFileHeader][string table][textures][models][lights][entities]
+//every array is a plain copy of the structs below, so loading is one read and a bounds check
+
+constexpr char scene_magic[8] = {'V', 'K', 'R', 'S', 'C', 'N', 'E', '\0'};
+//bump whenever a struct below changes, old binary scenes are then rejected
+constexpr uint32_t scene_version = 1;
+//no model, no parent, no texture or no string
+constexpr uint32_t scene_none = UINT32_MAX;
+
+struct SceneFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t texture_count;
+    uint32_t model_count;
+    uint32_t light_count;
+    uint32_t entity_count;
+    //padded to 4 bytes so the arrays after it stay aligned
+    uint32_t string_size;
+    float camera_position[3];
+    float z_near;
+    float z_far;
+    float sun[4];
+    uint32_t pad;
+};
+
+//string members are offsets into the string table
+struct SceneFileTexture
+{
+    uint32_t name;
+    uint32_t path;
+};
+
+struct SceneFileModel
+{
+    uint32_t name;
+    uint32_t obj_path;
+    uint32_t texture;
+    uint32_t bundle_path;
+    uint32_t bundle_entry;
+};
+
+//same fields as PointLight
+struct SceneFileLight
+{
+    float position[3];
+    float radius;
+    float color[3];
+    float intensity;
+};
+
+struct SceneFileEntity
+{
+    uint32_t model;
+    //index of an earlier entity
+    uint32_t parent;
+    float position[3];
+    //quaternion x y z w
+    float rotation[4];
+    float scale[3];
+};
+
+class SceneFile
+{
+    //offsets of strings already added, keeps repeated paths stored once
+    std::unordered_map<std::string, uint32_t> string_offsets;
+
+    bool loadText(const std::vector<char>& data, const std::string& path);
+    bool loadBinary(const std::vector<char>& data, const std::string& path);
+    //indices and string offsets in range and every parent before its child
+    bool validate(const std::string& path) const;
+
+public:
+    std::vector<char> strings;
+    std::vector<SceneFileTexture> textures;
+    std::vector<SceneFileModel> models;
+    std::vector<SceneFileLight> lights;
+    std::vector<SceneFileEntity> entities;
+    float camera_position[3] = {0.0f, 0.0f, 0.0f};
+    float z_near = 0.1f;
+    float z_far = 32.0f;
+    float sun[4] = {0.0f, -10.0f, 10.0f, 0.0f};
+
+    //text or binary, false with a message when the file is missing or malformed
+    bool load(const std::string& path);
+    bool saveBinary(const std::string& path) const;
+    void clear();
+
+    uint32_t addString(const std::string& value);
+    //empty for scene_none
+    const char* string(uint32_t offset) const;
+};
@@ -0,0 +1,138 @@
+#include "SceneStreamer.h"
+#include "RendererLoader.h"
+#include "Scene.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+void SceneStreamer::start(RendererLoader* loader)
+{
+    this->loader = loader;
+}
+
+bool SceneStreamer::load(Scene* scene, const std::string& path)
+{
+    uint64_t start = SDL_GetPerformanceCounter();
+    if(!file.load(path))
+    {
+        return false;
+    }
+    this->scene = scene;
+    start_ticks = SDL_GetTicks();
+
+    scene->camera.pos = glm::vec3(file.camera_position[0], file.camera_position[1], file.camera_position[2]);
+    scene->camera.z_near = file.z_near;
+    scene->camera.z_far = file.z_far;
+    scene->light_pos = glm::vec4(file.sun[0], file.sun[1], file.sun[2], file.sun[3]);
+    scene->lights.reserve(scene->lights.size() + file.lights.size());
+    for(const SceneFileLight& light : file.lights)
+    {
+        scene->lights.push_back({
+            .position = glm::vec3(light.position[0], light.position[1], light.position[2]),
+            .radius = light.radius,
+            .color = glm::vec3(light.color[0], light.color[1], light.color[2]),
+            .intensity = light.intensity
+        });
+    }
+
+    //a bundle named by several models is mapped once
+    std::unordered_map<std::string, AssetBundle*> bundles;
+    models.clear();
+    for(const SceneFileModel& file_model : file.models)
+    {
+        auto model = std::make_unique<Model>();
+        Model* model_ptr = model.get();
+        std::string name = file.string(file_model.name);
+        Scene* target = scene;
+        auto on_loaded = [target, model_ptr, name](AssetHandle handle, bool loaded)
+        {
+            if(!loaded)
+            {
+                std::cout << "scene model " << name << " failed to load" << std::endl;
+                return;
+            }
+            if(std::find(target->textures.begin(), target->textures.end(), model_ptr->texture) == target->textures.end())
+            {
+                target->textures.push_back(model_ptr->texture);
+            }
+        };
+
+        AssetBundle* bundle = nullptr;
+        if(file_model.bundle_path != scene_none)
+        {
+            auto [it, inserted] = bundles.try_emplace(file.string(file_model.bundle_path), nullptr);
+            if(inserted)
+            {
+                it->second = loader->openBundle(it->first);
+            }
+            bundle = it->second;
+        }
+        const char* entry = file.string(file_model.bundle_entry);
+        if(bundle && bundle->find(entry))
+        {
+            loader->assets.loadModel(model_ptr, *bundle, entry, on_loaded);
+        }
+        else if(file_model.obj_path != scene_none)
+        {
+            std::string texture_path = file_model.texture == scene_none ? "" : file.string(file.textures[file_model.texture].path);
+            loader->assets.loadModel(model_ptr, file.string(file_model.obj_path), texture_path, on_loaded);
+        }
+        else
+        {
+            //never drawn, its entities still take part in the hierarchy
+            std::cout << "scene model " << name << " has no cooked entry and no obj to fall back to" << std::endl;
+        }
+        scene->models.push_back(std::move(model));
+        models.push_back(model_ptr);
+    }
+
+    entity_base = static_cast<uint32_t>(scene->entities.size());
+    next_entity = 0;
+    scene->entities.reserve(entity_base + file.entities.size());
+    double ms = static_cast<double>(SDL_GetPerformanceCounter() - start) * 1000.0 / static_cast<double>(SDL_GetPerformanceFrequency());
+    std::cout << "scene " << path << ": " << file.models.size() << " models, " << file.lights.size() << " lights, "
+        << file.entities.size() << " entities, read in " << ms << " ms" << std::endl;
+    return true;
+}
+
+void SceneStreamer::update()
+{
+    if(!streaming())
+    {
+        return;
+    }
+    uint32_t end = std::min(next_entity + entities_per_frame, static_cast<uint32_t>(file.entities.size()));
+    for(uint32_t i = next_entity; i < end; i++)
+    {
+        const SceneFileEntity& e = file.entities[i];
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(e.position[0], e.position[1], e.position[2])) *
+            glm::mat4_cast(glm::quat(e.rotation[3], e.rotation[0], e.rotation[1], e.rotation[2])) *
+            glm::scale(glm::mat4(1.0f), glm::vec3(e.scale[0], e.scale[1], e.scale[2]));
+        if(e.parent != scene_none)
+        {
+            transform = scene->entities[entity_base + e.parent].transform * transform;
+        }
+        scene->entities.push_back({
+            .model = e.model == scene_none ? nullptr : models[e.model],
+            .transform = transform
+        });
+    }
+    next_entity = end;
+    if(next_entity == file.entities.size())
+    {
+        std::cout << "scene instantiated, " << file.entities.size() << " entities after " << SDL_GetTicks() - start_ticks << " ms" << std::endl;
+        file.clear();
+        file.entities.shrink_to_fit();
+        next_entity = 0;
+    }
+}
+
+bool SceneStreamer::streaming() const
+{
+    return next_entity < file.entities.size();
+}
+
+uint32_t SceneStreamer::pendingEntities() const
+{
+    return static_cast<uint32_t>(file.entities.size()) - next_entity;
+}
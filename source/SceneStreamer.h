@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "SceneFile.h"
+
+class RendererLoader;
+class Scene;
+class Model;
+
+//instantiates a scene file into a Scene while the render loop runs
+//load() reads the file, sets the camera and lights and requests every model from the AssetLoader,
+//which draws placeholders until they arrive, update() then appends entities_per_frame entities a frame
+//in file order, so a parent's world transform is in place before its children are placed under it
+//the scene's bvh is left alone while streaming and rebuilt once by the first update after it
+class SceneStreamer
+{
+    RendererLoader* loader = nullptr;
+    Scene* scene = nullptr;
+    SceneFile file;
+    //scene models in file order
+    std::vector<Model*> models;
+    //scene index of the file's first entity
+    uint32_t entity_base = 0;
+    uint32_t next_entity = 0;
+    uint64_t start_ticks = 0;
+
+public:
+    uint32_t entities_per_frame = 65536;
+
+    void start(RendererLoader* loader);
+
+    //replaces whatever was still streaming, false when the file could not be read
+    bool load(Scene* scene, const std::string& path);
+    //call once per frame before the frame reads the scene's entities
+    void update();
+
+    bool streaming() const;
+    uint32_t pendingEntities() const;
+};
@@ -1,6 +1,7 @@
 #pragma once
 #include <volk/volk.h>
 #include "ImageAlloc.h"
+#include <algorithm>
 
 class Texture
 {
@@ -9,6 +10,22 @@ public:
     VkSampler sampler;
     VkDescriptorImageInfo descriptor;
     uint32_t texture_index;
+    VkFormat format;
+    //extent of mip 0 and the full chain length in the source file, the gpu image may hold fewer levels
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_levels;
+    //finest mip currently resident, image mip 0 corresponds to this level
+    uint32_t resident_mip = 0;
+
+    VkExtent3D mipExtent(uint32_t level) const
+    {
+        return {
+            .width = std::max(1u, width >> level),
+            .height = std::max(1u, height >> level),
+            .depth = 1
+        };
+    }
 
     void destroy(VkDevice device)
     {
@@ -0,0 +1,156 @@
+#include "TextureRegistry.h"
+#include "AssetBundle.h"
+
+#include <cstring>
+
+constexpr uint8_t ktx2_identifier[12] = {0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n'};
+
+//splitmix64 finalizer
+static uint64_t mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+static uint64_t checkHash(const uint8_t* data, size_t size)
+{
+    uint64_t hash = mix(0x9e3779b97f4a7c15ull ^ size);
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = mix(hash ^ mix(word));
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, data + i, size - i);
+    return mix(hash ^ mix(tail ^ 0xff));
+}
+
+static uint32_t sourceFormat(const uint8_t* data, size_t size)
+{
+    uint32_t format = 0;
+    if(size >= sizeof(ktx2_identifier) + sizeof(format) && memcmp(data, ktx2_identifier, sizeof(ktx2_identifier)) == 0)
+    {
+        memcpy(&format, data + sizeof(ktx2_identifier), sizeof(format));
+    }
+    return format;
+}
+
+TextureKey TextureRegistry::hashContents(const uint8_t* data, size_t size)
+{
+    return {
+        .hash = hashBytes(data, size),
+        .check = checkHash(data, size),
+        .size = size,
+        .format = sourceFormat(data, size)
+    };
+}
+
+TextureKey TextureRegistry::hashContents(const std::vector<uint8_t>& data)
+{
+    return hashContents(data.data(), data.size());
+}
+
+TextureKey TextureRegistry::hashBundleEntry(const BundleEntry& entry, const uint8_t* data)
+{
+    return {
+        .hash = entry.content_hash,
+        .check = checkHash(data, entry.size),
+        .size = entry.size,
+        .format = sourceFormat(data, entry.size)
+    };
+}
+
+Texture* TextureRegistry::findByPath(const std::string& path)
+{
+    auto it = path_lookup.find(path);
+    if(it == path_lookup.end())
+    {
+        return nullptr;
+    }
+    Entry& entry = entries.at(it->second);
+    entry.ref_count++;
+    path_hits++;
+    saved_bytes += entry.texture->image.size;
+    return entry.texture.get();
+}
+
+Texture* TextureRegistry::findByHash(const TextureKey& key, const std::string& path)
+{
+    auto it = entries.find(key);
+    if(it == entries.end())
+    {
+        return nullptr;
+    }
+    Entry& entry = it->second;
+    entry.ref_count++;
+    entry.paths.push_back(path);
+    path_lookup[path] = key;
+    content_hits++;
+    saved_bytes += entry.texture->image.size;
+    std::cout << path << " has the same contents as " << entry.paths.front() << ", sharing its texture" << std::endl;
+    return entry.texture.get();
+}
+
+Texture* TextureRegistry::insert(const TextureKey& key, const std::string& path, Texture* texture)
+{
+    path_lookup[path] = key;
+    texture_lookup[texture] = key;
+    entries[key] = {
+        .texture = std::unique_ptr<Texture>(texture),
+        .key = key,
+        .ref_count = 1,
+        .paths = {path}
+    };
+    return texture;
+}
+
+std::unique_ptr<Texture> TextureRegistry::release(Texture* texture)
+{
+    auto it = texture_lookup.find(texture);
+    if(it == texture_lookup.end())
+    {
+        return nullptr;
+    }
+    Entry& entry = entries.at(it->second);
+    if(--entry.ref_count > 0)
+    {
+        return nullptr;
+    }
+    for(const auto& path : entry.paths)
+    {
+        path_lookup.erase(path);
+    }
+    std::unique_ptr<Texture> released = std::move(entry.texture);
+    entries.erase(it->second);
+    texture_lookup.erase(it);
+    return released;
+}
+
+uint32_t TextureRegistry::refCount(Texture* texture) const
+{
+    auto it = texture_lookup.find(texture);
+    return it == texture_lookup.end() ? 0 : entries.at(it->second).ref_count;
+}
+
+void TextureRegistry::destroy(VkDevice device)
+{
+    for(auto& [key, entry] : entries)
+    {
+        entry.texture->destroy(device);
+    }
+    entries.clear();
+    path_lookup.clear();
+    texture_lookup.clear();
+}
+
+void TextureRegistry::logStats() const
+{
+    std::cout << "texture registry: " << entries.size() << " unique textures, "
+        << path_hits << " path hits, " << content_hits << " content hits, "
+        << saved_bytes / 1024 << " KiB saved" << std::endl;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <volk/volk.h>
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <unordered_map>
+
+#include "Engine.h"
+#include "Texture.h"
+
+struct BundleEntry;
+
+//identity of a texture's source bytes, two unrelated 64 bit hashes plus the byte size and the source format
+//so contents are only shared when everything matches, a single 64 bit hash colliding is not enough
+struct TextureKey
+{
+    //fnv-1a over the bytes, or the cooker's content hash for bundle entries
+    uint64_t hash = 0;
+    //word wise multiply and shift hash over the same bytes
+    uint64_t check = 0;
+    uint64_t size = 0;
+    //vkFormat from a ktx2 header, 0 for other files and basis supercompressed data
+    uint32_t format = 0;
+
+    bool operator==(const TextureKey& other) const = default;
+};
+
+struct TextureKeyHash
+{
+    size_t operator()(const TextureKey& key) const
+    {
+        return static_cast<size_t>(key.hash ^ key.check);
+    }
+};
+
+//shares one gpu texture between every requester of the same file contents
+//lookups go by path first and fall back to the key of the file bytes
+class TextureRegistry
+{
+    struct Entry
+    {
+        std::unique_ptr<Texture> texture;
+        TextureKey key;
+        uint32_t ref_count;
+        std::vector<std::string> paths;
+    };
+
+    std::unordered_map<TextureKey, Entry, TextureKeyHash> entries;
+    std::unordered_map<std::string, TextureKey> path_lookup;
+    std::unordered_map<Texture*, TextureKey> texture_lookup;
+
+public:
+    uint32_t path_hits = 0;
+    uint32_t content_hits = 0;
+    //device memory that duplicate loads would have allocated
+    VkDeviceSize saved_bytes = 0;
+
+    static TextureKey hashContents(const uint8_t* data, size_t size);
+    static TextureKey hashContents(const std::vector<uint8_t>& data);
+    //reuses the cooker's hash, only the check hash is computed over the mapped entry
+    static TextureKey hashBundleEntry(const BundleEntry& entry, const uint8_t* data);
+
+    //both lookups add a reference on a hit
+    Texture* findByPath(const std::string& path);
+    Texture* findByHash(const TextureKey& key, const std::string& path);
+
+    //registers a freshly created texture with one reference, the registry owns it from now on
+    Texture* insert(const TextureKey& key, const std::string& path, Texture* texture);
+
+    //drops a reference, the last one hands the texture back to the caller for retirement
+    std::unique_ptr<Texture> release(Texture* texture);
+
+    uint32_t refCount(Texture* texture) const;
+
+    void destroy(VkDevice device);
+    void logStats() const;
+};
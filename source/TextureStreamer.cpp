@@ -0,0 +1,376 @@
+#include "TextureStreamer.h"
+#include "Scene.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <iterator>
+
+#include <ktx.h>
+#include <ktxvulkan.h>
+
+void TextureStreamer::start(Engine* engine, const KtxLoader* ktx_loader)
+{
+    this->ktx_loader = ktx_loader;
+    jobs = &engine->job_system;
+    engine->main_deletion_queue.push([=]()
+    {
+        //loads hold pointers into this streamer until they finish
+        jobs->wait(&loads);
+    });
+    std::cout << "texture streamer started" << std::endl;
+}
+
+uint32_t TextureStreamer::tailMip(const Texture* texture) const
+{
+    uint32_t level = 0;
+    while(level + 1 < texture->mip_levels && std::max(texture->width >> level, texture->height >> level) > tail_size)
+    {
+        level++;
+    }
+    return level;
+}
+
+void TextureStreamer::registerTexture(Texture* texture, const std::string& path)
+{
+    entry_lookup[texture] = static_cast<uint32_t>(entries.size());
+    entries.push_back({
+        .texture = texture,
+        .path = path,
+        .requested_mip = texture->resident_mip,
+        .last_visible_frame = 0,
+        .loading = false
+    });
+}
+
+void TextureStreamer::unregisterTexture(Texture* texture)
+{
+    auto it = entry_lookup.find(texture);
+    if(it == entry_lookup.end())
+    {
+        return;
+    }
+    entries[it->second].texture = nullptr;
+    entry_lookup.erase(it);
+}
+
+TextureStreamer::LoadResult TextureStreamer::readLevels(const LoadRequest& request) const
+{
+    LoadResult result = {
+        .entry = request.entry,
+        .first_level = request.first_level,
+        .failed = true
+    };
+    //basis payloads are transcoded again here, the gpu format matches the tail uploaded at load time
+    ktxTexture* ktx_texture = ktx_loader->load(request.path);
+    if(ktx_texture == nullptr)
+    {
+        return result;
+    }
+    for(uint32_t level = request.first_level; level < request.end_level; level++)
+    {
+        ktx_size_t level_offset;
+        ktxTexture_GetImageOffset(ktx_texture, level, 0, 0, &level_offset);
+        ktx_size_t level_size = ktxTexture_GetImageSize(ktx_texture, level);
+        result.regions.push_back({
+            .bufferOffset = result.data.size(),
+            .imageSubresource = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = level,
+                .layerCount = 1
+            },
+            .imageExtent = {
+                .width = std::max(1u, ktx_texture->baseWidth >> level),
+                .height = std::max(1u, ktx_texture->baseHeight >> level),
+                .depth = 1
+            }
+        });
+        result.data.insert(result.data.end(), ktx_texture->pData + level_offset, ktx_texture->pData + level_offset + level_size);
+    }
+    ktxTexture_Destroy(ktx_texture);
+    result.failed = false;
+    return result;
+}
+
+void TextureStreamer::updateRequests(Engine* engine, Scene* scene, float viewport_height, uint64_t frame_number)
+{
+    if(entries.empty())
+    {
+        return;
+    }
+    //textures nobody looks at fall back to their tail
+    FrameVector<uint32_t> wanted(entries.size(), FrameArena::local());
+    for(size_t i = 0; i < entries.size(); i++)
+    {
+        wanted[i] = entries[i].texture ? tailMip(entries[i].texture) : 0;
+    }
+
+    glm::vec3 eye = glm::vec3(glm::inverse(scene->camera.view)[3]);
+    float proj_scale = scene->camera.proj[1][1];
+    for(const Entity& e : scene->entities)
+    {
+        if(!e.model || !e.model->texture)
+        {
+            continue;
+        }
+        auto it = entry_lookup.find(e.model->texture);
+        if(it == entry_lookup.end())
+        {
+            continue;
+        }
+        Entry& entry = entries[it->second];
+        const Texture* tex = entry.texture;
+
+        float scale = std::max({glm::length(glm::vec3(e.transform[0])), glm::length(glm::vec3(e.transform[1])), glm::length(glm::vec3(e.transform[2]))});
+        glm::vec3 center = glm::vec3(e.transform * glm::vec4(e.model->bounds_center, 1.0f));
+        float radius = e.model->bounds_radius * scale;
+        float distance = glm::length(center - eye);
+
+        uint32_t mip = 0;
+        if(distance > radius)
+        {
+            //projected diameter in pixels, assuming the uv layout spans the texture once across the mesh
+            float screen_size = std::max(1.0f, radius * proj_scale / distance * viewport_height);
+            float texture_size = static_cast<float>(std::max(tex->width, tex->height));
+            mip = static_cast<uint32_t>(std::max(0.0f, std::floor(std::log2(texture_size / screen_size))));
+        }
+        mip = std::min(mip + pressure_bias, tailMip(tex));
+        wanted[it->second] = std::min(wanted[it->second], mip);
+        entry.last_visible_frame = frame_number;
+    }
+    for(size_t i = 0; i < entries.size(); i++)
+    {
+        entries[i].requested_mip = wanted[i];
+    }
+
+    //under memory pressure drop levels finer than requested, least recently seen first
+    //when nothing is left to drop make every request coarser until usage relaxes
+    uint32_t heap = engine->memory_budget.deviceLocalHeap();
+    float usage = engine->memory_budget.usageRatio(heap);
+    pending_evictions.clear();
+    if(usage > evict_threshold)
+    {
+        FrameVector<uint32_t> candidates(FrameArena::local());
+        for(uint32_t i = 0; i < entries.size(); i++)
+        {
+            if(entries[i].texture && !entries[i].loading && entries[i].texture->resident_mip < entries[i].requested_mip)
+            {
+                candidates.push_back(i);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b)
+        {
+            return entries[a].last_visible_frame < entries[b].last_visible_frame;
+        });
+        for(uint32_t i = 0; i < candidates.size() && i < max_changes_per_frame; i++)
+        {
+            pending_evictions.push_back({candidates[i], entries[candidates[i]].requested_mip});
+        }
+        if(candidates.empty() && pressure_bias < 16)
+        {
+            pressure_bias++;
+        }
+        return;
+    }
+    if(usage < relax_threshold && pressure_bias > 0)
+    {
+        pressure_bias--;
+    }
+
+    for(uint32_t i = 0; i < entries.size() && loads_in_flight < max_loads_in_flight; i++)
+    {
+        Entry& entry = entries[i];
+        const Texture* tex = entry.texture;
+        if(!tex || entry.loading || entry.requested_mip >= tex->resident_mip)
+        {
+            continue;
+        }
+        //rough size of the finer levels, 4 bytes per texel is an upper bound for rgba8 and every block format
+        VkDeviceSize estimate = 0;
+        for(uint32_t level = entry.requested_mip; level < tex->resident_mip; level++)
+        {
+            VkExtent3D extent = tex->mipExtent(level);
+            estimate += (VkDeviceSize)extent.width * extent.height * 4;
+        }
+        if(!engine->memory_budget.hasHeadroom(heap, estimate + tex->image.size))
+        {
+            continue;
+        }
+        entry.loading = true;
+        LoadRequest request = {
+            .entry = i,
+            .path = entry.path,
+            .first_level = entry.requested_mip,
+            .end_level = tex->resident_mip
+        };
+        jobs->submit([this, request]()
+        {
+            LoadResult result = readLevels(request);
+            std::lock_guard<std::mutex> lock(mutex);
+            results.push_back(std::move(result));
+        }, &loads);
+        loads_in_flight++;
+    }
+}
+
+void TextureStreamer::rebuildImage(Engine* engine, BindlessTable* bindless_textures, VkCommandBuffer cmd, Entry& entry, uint32_t new_resident, LoadResult* result, uint64_t frame_number)
+{
+    Texture* tex = entry.texture;
+    ImageAlloc old_image = tex->image;
+    uint32_t old_resident = tex->resident_mip;
+    uint32_t new_levels = tex->mip_levels - new_resident;
+
+    VkImageCreateInfo image_create_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = tex->format,
+        .extent = tex->mipExtent(new_resident),
+        .mipLevels = new_levels,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+    };
+    ImageAlloc new_image = ImageAlloc::create(engine->allocator, engine->device, image_create_info, 0, VK_IMAGE_ASPECT_COLOR_BIT, MemoryCategory::Textures);
+
+    std::array<VkImageMemoryBarrier2, 2> barriers = {
+        VkImageMemoryBarrier2{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+            .srcStageMask = VK_PIPELINE_STAGE_2_NONE,
+            .srcAccessMask = VK_ACCESS_2_NONE,
+            .dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+            .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .image = new_image.handle,
+            .subresourceRange = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .levelCount = new_levels,
+                .layerCount = 1
+            }
+        },
+        VkImageMemoryBarrier2{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+            .srcStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+            .srcAccessMask = VK_ACCESS_2_SHADER_READ_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+            .dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            .image = old_image.handle,
+            .subresourceRange = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .levelCount = tex->mip_levels - old_resident,
+                .layerCount = 1
+            }
+        }
+    };
+    VkDependencyInfo dep_info = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size()),
+        .pImageMemoryBarriers = barriers.data()
+    };
+    vkCmdPipelineBarrier2(cmd, &dep_info);
+
+    BufferAlloc staging = {};
+    if(result)
+    {
+        staging = BufferAlloc::create(engine->allocator,
+            engine->device,
+            result->data.size(),
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+            MemoryCategory::Staging);
+        memcpy(staging.allocation_info.pMappedData, result->data.data(), result->data.size());
+        for(auto& region : result->regions)
+        {
+            region.imageSubresource.mipLevel -= new_resident;
+        }
+        vkCmdCopyBufferToImage(cmd, staging.handle, new_image.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(result->regions.size()), result->regions.data());
+    }
+
+    //levels present in both images move over on the gpu
+    FrameVector<VkImageCopy> image_copies(FrameArena::local());
+    for(uint32_t level = std::max(old_resident, new_resident); level < tex->mip_levels; level++)
+    {
+        image_copies.push_back({
+            .srcSubresource = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = level - old_resident,
+                .layerCount = 1
+            },
+            .dstSubresource = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = level - new_resident,
+                .layerCount = 1
+            },
+            .extent = tex->mipExtent(level)
+        });
+    }
+    vkCmdCopyImage(cmd, old_image.handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, new_image.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(image_copies.size()), image_copies.data());
+
+    VkImageMemoryBarrier2 barrier_texture_read = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+        .dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
+        .image = new_image.handle,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .levelCount = new_levels,
+            .layerCount = 1
+        }
+    };
+    dep_info.imageMemoryBarrierCount = 1;
+    dep_info.pImageMemoryBarriers = &barrier_texture_read;
+    vkCmdPipelineBarrier2(cmd, &dep_info);
+
+    //both are still read by this frame's copies
+    engine->defragmenter.untrack(old_image.allocation);
+    engine->retirement_queue.retire(old_image);
+    engine->retirement_queue.retire(staging);
+    tex->image = new_image;
+    tex->resident_mip = new_resident;
+    tex->descriptor.imageView = new_image.view;
+    bindless_textures->free(tex->texture_index);
+    tex->texture_index = bindless_textures->allocate(tex->descriptor);
+    bindless_textures->trackTexture(engine, tex, image_create_info);
+}
+
+void TextureStreamer::recordResidencyChanges(Engine* engine, BindlessTable* bindless_textures, VkCommandBuffer cmd, uint64_t frame_number)
+{
+    FrameVector<LoadResult> completed(FrameArena::local());
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t count = std::min<size_t>(results.size(), max_changes_per_frame);
+        std::move(results.begin(), results.begin() + count, std::back_inserter(completed));
+        results.erase(results.begin(), results.begin() + count);
+    }
+
+    loads_in_flight -= static_cast<uint32_t>(completed.size());
+    for(auto& result : completed)
+    {
+        Entry& entry = entries[result.entry];
+        entry.loading = false;
+        if(!entry.texture)
+        {
+            continue;
+        }
+        if(result.failed)
+        {
+            std::cout << "could not stream texture " << entry.path << std::endl;
+            continue;
+        }
+        rebuildImage(engine, bindless_textures, cmd, entry, result.first_level, &result, frame_number);
+    }
+    for(const auto& [index, new_resident] : pending_evictions)
+    {
+        rebuildImage(engine, bindless_textures, cmd, entries[index], new_resident, nullptr, frame_number);
+    }
+    pending_evictions.clear();
+}
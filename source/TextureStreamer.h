@@ -0,0 +1,90 @@
+#pragma once
+#include <volk/volk.h>
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <unordered_map>
+
+#include "Engine.h"
+#include "BufferAlloc.h"
+#include "ImageAlloc.h"
+#include "Texture.h"
+#include "KtxLoader.h"
+#include "BindlessTable.h"
+#include "FrameArena.h"
+
+class Scene;
+
+//keeps only the mips a texture needs on the gpu
+//textures start with their coarse mip tail, finer levels are read by jobs on the engine's job system
+//and the image is reallocated with the new level range, so non resident levels can never be sampled
+class TextureStreamer
+{
+    struct Entry
+    {
+        //nullptr once unregistered, entries keep their index so in flight loads stay valid
+        Texture* texture;
+        std::string path;
+        uint32_t requested_mip;
+        uint64_t last_visible_frame;
+        bool loading;
+    };
+
+    struct LoadRequest
+    {
+        uint32_t entry;
+        std::string path;
+        uint32_t first_level;
+        uint32_t end_level;
+    };
+
+    struct LoadResult
+    {
+        uint32_t entry;
+        uint32_t first_level;
+        bool failed;
+        std::vector<uint8_t> data;
+        std::vector<VkBufferImageCopy> regions;
+    };
+
+    std::vector<Entry> entries;
+    std::unordered_map<Texture*, uint32_t> entry_lookup;
+    std::vector<std::pair<uint32_t, uint32_t>> pending_evictions;
+    uint32_t pressure_bias = 0;
+
+    JobSystem* jobs = nullptr;
+    //counts load jobs still reading, waited on at shutdown
+    JobCounter loads;
+    //loads submitted whose results have not been applied yet
+    uint32_t loads_in_flight = 0;
+    std::mutex mutex;
+    std::vector<LoadResult> results;
+    const KtxLoader* ktx_loader = nullptr;
+
+    LoadResult readLevels(const LoadRequest& request) const;
+    void rebuildImage(Engine* engine, BindlessTable* bindless_textures, VkCommandBuffer cmd, Entry& entry, uint32_t new_resident, LoadResult* result, uint64_t frame_number);
+
+public:
+    //mips at or below this size are uploaded at load time and never evicted
+    uint32_t tail_size = 64;
+    //device local heap usage ratio where eviction starts and where it stops again
+    float evict_threshold = 0.85f;
+    float relax_threshold = 0.7f;
+    uint32_t max_changes_per_frame = 2;
+    uint32_t max_loads_in_flight = 4;
+
+    void start(Engine* engine, const KtxLoader* ktx_loader);
+
+    uint32_t tailMip(const Texture* texture) const;
+    void registerTexture(Texture* texture, const std::string& path);
+    //stops streaming a texture that is about to be destroyed, in flight loads for it are dropped
+    void unregisterTexture(Texture* texture);
+
+    //call once per frame before recording, picks the wanted mip of every texture from its projected screen size
+    void updateRequests(Engine* engine, Scene* scene, float viewport_height, uint64_t frame_number);
+
+    //records image reallocations and uploads into cmd
+    //a rebuilt texture moves to a new bindless slot, frames in flight keep sampling the old one
+    void recordResidencyChanges(Engine* engine, BindlessTable* bindless_textures, VkCommandBuffer cmd, uint64_t frame_number);
+};
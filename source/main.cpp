@@ -5,6 +5,7 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 // #define TINYOBJLOADER_IMPLEMENTATION
 
+#include <filesystem>
 #include <iostream>
 
 #include "Engine.h"
@@ -21,46 +22,48 @@
 //2. Create Output
 //3. Create Renderer loader
 //4. Create Scene
-//5. Create models with a file
-//6. Load them into gpu thorugh renderer
-//7. Load textures into gpu through renderer with a file
-//8. Assign textures to models
-//9. Put model into scene
-//10 Put texture into scene
-//11. Add entities to scene
-//12. update descriptors with a renderer
-//13. Create pipeline
-//14. render loop
-//15. cleanup
+//5. Load a scene file through the renderer's scene streamer, it requests models and textures and adds the entities
+//6. Create pipeline
+//7. render loop
+//8. cleanup
 
-int main()
+int main(int argc, char** argv)
 {
     Engine engine;
+    //1 keeps latency lowest, 3 keeps the gpu busy on heavy frames, can be changed at runtime with keys 1-4
+    engine.frame_scheduler.setFramesInFlight(2);
+    engine.memory_budget.dump_interval_frames = 600;
+    engine.memory_budget.addThresholdCallback(0.9f, [](const HeapBudget& heap, float threshold)
+    {
+        std::cout << "memory heap " << heap.heap_index << " crossed " << threshold * 100.0f << "% of its budget ("
+            << heap.usage << " / " << heap.budget << " bytes)" << std::endl;
+        for(uint32_t i = 0; i < (uint32_t)MemoryCategory::Count; i++)
+        {
+            CategoryUsage usage = MemoryBudget::categoryUsage((MemoryCategory)i);
+            std::cout << "  " << memoryCategoryName((MemoryCategory)i) << ": " << usage.bytes << " bytes in " << usage.allocation_count << " allocations" << std::endl;
+        }
+    });
     Output output(&engine);
     RendererLoader loader(&engine, &output);
+    //hold a 60 fps gpu budget by rendering at down to half resolution per axis
+    loader.dynamic_resolution.target_frame_ms = 16.0f;
+    loader.dynamic_resolution.min_scale = 0.5f;
+    loader.dynamic_resolution.max_scale = 1.0f;
     Scene scene;
 
-    auto cat = std::make_unique<Model>("assets/Cat.obj");
-    loader.loadModel(&engine, cat.get());
+    //a scene from the command line or the sample one, cooked by the cook_assets target with the text form as fallback
+    //models draw as placeholders until they are loaded and entities are added over the first frames
+    std::string scene_path = argc > 1 ? argv[1] : std::filesystem::exists("assets/cat.vks") ? "assets/cat.vks" : "assets/cat.scene";
+    if(!loader.scene_streamer.load(&scene, scene_path))
+    {
+        std::cout << "could not load scene " << scene_path << std::endl;
+    }
 
-    Texture* cat_texture = loader.loadTexture(&engine, "assets/cat0.ktx");
-    cat->texture = cat_texture;
-
-    scene.models.push_back(std::move(cat));
-    scene.textures.push_back(std::unique_ptr<Texture>(cat_texture));
-    scene.addEntity(scene.models.back().get(), glm::vec3(0.0f, 0.0f, 0.0f));
-
-    scene.light_pos = glm::vec4(0.0f, -10.0f, 10.0f, 0.0f);
-
-    scene.camera.pos = glm::vec3(0.0f, 0.0f, -0.0f);
     scene.camera.view = glm::translate(glm::mat4(1.0f), scene.camera.pos);
     float aspect = (float)output.window_width / (float)output.window_height;
-    scene.camera.proj = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 32.0f);
-
-    loader.setupDescriptors(&engine, &scene);
-    loader.updateSceneDescriptors(&engine, &scene);
+    scene.camera.proj = glm::perspective(glm::radians(45.0f), aspect, scene.camera.z_near, scene.camera.z_far);
 
-    loader.loadShaders(&engine, "assets/shader.slang");
+    loader.loadShaders(&engine, "assets/shader.slang", "assets/meshlet.slang");
 
     Pipeline pipeline(&engine, &loader, &output);
 